@@ -0,0 +1,26 @@
+#include <cstdlib>
+#include <new>
+
+#include "allocations.hpp"
+
+// Counts heap allocations per thread, for the "allocs" counters
+static thread_local uint64_t threadAllocations(0);
+
+void* operator new(std::size_t size) {
+	threadAllocations++;
+	if (void* res = std::malloc(size ? size : 1))
+		return res;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+uint64_t bench::allocations() {
+	return threadAllocations;
+}
@@ -0,0 +1,34 @@
+#ifndef BENCHMARKS_ALLOCATIONS_HPP
+#define BENCHMARKS_ALLOCATIONS_HPP
+
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+#include "lib/messagepool.h"
+
+namespace bench {
+
+/// Heap allocations made by the calling thread so far
+uint64_t allocations();
+
+/**
+ * Reports the heap allocations made between construction and report() as an "allocs" counter,
+ * averaged per iteration. Those of the message pools, as counted for the unit-tests, are also
+ * reported separately as "pool_allocs".
+ */
+class AllocationCounter {
+	uint64_t _start;
+	uint64_t _poolStart;
+public:
+	AllocationCounter() : _start(allocations()), _poolStart(bithorde::poolHeapAllocations()) {}
+
+	void report(benchmark::State& state) {
+		state.counters["allocs"] = benchmark::Counter(allocations() - _start, benchmark::Counter::kAvgIterations);
+		state.counters["pool_allocs"] = benchmark::Counter(bithorde::poolHeapAllocations() - _poolStart, benchmark::Counter::kAvgIterations);
+	}
+};
+
+}
+
+#endif // BENCHMARKS_ALLOCATIONS_HPP
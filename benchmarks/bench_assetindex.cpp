@@ -0,0 +1,110 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "bithorded/lib/management.hpp"
+#include "bithorded/lib/weakmap.hpp"
+#include "bithorded/store/assetindex.hpp"
+
+#include "allocations.hpp"
+
+using namespace bithorded;
+using namespace bithorded::store;
+
+static std::string assetName(size_t i)
+{
+	return "asset-" + std::to_string(i);
+}
+
+static bithorde::Id tigerOf(size_t i)
+{
+	std::string raw(24, '\0');
+	for (size_t byte=0; byte < sizeof(i); byte++)
+		raw[byte] = (i >> (byte*8)) & 0xff;
+	return bithorde::Id::fromRaw(raw);
+}
+
+static void fill(AssetIndex& index, size_t count)
+{
+	for (size_t i=0; i < count; i++)
+		index.addAsset(assetName(i), tigerOf(i), 1024*1024, 1024*1024, i);
+}
+
+static void BM_AssetIndex_lookupTiger(benchmark::State& state)
+{
+	const size_t count = state.range(0);
+	AssetIndex index;
+	fill(index, count);
+	std::vector<bithorde::Id> ids;
+	for (size_t i=0; i < count; i++)
+		ids.push_back(tigerOf((i * 7919) % count));
+	bench::AllocationCounter allocs;
+	for (auto _ : state) {
+		for (auto& id : ids)
+			benchmark::DoNotOptimize(index.lookupTiger(id));
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+	allocs.report(state);
+}
+BENCHMARK(BM_AssetIndex_lookupTiger)->Arg(1024)->Arg(64*1024);
+
+// Picks and removes the lowest-scored asset, as AssetStore does when purging for space
+static void BM_AssetIndex_evict(benchmark::State& state)
+{
+	const size_t count = state.range(0);
+	AssetIndex index;
+	uint64_t allocs = 0; // Only counted while evicting, not while refilling
+	for (auto _ : state) {
+		state.PauseTiming();
+		fill(index, count);
+		state.ResumeTiming();
+		auto before = bench::allocations();
+		while (index.assetCount())
+			index.removeAsset(index.pickLooser());
+		allocs += bench::allocations() - before;
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+	state.counters["allocs"] = benchmark::Counter(allocs, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_AssetIndex_evict)->Arg(1024);
+
+// Lists the index for the management-interface, whole and one page at a time
+static void BM_AssetIndex_inspect(benchmark::State& state)
+{
+	const size_t count = state.range(0);
+	const size_t limit = state.range(1);
+	AssetIndex index;
+	fill(index, count);
+	bench::AllocationCounter allocs;
+	for (auto _ : state) {
+		management::InfoList list;
+		if (limit)
+			list.limit = limit;
+		index.inspect(list);
+		benchmark::DoNotOptimize(list.total);
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+	allocs.report(state);
+}
+BENCHMARK(BM_AssetIndex_inspect)->Args({64*1024, 0})->Args({64*1024, 100});
+
+static void BM_WeakMap_setLookup(benchmark::State& state)
+{
+	const size_t count = state.range(0);
+	WeakMap<size_t, std::string> map;
+	std::vector< std::shared_ptr<std::string> > links;
+	for (size_t i=0; i < count; i++)
+		links.push_back(std::make_shared<std::string>(assetName(i)));
+	bench::AllocationCounter allocs;
+	for (auto _ : state) {
+		for (size_t i=0; i < count; i++)
+			map.set(i, links[i]);
+		for (size_t i=0; i < count; i++)
+			benchmark::DoNotOptimize(map[(i * 7919) % count]);
+	}
+	state.SetItemsProcessed(state.iterations() * count * 2);
+	allocs.report(state);
+}
+BENCHMARK(BM_WeakMap_setLookup)->Arg(1024)->Arg(64*1024);
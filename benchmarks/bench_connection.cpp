@@ -0,0 +1,85 @@
+#include <memory>
+#include <string>
+
+#include <boost/asio/local/connect_pair.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/write.hpp>
+#include <benchmark/benchmark.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include "lib/connection.h"
+
+#include "allocations.hpp"
+
+using namespace bithorde;
+namespace asio = boost::asio;
+
+// Encodes like bithorde::Connection::sendMessage
+static void encode(std::string& wire, Connection::MessageType type, const google::protobuf::Message& msg)
+{
+	google::protobuf::io::StringOutputStream of(&wire);
+	google::protobuf::io::CodedOutputStream stream(&of);
+	stream.WriteTag(google::protobuf::internal::WireFormatLite::MakeTag(type, google::protobuf::internal::WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+	stream.WriteVarint32(msg.ByteSizeLong());
+	msg.SerializeToCodedStream(&stream);
+}
+
+static void BM_MessageQueue_enqueueDequeue(benchmark::State& state)
+{
+	const size_t batch = 64;
+	const size_t msgSize = state.range(0);
+	MessageQueue queue;
+	bench::AllocationCounter allocs;
+	for (auto _ : state) {
+		for (size_t i=0; i < batch; i++) {
+			auto msg = std::make_shared<Message>(Message::NEVER);
+			msg->buf.resize(msgSize);
+			queue.enqueue(msg);
+		}
+		while (!queue.empty())
+			benchmark::DoNotOptimize(queue.dequeue(1024*1024*1024, 20));
+	}
+	state.SetItemsProcessed(state.iterations() * batch);
+	state.SetBytesProcessed(state.iterations() * batch * msgSize);
+	allocs.report(state);
+}
+BENCHMARK(BM_MessageQueue_enqueueDequeue)->Arg(64)->Arg(64*1024);
+
+// Feeds a batch of Read.Responses through a socketpair into Connection::onRead and dispatch
+static void BM_Connection_onRead(benchmark::State& state)
+{
+	const size_t batch = 64;
+	asio::io_context ioCtx;
+	auto writer = std::make_shared<asio::local::stream_protocol::socket>(ioCtx);
+	auto reader = std::make_shared<asio::local::stream_protocol::socket>(ioCtx);
+	asio::local::connect_pair(*writer, *reader);
+	auto stats = std::make_shared<ConnectionStats>(TimerService::forContext(ioCtx));
+	auto conn = Connection::create(ioCtx, stats, reader);
+	size_t received = 0;
+	conn->setCallback([&](Connection::MessageType, const Connection::MessagePtr&) { received++; });
+
+	Read::Response resp;
+	resp.set_reqid(17);
+	resp.set_status(SUCCESS);
+	resp.set_offset(1024);
+	resp.set_content(std::string(state.range(0), 'x'));
+	std::string wire;
+	for (size_t i=0; i < batch; i++)
+		encode(wire, Connection::ReadResponse, resp);
+
+	bench::AllocationCounter allocs;
+	for (auto _ : state) {
+		size_t expected = received + batch;
+		asio::async_write(*writer, asio::buffer(wire), [](const boost::system::error_code&, size_t) {});
+		while (received < expected && ioCtx.run_one()) {}
+	}
+	state.SetItemsProcessed(state.iterations() * batch);
+	state.SetBytesProcessed(state.iterations() * wire.size());
+	allocs.report(state);
+
+	conn->close();
+	ioCtx.poll();
+}
+BENCHMARK(BM_Connection_onRead)->Arg(64)->Arg(64*1024);
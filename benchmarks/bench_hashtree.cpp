@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include <crypto++/tiger.h>
+#include <benchmark/benchmark.h>
+
+#include "bithorded/lib/treestore.hpp"
+#include "bithorded/lib/hashtree.hpp"
+#include "bithorded/store/hashstore.hpp"
+#include "tests/test_storage.hpp"
+
+#include "allocations.hpp"
+
+using namespace std;
+using namespace bithorded::store;
+
+typedef TreeHasher< CryptoPP::Tiger > Hasher;
+typedef HashNode< CryptoPP::Tiger > Node;
+typedef TestStorage< Node > Storage;
+
+// In-memory backing for HashStore, so node access is measured without disk-IO
+class MemoryArray : public bithorded::IDataArray {
+	std::vector<byte> _storage;
+public:
+	MemoryArray(size_t size) : _storage(size) {}
+
+	virtual uint64_t size() const {
+		return _storage.size();
+	}
+	virtual ssize_t read(uint64_t offset, size_t size, byte* buf) const {
+		std::copy(_storage.begin()+offset, _storage.begin()+offset+size, buf);
+		return size;
+	}
+	virtual ssize_t write(uint64_t offset, const void* src, size_t size) {
+		std::copy(static_cast<const byte *>(src), static_cast<const byte *>(src)+size, _storage.begin()+offset);
+		return size;
+	}
+	virtual std::string describe() {
+		ostringstream oss;
+		oss << "(Memory of size: " << _storage.size() << ")";
+		return oss.str();
+	}
+};
+
+static void BM_TreeHasher_rootDigest(benchmark::State& state)
+{
+	std::vector<byte> input(state.range(0), 'A');
+	byte digest[Hasher::DigestSize];
+	bench::AllocationCounter allocs;
+	for (auto _ : state) {
+		Hasher::rootDigest(input.data(), input.size(), digest);
+		benchmark::DoNotOptimize(digest);
+	}
+	state.SetBytesProcessed(state.iterations() * input.size());
+	allocs.report(state);
+}
+BENCHMARK(BM_TreeHasher_rootDigest)->Arg(1024)->Arg(64*1024)->Arg(1024*1024);
+
+// Hashes a whole asset of range(0) leaves into a fresh in-memory tree
+static void BM_HashTree_setData(benchmark::State& state)
+{
+	const size_t leaves = state.range(0);
+	const uint8_t levelsSkipped = 2;
+	const size_t blockSize = Hasher::ATOMSIZE << levelsSkipped;
+	std::vector<byte> block(blockSize, 'A');
+	Storage store(treesize(leaves));
+	bench::AllocationCounter allocs;
+	for (auto _ : state) {
+		std::fill(store.begin(), store.end(), Node());
+		HashTree<Storage> tree(store, levelsSkipped);
+		for (size_t i=0; i < leaves; i++)
+			tree.setData(i*blockSize, block.data(), blockSize);
+		benchmark::DoNotOptimize(tree.getRoot()->digest);
+	}
+	state.SetBytesProcessed(state.iterations() * leaves * blockSize);
+	allocs.report(state);
+}
+BENCHMARK(BM_HashTree_setData)->Arg(64)->Arg(4096);
+
+// Walks from every leaf to the root, as propagation does
+static void BM_TreeStore_leafToRoot(benchmark::State& state)
+{
+	const size_t leaves = state.range(0);
+	TestStorage<int> storage(treesize(leaves));
+	TreeStore<int, TestStorage<int> > tree(storage);
+	bench::AllocationCounter allocs;
+	size_t nodes = 0;
+	for (auto _ : state) {
+		for (uint32_t i=0; i < leaves; i++) {
+			auto idx = tree.leaf(i);
+			while (!idx.isRoot()) {
+				benchmark::DoNotOptimize(*tree[idx]);
+				idx = idx.parent();
+				nodes++;
+			}
+		}
+	}
+	state.SetItemsProcessed(nodes);
+	allocs.report(state);
+}
+BENCHMARK(BM_TreeStore_leafToRoot)->Arg(1024)->Arg(64*1024);
+
+// Random node lookups through HashStore, including the WeakMap node cache
+static void BM_HashStore_nodeAccess(benchmark::State& state)
+{
+	const size_t leaves = state.range(0);
+	const size_t nodes = treesize(leaves);
+	HashStore store(std::make_shared<MemoryArray>(nodes*sizeof(TigerBaseNode)));
+	std::vector<size_t> order(nodes);
+	for (size_t i=0; i < nodes; i++)
+		order[i] = (i * 7919) % nodes;
+	bench::AllocationCounter allocs;
+	for (auto _ : state) {
+		for (auto offset : order)
+			benchmark::DoNotOptimize(store[offset]->state);
+	}
+	state.SetItemsProcessed(state.iterations() * nodes);
+	allocs.report(state);
+}
+BENCHMARK(BM_HashStore_nodeAccess)->Arg(1024);
+
+// Hashes a whole asset into HashStore-backed tree, as StoredAsset does
+static void BM_HashStore_setData(benchmark::State& state)
+{
+	const size_t leaves = state.range(0);
+	const uint8_t levelsSkipped = 2;
+	const size_t blockSize = Hasher::ATOMSIZE << levelsSkipped;
+	std::vector<byte> block(blockSize, 'A');
+	bench::AllocationCounter allocs;
+	for (auto _ : state) {
+		HashStore store(std::make_shared<MemoryArray>(treesize(leaves)*sizeof(TigerBaseNode)), levelsSkipped);
+		HashTree<HashStore> tree(store, levelsSkipped);
+		for (size_t i=0; i < leaves; i++)
+			tree.setData(i*blockSize, block.data(), blockSize);
+		benchmark::DoNotOptimize(tree.getRoot()->digest);
+	}
+	state.SetBytesProcessed(state.iterations() * leaves * blockSize);
+	allocs.report(state);
+}
+BENCHMARK(BM_HashStore_setData)->Arg(64)->Arg(4096);
@@ -28,12 +28,19 @@ using namespace bithorded::store;
 
 namespace fs = boost::filesystem;
 
+const size_t PREFETCH_STREAMS = 8;
+const uint64_t PREFETCH_MIN_WINDOW = 256*1024;
+const uint64_t PREFETCH_MAX_WINDOW = 8*1024*1024;
+const size_t WRITE_BATCH_MAX = 1024*1024;
+
 namespace bithorded { namespace cache {
 	Logger assetLog;
 } }
 
 bithorded::cache::CachedAsset::CachedAsset(GrandCentralDispatch& gcd, const std::string& id, const store::HashStore::Ptr& hashStore, const IDataArray::Ptr& data) :
-	StoredAsset(gcd, id, hashStore, data)
+	StoredAsset(gcd, id, hashStore, data),
+	_writing(false),
+	_writtenBatches(0)
 {
 	auto trx = status.change();
 	trx->set_status(hasRootHash() ? bithorde::SUCCESS : bithorde::NOTFOUND);
@@ -42,6 +49,7 @@ bithorded::cache::CachedAsset::CachedAsset(GrandCentralDispatch& gcd, const std:
 void bithorded::cache::CachedAsset::inspect(bithorded::management::InfoList& target) const
 {
 	target.append("type") << "Cached";
+	target.append("writes") << _writeQueue.size() << " queued, " << writeQueued() << " bytes, " << _writtenBatches << " batches written";
 }
 
 void CachedAsset::apply(const bithorded::AssetRequestParameters& old_parameters, const bithorded::AssetRequestParameters& new_parameters)
@@ -49,17 +57,71 @@ void CachedAsset::apply(const bithorded::AssetRequestParameters& old_parameters,
 
 void bithorded::cache::CachedAsset::write(uint64_t offset, const bithorde::IBuffer::Ptr& data, const std::function< void() > whenDone )
 {
-	auto self = shared_from_this();
-	auto job = [=]() mutable {
-		return _data->write(offset, **data, data->size());
+	_writeQueue.push_back(PendingWrite{offset, data, whenDone, 0});
+	if (!_writing)
+		flushWrites();
+}
+
+size_t bithorded::cache::CachedAsset::writeQueued() const
+{
+	size_t res = 0;
+	for (auto iter = _writeQueue.begin(); iter != _writeQueue.end(); iter++)
+		res += iter->data->size();
+	return res;
+}
+
+void bithorded::cache::CachedAsset::flushWrites()
+{
+	// One job at a time, taking everything queued meanwhile. Saves a round-trip through the GCD
+	// per segment, and lets contiguous segments be hashed as one range.
+	auto batch = std::make_shared<WriteBatch>();
+	size_t batchSize = 0;
+	while (!_writeQueue.empty() && (batch->empty() || batchSize < WRITE_BATCH_MAX)) {
+		batchSize += _writeQueue.front().data->size();
+		batch->push_back(std::move(_writeQueue.front()));
+		_writeQueue.pop_front();
+	}
+	if (batch->empty())
+		return;
+	_writing = true;
+
+	auto data = _data;
+	auto job = [=]() {
+		// Results are only read by the completion, once posted back to the io-thread
+		for (auto& write : *batch)
+			write.written = data->write(write.offset, **write.data, write.data->size());
+		return batch;
 	};
-	auto completion = [=](uint64_t size) {
-		self->notifyValidRange(offset, size, [=]{
-			if (whenDone)
-				whenDone();
+	auto self = std::static_pointer_cast<CachedAsset>(shared_from_this());
+	_gcd.submit(job, std::bind(&CachedAsset::batchWritten, self, std::placeholders::_1), GrandCentralDispatch::WRITE);
+}
+
+void bithorded::cache::CachedAsset::batchWritten(const std::shared_ptr<WriteBatch>& batch)
+{
+	_writing = false;
+	_writtenBatches++;
+
+	// Hash each contiguous range once, and call back for all its segments when done
+	auto iter = batch->begin();
+	while (iter != batch->end()) {
+		auto offset = iter->offset;
+		uint64_t size = 0;
+		std::vector< std::function<void()> > whenDone;
+		do {
+			iter->data.reset();
+			if (iter->written > 0)
+				size += iter->written;
+			if (iter->whenDone)
+				whenDone.push_back(std::move(iter->whenDone));
+			iter++;
+		} while ((iter != batch->end()) && (iter->offset == offset + size) && ((iter-1)->written > 0));
+		notifyValidRange(offset, size, [whenDone]{
+			for (auto& cb : whenDone)
+				cb();
 		});
-	};
-	_gcd.submit(job, completion);
+	}
+
+	flushWrites();
 }
 
 CachedAsset::Ptr CachedAsset::open(GrandCentralDispatch& gcd, const boost::filesystem::path& path ) {
@@ -96,7 +158,8 @@ bithorded::cache::CachingAsset::CachingAsset( CacheManager& mgr, const IAsset::P
 	_upstream(upstream),
 	_upstreamTracker(_upstream->status.onChange.connect([=](const bithorde::AssetStatus&, const bithorde::AssetStatus& newStatus) { upstreamStatusChange(newStatus); })),
 	_cached(cached),
-	_delayedCreation(false)
+	_delayedCreation(false),
+	_prefetched(0)
 {
 	status = *_upstream->status;
 }
@@ -109,6 +172,7 @@ bithorded::cache::CachingAsset::~CachingAsset()
 void bithorded::cache::CachingAsset::inspect(bithorded::management::InfoList& target) const
 {
 	target.append("type") << "caching";
+	target.append("prefetch") << _streams.size() << " streams, " << _prefetched << " bytes prefetched";
 	if (_upstream)
 		_upstream->inspect(target);
 }
@@ -123,7 +187,60 @@ void bithorded::cache::CachingAsset::asyncRead(uint64_t offset, size_t size, uin
 			std::bind(&CachingAsset::upstreamDataArrived, shared_from_this(), cb, size, std::placeholders::_1, std::placeholders::_2)
 		);
 	} else {
-		cb(-1, bithorde::NullBuffer::instance);
+		return cb(-1, bithorde::NullBuffer::instance);
+	}
+	trackAccess(offset, size, timeout);
+}
+
+void bithorded::cache::CachingAsset::trackAccess(uint64_t offset, size_t size, uint32_t timeout)
+{
+	auto stream = _streams.begin();
+	while (stream != _streams.end() && stream->next != offset)
+		stream++;
+	if (stream == _streams.end()) {
+		_streams.push_front(SequentialStream{offset+size, offset+size, 0});
+		if (_streams.size() > PREFETCH_STREAMS)
+			_streams.pop_back();
+		return;
+	}
+
+	// Sequential read, widen the prefetch window while the reader keeps going
+	stream->next = offset + size;
+	stream->window = stream->window ? std::min(stream->window * 2, PREFETCH_MAX_WINDOW) : PREFETCH_MIN_WINDOW;
+	_streams.splice(_streams.begin(), _streams, stream);
+	prefetch(_streams.front(), size, timeout);
+}
+
+void bithorded::cache::CachingAsset::prefetch(SequentialStream& stream, size_t chunkSize, uint32_t timeout)
+{
+	auto cached_ = cached();
+	if (!cached_ || !_upstream || !chunkSize)
+		return;
+	auto end = std::min(stream.next + stream.window, size());
+	auto offset = std::max(stream.prefetched, stream.next);
+	stream.prefetched = std::max(offset, end);
+	auto self = shared_from_this();
+	for (; offset < end; offset += chunkSize) {
+		auto chunk = std::min<uint64_t>(chunkSize, end - offset);
+		if (cached_->canRead(offset, chunk) == chunk)
+			continue;
+		_prefetched += chunk;
+		_upstream->asyncRead(offset, chunk, timeout, [=](int64_t at, const std::shared_ptr<bithorde::IBuffer>& data) {
+			if (data->size())
+				self->storeUpstreamData(at, data);
+		});
+		if (!_upstream) // Asset may have been completed by a synchronous response
+			break;
+	}
+}
+
+void bithorded::cache::CachingAsset::downstreamCongested(uint64_t offset)
+{
+	// Narrow the window, so the reader has to keep up again before prefetch reaches further ahead.
+	// Not below the minimum, or a reader stalled long enough would be back at a fresh window.
+	for (auto& stream : _streams) {
+		if ((stream.next == offset) && stream.window)
+			stream.window = std::max(stream.window / 2, PREFETCH_MIN_WINDOW);
 	}
 }
 
@@ -137,6 +254,14 @@ size_t bithorded::cache::CachingAsset::canRead(uint64_t offset, size_t size)
 		return 0;
 }
 
+size_t bithorded::cache::CachingAsset::mapFile(uint64_t offset, size_t size, int& fd, uint64_t& fileOffset)
+{
+	if (auto cached_ = cached())
+		return cached_->mapFile(offset, size, fd, fileOffset);
+	else
+		return 0;
+}
+
 uint64_t bithorded::cache::CachingAsset::size()
 {
 	if (auto cached_ = cached())
@@ -163,14 +288,7 @@ void bithorded::cache::CachingAsset::upstreamDataArrived( IAsset::ReadCallback c
 {
 	auto cached_ = cached();
 	if (data->size() >= requested_size) {
-		if (cached_) {
-			auto self = shared_from_this();
-			cached_->write(offset, data, [=]() {
-				if (cached_->hasRootHash())
-					self->disconnect();
-				self->_manager.updateAsset(cached_);
-			});
-		}
+		storeUpstreamData(offset, data);
 		cb(offset, data);
 	} else if (cached_ && (cached_->canRead(offset, requested_size) == requested_size)) {
 		cached_->asyncRead(offset, requested_size, 0, cb);
@@ -179,6 +297,18 @@ void bithorded::cache::CachingAsset::upstreamDataArrived( IAsset::ReadCallback c
 	}
 }
 
+void bithorded::cache::CachingAsset::storeUpstreamData(int64_t offset, const std::shared_ptr<bithorde::IBuffer>& data)
+{
+	if (auto cached_ = cached()) {
+		auto self = shared_from_this();
+		cached_->write(offset, data, [=]() {
+			if (cached_->hasRootHash())
+				self->disconnect();
+			self->_manager.updateAsset(cached_);
+		});
+	}
+}
+
 void bithorded::cache::CachingAsset::upstreamStatusChange(const bithorde::AssetStatus& newStatus)
 {
 	if ((newStatus.status() == bithorde::Status::SUCCESS) && !_cached && _upstream->size() > 0) {
@@ -18,6 +18,9 @@
 #define BITHORDED_CACHE_ASSET_HPP
 
 #include <boost/filesystem/path.hpp>
+#include <deque>
+#include <list>
+#include <vector>
 
 #include "../lib/hashtree.hpp"
 #include "../server/asset.hpp"
@@ -31,6 +34,16 @@ class CacheManager;
 
 class CachedAsset : public store::StoredAsset
 {
+	struct PendingWrite {
+		uint64_t offset;
+		std::shared_ptr<bithorde::IBuffer> data;
+		std::function< void() > whenDone;
+		ssize_t written;
+	};
+	typedef std::vector<PendingWrite> WriteBatch;
+	std::deque<PendingWrite> _writeQueue; // Waiting for the write in progress
+	bool _writing;
+	uint64_t _writtenBatches;
 public:
 	typedef std::shared_ptr<CachedAsset> Ptr;
 	typedef std::weak_ptr<CachedAsset> WeakPtr;
@@ -49,8 +62,25 @@ public:
 	 */
 	void write(uint64_t offset, const std::shared_ptr<bithorde::IBuffer>& data, const std::function< void() > whenDone = 0);
 
+	/**
+	 * Bytes waiting to be written
+	 */
+	size_t writeQueued() const;
+
 	static Ptr open( bithorded::GrandCentralDispatch& gcd, const boost::filesystem::path& path );
 	static Ptr create( bithorded::GrandCentralDispatch& gcd, const boost::filesystem::path& path, uint64_t size );
+private:
+	void flushWrites();
+	void batchWritten(const std::shared_ptr<WriteBatch>& batch);
+};
+
+/**
+ * A reader seemingly reading the asset front to back.
+ */
+struct SequentialStream {
+	uint64_t next;       // Where the reader is expected to read next
+	uint64_t prefetched; // Prefetch has been requested up to here
+	uint64_t window;     // How far ahead of /next/ to prefetch
 };
 
 class CachingAsset : boost::noncopyable, public IAsset, public std::enable_shared_from_this<CachingAsset> {
@@ -59,6 +89,8 @@ class CachingAsset : boost::noncopyable, public IAsset, public std::enable_share
 	boost::signals2::scoped_connection _upstreamTracker;
 	CachedAsset::Ptr _cached;
 	bool _delayedCreation;
+	std::list<SequentialStream> _streams; // Most recently read first
+	uint64_t _prefetched;
 public:
 	CachingAsset(CacheManager& mgr, const bithorded::IAsset::Ptr& upstream, const bithorded::cache::CachedAsset::Ptr& cached);
 	virtual ~CachingAsset();
@@ -69,6 +101,10 @@ public:
 
 	virtual size_t canRead(uint64_t offset, size_t size);
 
+	virtual size_t mapFile(uint64_t offset, size_t size, int& fd, uint64_t& fileOffset);
+
+	virtual void downstreamCongested(uint64_t offset);
+
 	virtual uint64_t size();
 
 	virtual void apply(const AssetRequestParameters& old_parameters, const AssetRequestParameters& new_parameters);
@@ -78,6 +114,9 @@ private:
 
 	void disconnect();
 	void upstreamDataArrived( bithorded::IAsset::ReadCallback cb, std::size_t requested_size, int64_t offset, const std::shared_ptr<bithorde::IBuffer>& data );
+	void storeUpstreamData(int64_t offset, const std::shared_ptr<bithorde::IBuffer>& data);
+	void trackAccess(uint64_t offset, size_t size, uint32_t timeout);
+	void prefetch(SequentialStream& stream, size_t chunkSize, uint32_t timeout);
 	void upstreamStatusChange(const bithorde::AssetStatus& newStatus);
 };
 	}
@@ -20,6 +20,8 @@
 #include <boost/filesystem.hpp>
 
 #include <bithorded/lib/log.hpp>
+#include <bithorded/lib/loopmonitor.hpp>
+#include <bithorded/lib/metrics.hpp>
 
 using namespace bithorde;
 using namespace bithorded;
@@ -29,6 +31,8 @@ namespace fs = boost::filesystem;
 
 namespace bithorded {
 	namespace cache {
+		metrics::Counter cacheHits("bithorded_cache_lookups_total", "Binds looked up in the cache", {{"result", "hit"}});
+		metrics::Counter cacheMisses("bithorded_cache_lookups_total", "Binds looked up in the cache", {{"result", "miss"}});
 		Logger log;
 	}
 }
@@ -70,8 +74,10 @@ IAsset::Ptr CacheManager::openAsset(const bithorde::BindRead& req)
 		return IAsset::Ptr();
 	auto stored = std::dynamic_pointer_cast<CachedAsset>(bithorded::store::AssetStore::openAsset(req));
 	if (stored && (stored->status->status() == bithorde::Status::SUCCESS)) {
+		cacheHits += 1;
 		return stored;
 	} else {
+		cacheMisses += 1;
 		auto upstream = _router.findAsset(req);
 		if (auto upstream_ = std::dynamic_pointer_cast<bithorded::IAsset>(upstream->shared())) {
 			return std::make_shared<CachingAsset>(*this, upstream_, stored);
@@ -121,6 +127,7 @@ UpstreamRequestBinding::Ptr CacheManager::findAsset(const bithorde::BindRead& re
 
 bool CacheManager::makeRoom(uint64_t size)
 {
+	LoopMonitor::Scope loop("cache.makeRoom");
 	int64_t needed = (store::AssetStore::diskUsage()+size) - _maxSize;
 	int64_t freed = 0;
 	while (needed > freed) {
@@ -39,6 +39,8 @@ public:
 
 	bool enabled() const { return !_baseDir.empty(); }
 
+	using AssetStore::tigerIds;
+
 	/**
 	 * Add an asset to the idx, allocating space for
 	 * the status of the asset will be updated to reflect it.
@@ -15,10 +15,17 @@
 namespace http {
 namespace server {
 
+namespace {
+	/// Seconds a kept-alive connection may idle before the next request.
+	const int IDLE_TIMEOUT = 30;
+}
+
 connection::connection(boost::asio::io_context& io_context, connection_manager& manager, request_handler& handler) :
 	socket_(io_context),
 	connection_manager_(manager),
-	request_handler_(handler)
+	request_handler_(handler),
+	keep_alive_(false),
+	idle_timer_(io_context)
 {}
 
 boost::asio::ip::tcp::socket& connection::socket()
@@ -27,8 +34,24 @@ boost::asio::ip::tcp::socket& connection::socket()
 }
 
 void connection::start()
+{
+	read_request();
+}
+
+void connection::stop()
+{
+	idle_timer_.cancel();
+	socket_.close();
+}
+
+void connection::read_request()
 {
 	auto self = shared_from_this();
+	idle_timer_.expires_after(std::chrono::seconds(IDLE_TIMEOUT));
+	idle_timer_.async_wait([=](const boost::system::error_code& ec) {
+		if (!ec)
+			self->connection_manager_.stop(self);
+	});
 	socket_.async_read_some(boost::asio::buffer(buffer_),
 		[=](const boost::system::error_code& ec, std::size_t bytes_transferred) {
 			self->handle_read(ec, bytes_transferred);
@@ -36,56 +59,81 @@ void connection::start()
 	);
 }
 
-void connection::stop()
-{
-	socket_.close();
-}
-
 void connection::handle_read(const boost::system::error_code& e,
 	std::size_t bytes_transferred)
 {
 	if (!e)
 	{
-		boost::tribool result;
-		boost::tie(result, boost::tuples::ignore) = request_parser_.parse(
-			request_, buffer_.data(), buffer_.data() + bytes_transferred);
+		handle_data(buffer_.data(), buffer_.data() + bytes_transferred);
+	}
+	else if (e != boost::asio::error::operation_aborted)
+	{
+		connection_manager_.stop(shared_from_this());
+	}
+}
+
+void connection::handle_data(const char* begin, const char* end)
+{
+	boost::tribool result;
+	const char* consumed;
+	boost::tie(result, consumed) = request_parser_.parse(request_, begin, end);
 
-		auto self = shared_from_this();
-		if (result)
+	auto self = shared_from_this();
+	if (result)
+	{
+		idle_timer_.cancel();
+		pending_.assign(consumed, end);
+		keep_alive_ = request_.keep_alive();
+		request_handler_.handle_request(request_, reply_);
+		if (reply_.stream)
 		{
-			request_handler_.handle_request(request_, reply_);
-			boost::asio::async_write(socket_, reply_.to_buffers(),
-				[=](const boost::system::error_code& ec, std::size_t bytes_transferred) {
-					self->handle_write(ec);
-				}
-			);
+			reply_.stream(socket_, [=](const boost::system::error_code& ec) {
+				self->handle_write(ec);
+			});
 		}
-		else if (!result)
+		else
 		{
-			reply_ = reply::stock_reply(reply::bad_request);
 			boost::asio::async_write(socket_, reply_.to_buffers(),
 				[=](const boost::system::error_code& ec, std::size_t bytes_transferred) {
 					self->handle_write(ec);
 				}
 			);
 		}
-		else
-		{
-			socket_.async_read_some(boost::asio::buffer(buffer_),
-				[=](const boost::system::error_code& ec, std::size_t bytes_transferred) {
-					self->handle_read(ec, bytes_transferred);
-				}
-			);
-		}
 	}
-	else if (e != boost::asio::error::operation_aborted)
+	else if (!result)
 	{
-		connection_manager_.stop(shared_from_this());
+		idle_timer_.cancel();
+		keep_alive_ = false;
+		reply_ = reply::stock_reply(reply::bad_request);
+		boost::asio::async_write(socket_, reply_.to_buffers(),
+			[=](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+				self->handle_write(ec);
+			}
+		);
+	}
+	else
+	{
+		read_request();
 	}
 }
 
 void connection::handle_write(const boost::system::error_code& e)
 {
+	if (!e && keep_alive_)
+	{
+		// Ready for the next request, which may already have arrived.
+		request_ = request();
+		request_parser_.reset();
+		reply_ = reply();
+		std::string pending;
+		pending.swap(pending_);
+		if (pending.empty())
+			read_request();
+		else
+			handle_data(pending.data(), pending.data() + pending.size());
+		return;
+	}
+
 	if (!e)
 	{
 		// Initiate graceful connection closure.
@@ -13,6 +13,7 @@
 
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/shared_ptr.hpp>
 #include "reply.hpp"
 #include "request.hpp"
@@ -43,10 +44,16 @@ class connection
 	void stop();
 
 	private:
+	/// Wait for more of the next request, closing the connection if idle.
+	void read_request();
+
 	/// Handle completion of a read operation.
 	void handle_read(const boost::system::error_code& e,
 		std::size_t bytes_transferred);
 
+	/// Parse received data, replying once a request is complete.
+	void handle_data(const char* begin, const char* end);
+
 	/// Handle completion of a write operation.
 	void handle_write(const boost::system::error_code& e);
 
@@ -70,6 +77,15 @@ class connection
 
 	/// The reply to be sent back to the client.
 	reply reply_;
+
+	/// Whether to wait for another request after the reply.
+	bool keep_alive_;
+
+	/// Data received after the current request, from a pipelining client.
+	std::string pending_;
+
+	/// Closes connections idle between requests.
+	boost::asio::steady_timer idle_timer_;
 };
 
 typedef std::shared_ptr<connection> connection_ptr;
@@ -10,6 +10,7 @@
 
 #include "reply.hpp"
 #include <string>
+#include <boost/format.hpp>
 #include <boost/lexical_cast.hpp>
 
 namespace http {
@@ -18,37 +19,43 @@ namespace server {
 namespace status_strings {
 
 const std::string ok =
-  "HTTP/1.0 200 OK\r\n";
+  "HTTP/1.1 200 OK\r\n";
 const std::string created =
-  "HTTP/1.0 201 Created\r\n";
+  "HTTP/1.1 201 Created\r\n";
 const std::string accepted =
-  "HTTP/1.0 202 Accepted\r\n";
+  "HTTP/1.1 202 Accepted\r\n";
 const std::string no_content =
-  "HTTP/1.0 204 No Content\r\n";
+  "HTTP/1.1 204 No Content\r\n";
+const std::string partial_content =
+  "HTTP/1.1 206 Partial Content\r\n";
 const std::string multiple_choices =
-  "HTTP/1.0 300 Multiple Choices\r\n";
+  "HTTP/1.1 300 Multiple Choices\r\n";
 const std::string moved_permanently =
-  "HTTP/1.0 301 Moved Permanently\r\n";
+  "HTTP/1.1 301 Moved Permanently\r\n";
 const std::string moved_temporarily =
-  "HTTP/1.0 302 Moved Temporarily\r\n";
+  "HTTP/1.1 302 Moved Temporarily\r\n";
 const std::string not_modified =
-  "HTTP/1.0 304 Not Modified\r\n";
+  "HTTP/1.1 304 Not Modified\r\n";
 const std::string bad_request =
-  "HTTP/1.0 400 Bad Request\r\n";
+  "HTTP/1.1 400 Bad Request\r\n";
 const std::string unauthorized =
-  "HTTP/1.0 401 Unauthorized\r\n";
+  "HTTP/1.1 401 Unauthorized\r\n";
 const std::string forbidden =
-  "HTTP/1.0 403 Forbidden\r\n";
+  "HTTP/1.1 403 Forbidden\r\n";
 const std::string not_found =
-  "HTTP/1.0 404 Not Found\r\n";
+  "HTTP/1.1 404 Not Found\r\n";
+const std::string range_not_satisfiable =
+  "HTTP/1.1 416 Range Not Satisfiable\r\n";
 const std::string internal_server_error =
-  "HTTP/1.0 500 Internal Server Error\r\n";
+  "HTTP/1.1 500 Internal Server Error\r\n";
 const std::string not_implemented =
-  "HTTP/1.0 501 Not Implemented\r\n";
+  "HTTP/1.1 501 Not Implemented\r\n";
 const std::string bad_gateway =
-  "HTTP/1.0 502 Bad Gateway\r\n";
+  "HTTP/1.1 502 Bad Gateway\r\n";
 const std::string service_unavailable =
-  "HTTP/1.0 503 Service Unavailable\r\n";
+  "HTTP/1.1 503 Service Unavailable\r\n";
+const std::string gateway_timeout =
+  "HTTP/1.1 504 Gateway Timeout\r\n";
 
 boost::asio::const_buffer to_buffer(reply::status_type status)
 {
@@ -62,6 +69,8 @@ boost::asio::const_buffer to_buffer(reply::status_type status)
 		return boost::asio::buffer(accepted);
 	case reply::no_content:
 		return boost::asio::buffer(no_content);
+	case reply::partial_content:
+		return boost::asio::buffer(partial_content);
 	case reply::multiple_choices:
 		return boost::asio::buffer(multiple_choices);
 	case reply::moved_permanently:
@@ -78,6 +87,8 @@ boost::asio::const_buffer to_buffer(reply::status_type status)
 		return boost::asio::buffer(forbidden);
 	case reply::not_found:
 		return boost::asio::buffer(not_found);
+	case reply::range_not_satisfiable:
+		return boost::asio::buffer(range_not_satisfiable);
 	case reply::internal_server_error:
 		return boost::asio::buffer(internal_server_error);
 	case reply::not_implemented:
@@ -86,6 +97,8 @@ boost::asio::const_buffer to_buffer(reply::status_type status)
 		return boost::asio::buffer(bad_gateway);
 	case reply::service_unavailable:
 		return boost::asio::buffer(service_unavailable);
+	case reply::gateway_timeout:
+		return boost::asio::buffer(gateway_timeout);
 	default:
 		return boost::asio::buffer(internal_server_error);
 	}
@@ -186,6 +199,11 @@ const char not_found[] =
   "<head><title>Not Found</title></head>"
   "<body><h1>404 Not Found</h1></body>"
   "</html>";
+const char range_not_satisfiable[] =
+  "<html>"
+  "<head><title>Range Not Satisfiable</title></head>"
+  "<body><h1>416 Range Not Satisfiable</h1></body>"
+  "</html>";
 const char internal_server_error[] =
   "<html>"
   "<head><title>Internal Server Error</title></head>"
@@ -206,6 +224,11 @@ const char service_unavailable[] =
   "<head><title>Service Unavailable</title></head>"
   "<body><h1>503 Service Unavailable</h1></body>"
   "</html>";
+const char gateway_timeout[] =
+  "<html>"
+  "<head><title>Gateway Timeout</title></head>"
+  "<body><h1>504 Gateway Timeout</h1></body>"
+  "</html>";
 
 std::string to_string(reply::status_type status)
 {
@@ -235,6 +258,8 @@ std::string to_string(reply::status_type status)
 		return forbidden;
 	case reply::not_found:
 		return not_found;
+	case reply::range_not_satisfiable:
+		return range_not_satisfiable;
 	case reply::internal_server_error:
 		return internal_server_error;
 	case reply::not_implemented:
@@ -243,6 +268,8 @@ std::string to_string(reply::status_type status)
 		return bad_gateway;
 	case reply::service_unavailable:
 		return service_unavailable;
+	case reply::gateway_timeout:
+		return gateway_timeout;
 	default:
 		return internal_server_error;
 	}
@@ -250,6 +277,77 @@ std::string to_string(reply::status_type status)
 
 } // namespace stock_replies
 
+namespace {
+
+/// Writes the body of a generated reply, one piece at a time.
+class generated_writer
+	: public std::enable_shared_from_this<generated_writer>
+{
+public:
+	generated_writer(boost::asio::ip::tcp::socket& socket, const reply::done_handler& done,
+			const reply::generator_type& generator, bool chunked)
+		: socket_(socket), done_(done), generator_(generator), chunked_(chunked), more_(true)
+	{}
+
+	void start(reply& head)
+	{
+		auto buffers = head.to_buffers();
+		for (auto iter = buffers.begin(); iter != buffers.end(); iter++)
+			buffer_.append(static_cast<const char*>(iter->data()), iter->size());
+		write();
+	}
+
+private:
+	void next()
+	{
+		if (!more_)
+			return done_(boost::system::error_code());
+		std::string piece;
+		more_ = generator_(piece);
+		buffer_.clear();
+		if (!chunked_)
+			buffer_.swap(piece);
+		else if (!piece.empty())
+			buffer_ = (boost::format("%x\r\n") % piece.size()).str() + piece + "\r\n";
+		if (chunked_ && !more_)
+			buffer_ += "0\r\n\r\n";
+		write();
+	}
+
+	void write()
+	{
+		auto self = shared_from_this();
+		boost::asio::async_write(socket_, boost::asio::buffer(buffer_),
+			[self](const boost::system::error_code& ec, std::size_t) {
+				if (ec)
+					self->done_(ec);
+				else
+					self->next();
+			}
+		);
+	}
+
+	boost::asio::ip::tcp::socket& socket_;
+	reply::done_handler done_;
+	reply::generator_type generator_;
+	bool chunked_;
+	bool more_;
+	std::string buffer_;
+};
+
+} // namespace
+
+void reply::generate(bool chunked, const generator_type& generator)
+{
+	if (chunked)
+		headers.push_back({"Transfer-Encoding", "chunked"});
+	content.clear();
+	auto head = *this;
+	stream = [head, chunked, generator](boost::asio::ip::tcp::socket& socket, const done_handler& done) mutable {
+		std::make_shared<generated_writer>(socket, done, generator, chunked)->start(head);
+	};
+}
+
 reply reply::stock_reply(reply::status_type status)
 {
 	reply rep;
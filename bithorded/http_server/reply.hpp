@@ -11,6 +11,8 @@
 #ifndef HTTP_REPLY_HPP
 #define HTTP_REPLY_HPP
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <boost/asio.hpp>
@@ -29,6 +31,7 @@ struct reply
 		created = 201,
 		accepted = 202,
 		no_content = 204,
+		partial_content = 206,
 		multiple_choices = 300,
 		moved_permanently = 301,
 		moved_temporarily = 302,
@@ -37,10 +40,12 @@ struct reply
 		unauthorized = 401,
 		forbidden = 403,
 		not_found = 404,
+		range_not_satisfiable = 416,
 		internal_server_error = 500,
 		not_implemented = 501,
 		bad_gateway = 502,
-		service_unavailable = 503
+		service_unavailable = 503,
+		gateway_timeout = 504
 	} status;
 
 	/// The headers to be included in the reply.
@@ -49,6 +54,25 @@ struct reply
 	/// The content to be sent in the reply.
 	std::string content;
 
+	/// Called when the stream of a reply is done, or failed.
+	typedef std::function<void (const boost::system::error_code& ec)> done_handler;
+
+	/// Writes the whole reply asynchronously, for replies that can not be
+	/// produced immediately, or are too large to hold in content. When set,
+	/// status, headers and content are ignored.
+	typedef std::function<void (boost::asio::ip::tcp::socket& socket, const done_handler& done)> stream_type;
+	stream_type stream;
+
+	/// Produces the next piece of a generated body into chunk. Returns false
+	/// after the last piece.
+	typedef std::function<bool (std::string& chunk)> generator_type;
+
+	/// Streams status and headers followed by a body from generator, piece by
+	/// piece, letting other handlers run in between. The body is sent with
+	/// chunked transfer-encoding if chunked, otherwise it ends when the
+	/// connection is closed.
+	void generate(bool chunked, const generator_type& generator);
+
 	/// Convert the reply into a vector of buffers. The buffers do not own the
 	/// underlying memory blocks, therefore the reply object must remain valid and
 	/// not be changed until the write operation has completed.
@@ -15,6 +15,7 @@
 */
 
 #include "request.hpp"
+#include "request_handler.hpp"
 
 #include <boost/algorithm/string.hpp>
 
@@ -28,3 +29,91 @@ bool http::server::request::accepts(const string& format) const
 	}
 	return false;
 }
+
+bool http::server::request::keep_alive() const
+{
+	if ((http_version_major < 1) || ((http_version_major == 1) && (http_version_minor < 1)))
+		return false;
+	auto connection = find_header("Connection");
+	return !(connection && boost::iequals(*connection, "close"));
+}
+
+string http::server::request::path() const
+{
+	return uri.substr(0, uri.find('?'));
+}
+
+bool http::server::request::query(const string& name, string& value) const
+{
+	auto start = uri.find('?');
+	if (start == string::npos)
+		return false;
+	vector<string> params;
+	boost::split(params, uri.substr(start+1), boost::is_any_of("&"));
+	for (auto iter = params.begin(); iter != params.end(); iter++) {
+		auto eq = iter->find('=');
+		if (iter->substr(0, eq) != name)
+			continue;
+		return request_handler::url_decode((eq == string::npos) ? string() : iter->substr(eq+1), value);
+	}
+	return false;
+}
+
+const string* http::server::request::find_header(const string& name) const
+{
+	for (auto iter = headers.begin(); iter != headers.end(); iter++) {
+		if (boost::iequals(iter->name, name))
+			return &iter->value;
+	}
+	return NULL;
+}
+
+namespace {
+	bool parseOffset(const string& s, uint64_t& value) {
+		if (s.empty() || (s.find_first_not_of("0123456789") != string::npos) || (s.size() > 19))
+			return false;
+		value = stoull(s);
+		return true;
+	}
+}
+
+http::server::request::range_type http::server::request::range(uint64_t size, uint64_t& first, uint64_t& last) const
+{
+	auto header = find_header("Range");
+	if (!header)
+		return no_range;
+	auto spec = boost::trim_copy(*header);
+	if (!boost::istarts_with(spec, "bytes="))
+		return no_range;
+	spec = boost::trim_copy(spec.substr(6));
+	auto dash = spec.find('-');
+	if ((dash == string::npos) || (spec.find(',') != string::npos))
+		return no_range;
+	auto from = boost::trim_copy(spec.substr(0, dash));
+	auto to = boost::trim_copy(spec.substr(dash+1));
+
+	if (from.empty()) {
+		// Suffix; the last /to/ bytes
+		uint64_t suffix;
+		if (!parseOffset(to, suffix))
+			return no_range;
+		if (!suffix || !size)
+			return unsatisfiable_range;
+		first = (suffix < size) ? size - suffix : 0;
+		last = size - 1;
+		return valid_range;
+	}
+
+	if (!parseOffset(from, first))
+		return no_range;
+	if (to.empty()) {
+		last = size - 1;
+	} else if (!parseOffset(to, last) || (last < first)) {
+		return no_range;
+	}
+	if (first >= size)
+		return unsatisfiable_range;
+	if (last >= size)
+		last = size - 1;
+	return valid_range;
+}
@@ -11,6 +11,7 @@
 #ifndef HTTP_REQUEST_HPP
 #define HTTP_REQUEST_HPP
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 #include "header.hpp"
@@ -28,6 +29,32 @@ struct request
 	std::vector<header> headers;
 
 	bool accepts(const std::string& format) const;
+
+	/// Whether the client wants the connection kept open after the reply;
+	/// by default for HTTP/1.1, unless asking to close.
+	bool keep_alive() const;
+
+	/// Path of the uri, without the query-string.
+	std::string path() const;
+
+	/// URL-decoded value of the first query-parameter with name. Returns
+	/// false if missing.
+	bool query(const std::string& name, std::string& value) const;
+
+	/// Value of the first header with name, compared case-insensitively, or
+	/// NULL if missing.
+	const std::string* find_header(const std::string& name) const;
+
+	enum range_type {
+		no_range,
+		valid_range,
+		unsatisfiable_range,
+	};
+
+	/// Parses a single byte-range from the Range header, against content of
+	/// size bytes, into the inclusive [first, last]. Multiple ranges, other
+	/// units and malformed headers are ignored, serving the whole content.
+	range_type range(uint64_t size, uint64_t& first, uint64_t& last) const;
 };
 
 } // namespace server
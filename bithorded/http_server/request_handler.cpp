@@ -29,7 +29,7 @@ void request_handler::handle_request(const request& req, reply& rep)
 {
 	// Decode url to path.
 	std::list<std::string> request_path;
-	boost::split(request_path, req.uri, boost::is_any_of("/"), boost::algorithm::token_compress_on).size();
+	boost::split(request_path, req.path(), boost::is_any_of("/"), boost::algorithm::token_compress_on).size();
 	for (auto iter=request_path.begin(); iter != request_path.end();) {
 		auto current = iter++;
 		if (current->empty()) {
@@ -33,13 +33,13 @@ public:
 	/// Handle a request and produce a reply.
 	void handle_request(const request& req, reply& rep);
 
-private:
-	/// The directory containing the files to be served.
-	const RequestRouter& _root;
-
 	/// Perform URL-decoding on a string. Returns false if the encoding was
 	/// invalid.
 	static bool url_decode(const std::string& in, std::string& out);
+
+private:
+	/// The directory containing the files to be served.
+	const RequestRouter& _root;
 };
 
 } // namespace server
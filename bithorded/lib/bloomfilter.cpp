@@ -0,0 +1,87 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "bloomfilter.hpp"
+
+#include <algorithm>
+
+using namespace bithorded;
+
+const size_t BITS_PER_ITEM = 10;
+const uint32_t DEFAULT_HASHES = 7;
+
+static uint64_t fnv1a(const std::string& key, uint64_t basis)
+{
+	uint64_t h = basis;
+	for (auto iter = key.begin(); iter != key.end(); iter++) {
+		h ^= static_cast<uint8_t>(*iter);
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+BloomFilter::BloomFilter(size_t bytes, uint32_t hashes) :
+	_bits(std::max<size_t>(bytes, 1), '\0'),
+	_hashes(hashes)
+{
+}
+
+BloomFilter::BloomFilter(const std::string& bits, uint32_t hashes) :
+	_bits(bits),
+	_hashes(hashes)
+{
+}
+
+BloomFilter BloomFilter::forItems(size_t items, size_t maxBytes)
+{
+	return BloomFilter(std::min((items * BITS_PER_ITEM + 7) / 8, maxBytes), DEFAULT_HASHES);
+}
+
+void BloomFilter::insert(const std::string& key)
+{
+	auto h1 = fnv1a(key, 14695981039346656037ULL);
+	auto h2 = fnv1a(key, 1099511628211ULL);
+	uint64_t m = _bits.size() * 8;
+	for (uint32_t n = 0; n < _hashes; n++) {
+		auto bit = (h1 + n*h2) % m;
+		_bits[bit / 8] |= (1 << (bit % 8));
+	}
+}
+
+bool BloomFilter::mayContain(const std::string& key) const
+{
+	if (_bits.empty())
+		return true;
+	auto h1 = fnv1a(key, 14695981039346656037ULL);
+	auto h2 = fnv1a(key, 1099511628211ULL);
+	uint64_t m = _bits.size() * 8;
+	for (uint32_t n = 0; n < _hashes; n++) {
+		auto bit = (h1 + n*h2) % m;
+		if (!(_bits[bit / 8] & (1 << (bit % 8))))
+			return false;
+	}
+	return true;
+}
+
+const std::string& BloomFilter::bits() const
+{
+	return _bits;
+}
+
+uint32_t BloomFilter::hashes() const
+{
+	return _hashes;
+}
@@ -0,0 +1,51 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef BITHORDED_BLOOMFILTER_HPP
+#define BITHORDED_BLOOMFILTER_HPP
+
+#include <stdint.h>
+#include <string>
+
+namespace bithorded {
+
+/**
+ * Bloom filter with the bit- and hash-layout of bithorde::AvailabilitySummary.
+ */
+class BloomFilter
+{
+	std::string _bits;
+	uint32_t _hashes;
+public:
+	BloomFilter(size_t bytes, uint32_t hashes);
+	BloomFilter(const std::string& bits, uint32_t hashes);
+
+	/**
+	 * A filter sized for /items/ keys at about 1% false positives, but at most /maxBytes/ big.
+	 */
+	static BloomFilter forItems(size_t items, size_t maxBytes);
+
+	void insert(const std::string& key);
+	bool mayContain(const std::string& key) const;
+
+	const std::string& bits() const;
+	uint32_t hashes() const;
+};
+
+}
+
+#endif // BITHORDED_BLOOMFILTER_HPP
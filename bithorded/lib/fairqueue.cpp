@@ -0,0 +1,134 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "fairqueue.hpp"
+
+using namespace bithorded;
+
+FairQueue::Flow::Flow(uint16_t weight) :
+	_weight(weight ? weight : 1),
+	_deficit(0),
+	_active(false)
+{
+}
+
+uint16_t FairQueue::Flow::weight() const
+{
+	return _weight;
+}
+
+void FairQueue::Flow::setWeight(uint16_t weight)
+{
+	_weight = weight ? weight : 1;
+}
+
+size_t FairQueue::Flow::queued() const
+{
+	return _jobs.size();
+}
+
+void FairQueue::Flow::clear()
+{
+	_jobs.clear();
+}
+
+FairQueue::FairQueue(size_t maxActive, size_t quantum) :
+	_maxActive(maxActive ? maxActive : 1),
+	_quantum(quantum),
+	_active(0),
+	_pumping(false),
+	_self(std::make_shared<FairQueue*>(this))
+{
+}
+
+FairQueue::Flow::Ptr FairQueue::flow(uint16_t weight)
+{
+	return std::make_shared<Flow>(weight);
+}
+
+void FairQueue::submit(const Flow::Ptr& flow, size_t cost, const Job& job)
+{
+	flow->_jobs.push_back(Flow::Entry{cost, job});
+	if (!flow->_active) {
+		flow->_active = true;
+		flow->_deficit = 0;
+		_flows.push_back(flow);
+	}
+	pump();
+}
+
+size_t FairQueue::active() const
+{
+	return _active;
+}
+
+size_t FairQueue::queued() const
+{
+	size_t res = 0;
+	for (auto iter = _flows.begin(); iter != _flows.end(); iter++)
+		res += (*iter)->_jobs.size();
+	return res;
+}
+
+size_t FairQueue::maxActive() const
+{
+	return _maxActive;
+}
+
+void FairQueue::release()
+{
+	_active--;
+	pump();
+}
+
+void FairQueue::pump()
+{
+	// Jobs may complete, and thus release, while being started
+	if (_pumping)
+		return;
+	_pumping = true;
+	while ((_active < _maxActive) && !_flows.empty()) {
+		auto flow = _flows.front();
+		if (flow->_jobs.empty()) {
+			flow->_active = false;
+			_flows.pop_front();
+			continue;
+		}
+		auto& head = flow->_jobs.front();
+		if (static_cast<int64_t>(head.cost) > flow->_deficit) {
+			// Turn is over, refill and move to the back
+			flow->_deficit += _quantum * flow->_weight;
+			_flows.splice(_flows.end(), _flows, _flows.begin());
+			continue;
+		}
+		flow->_deficit -= head.cost;
+		auto job = std::move(head.job);
+		flow->_jobs.pop_front();
+		if (flow->_jobs.empty()) {
+			flow->_active = false;
+			_flows.pop_front();
+		}
+
+		_active++;
+		std::weak_ptr<FairQueue*> weakSelf(_self);
+		Ticket ticket(static_cast<void*>(0), [=](void*) {
+			if (auto self = weakSelf.lock())
+				(*self)->release();
+		});
+		job(ticket);
+	}
+	_pumping = false;
+}
@@ -0,0 +1,92 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef BITHORDED_FAIRQUEUE_HPP
+#define BITHORDED_FAIRQUEUE_HPP
+
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <stdint.h>
+
+namespace bithorded {
+
+/**
+ * Deficit-round-robin admission of jobs from several flows, keeping at most a fixed number of
+ * jobs active at once. Each flow is served bytes in proportion to its weight.
+ */
+class FairQueue
+{
+public:
+	/**
+	 * Held by an admitted job while active. Releasing the last copy lets the next job in.
+	 */
+	typedef std::shared_ptr<void> Ticket;
+	typedef std::function<void (const Ticket& ticket)> Job;
+
+	class Flow {
+	friend class FairQueue;
+		struct Entry {
+			size_t cost;
+			Job job;
+		};
+		std::deque<Entry> _jobs;
+		uint16_t _weight;
+		int64_t _deficit;
+		bool _active;
+	public:
+		typedef std::shared_ptr<Flow> Ptr;
+		Flow(uint16_t weight);
+
+		uint16_t weight() const;
+		void setWeight(uint16_t weight);
+		size_t queued() const;
+
+		/**
+		 * Drops all queued jobs, without running them.
+		 */
+		void clear();
+	};
+
+	FairQueue(size_t maxActive, size_t quantum);
+
+	Flow::Ptr flow(uint16_t weight);
+
+	/**
+	 * Queues /job/ on /flow/, running it once admitted. /cost/ is normally the bytes it will produce.
+	 */
+	void submit(const Flow::Ptr& flow, size_t cost, const Job& job);
+
+	size_t active() const;
+	size_t queued() const;
+	size_t maxActive() const;
+private:
+	void release();
+	void pump();
+
+	std::list<Flow::Ptr> _flows;
+	size_t _maxActive;
+	size_t _quantum;
+	size_t _active;
+	bool _pumping;
+	std::shared_ptr<FairQueue*> _self;
+};
+
+}
+
+#endif // BITHORDED_FAIRQUEUE_HPP
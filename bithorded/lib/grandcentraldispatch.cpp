@@ -1,5 +1,6 @@
 /*
     Copyright 2016 Ulrik Mikaelsson <ulrik.mikaelsson@gmail.com>
+    Copyright 2026 agent <agent@local>
 
     Licensed under the Apache License, Version 2.0 (the "License");
     you may not use this file except in compliance with the License.
@@ -14,21 +15,200 @@
     limitations under the License.
 */
 
-
 #include "grandcentraldispatch.hpp"
 
-#include <functional>
-
 using namespace bithorded;
 
+namespace {
+	const CancelToken NEVER_CANCELLED;
+	thread_local const CancelToken* currentToken = &NEVER_CANCELLED;
+
+	// The worker running on this thread, if any, so jobs it submits go to its own queue
+	thread_local const GrandCentralDispatch* currentDispatch = NULL;
+	thread_local size_t currentWorker = 0;
+
+	// More urgent jobs taken in a row while a lane waits, before it gets to run one
+	const unsigned STARVATION_LIMIT = 8;
+}
+
+CancelToken CancelToken::create()
+{
+	CancelToken res;
+	res._cancelled = std::make_shared< std::atomic<bool> >(false);
+	return res;
+}
+
+void CancelToken::cancel()
+{
+	if (_cancelled)
+		*_cancelled = true;
+}
+
+const CancelToken& CancelToken::current()
+{
+	return *currentToken;
+}
+
+CancelToken::Scope::Scope(const CancelToken& token) :
+	_previous(currentToken)
+{
+	currentToken = &token;
+}
+
+CancelToken::Scope::~Scope()
+{
+	currentToken = _previous;
+}
+
+const char* GrandCentralDispatch::priorityName(Priority priority)
+{
+	switch (priority) {
+	case INTERACTIVE: return "interactive";
+	case WRITE: return "write";
+	case HASH: return "hash";
+	case MAINTENANCE: return "maintenance";
+	default: return "unknown";
+	}
+}
+
 GrandCentralDispatch::GrandCentralDispatch(boost::asio::io_context& controller, int parallel)
-	: _controller(controller), _work(_jobService)
+	: _controller(controller),
+	_totalQueued(0),
+	_nextQueue(0),
+	_stolen(0),
+	_completions(std::make_shared<Completions>()),
+	_stopping(false)
 {
+	for (auto& queued : _queued)
+		queued = 0;
+	for (auto& passedOver : _passedOver)
+		passedOver = 0;
+	if (parallel < 1)
+		parallel = 1;
+	for (int i = 0; i < parallel; ++i)
+		_queues.emplace_back(new Queue);
 	for (int i = 0; i < parallel; ++i)
-		_workers.create_thread([=]{_jobService.run();});
+		_workers.create_thread([=]{ run(i); });
 }
 
 GrandCentralDispatch::~GrandCentralDispatch() {
-	_jobService.stop();
+	{
+		boost::lock_guard<boost::mutex> lock(_idleMutex);
+		_stopping = true;
+	}
+	_idle.notify_all();
 	_workers.join_all();
 }
+
+size_t GrandCentralDispatch::queued(Priority priority) const
+{
+	return _queued[priority];
+}
+
+uint64_t GrandCentralDispatch::stolen() const
+{
+	return _stolen;
+}
+
+void GrandCentralDispatch::enqueue(Priority priority, Task&& task)
+{
+	size_t idx = (currentDispatch == this) ? currentWorker : (_nextQueue++ % _queues.size());
+	// Counted before queued, so counts never go negative when taken at once
+	_queued[priority]++;
+	_totalQueued++;
+	{
+		auto& queue = *_queues[idx];
+		boost::lock_guard<boost::mutex> lock(queue.mutex);
+		queue.lanes[priority].push_back(std::move(task));
+	}
+	{
+		// Pairs with the check in run(), so a worker about to sleep cannot miss this job
+		boost::lock_guard<boost::mutex> lock(_idleMutex);
+	}
+	_idle.notify_one();
+}
+
+void GrandCentralDispatch::complete(Task&& completion)
+{
+	// Only the first completion of a batch posts a delivery, the rest ride along with it
+	auto completions = _completions;
+	{
+		boost::lock_guard<boost::mutex> lock(completions->mutex);
+		completions->tasks.push_back(std::move(completion));
+		if (completions->tasks.size() > 1)
+			return;
+	}
+	_controller.post([completions]() {
+		std::vector<Task> batch;
+		{
+			boost::lock_guard<boost::mutex> lock(completions->mutex);
+			batch.swap(completions->tasks);
+		}
+		for (auto& task : batch)
+			task();
+	});
+}
+
+bool GrandCentralDispatch::take(size_t worker, Task& task)
+{
+	// A steady stream of urgent jobs would otherwise starve the lanes below it completely
+	for (int priority = 0; priority < PRIORITIES; priority++) {
+		if (_queued[priority] && (_passedOver[priority] >= STARVATION_LIMIT)) {
+			if (takeFrom(priority, worker, task))
+				return true;
+			break;
+		}
+	}
+	for (int priority = 0; priority < PRIORITIES; priority++) {
+		if (takeFrom(priority, worker, task))
+			return true;
+	}
+	return false;
+}
+
+bool GrandCentralDispatch::takeFrom(int priority, size_t worker, Task& task)
+{
+	if (!_queued[priority])
+		return false;
+	auto count = _queues.size();
+	// Own queue first, then steal from the others
+	for (size_t i = 0; i < count; i++) {
+		auto& queue = *_queues[(worker + i) % count];
+		boost::lock_guard<boost::mutex> lock(queue.mutex);
+		auto& lane = queue.lanes[priority];
+		if (lane.empty())
+			continue;
+		task = std::move(lane.front());
+		lane.pop_front();
+		_queued[priority]--;
+		_totalQueued--;
+		if (i)
+			_stolen++;
+		_passedOver[priority] = 0;
+		for (int lower = priority + 1; lower < PRIORITIES; lower++) {
+			if (_queued[lower])
+				_passedOver[lower]++;
+		}
+		return true;
+	}
+	return false;
+}
+
+void GrandCentralDispatch::run(size_t worker)
+{
+	currentDispatch = this;
+	currentWorker = worker;
+	Task task;
+	while (true) {
+		if (take(worker, task)) {
+			task();
+			task = nullptr;
+			continue;
+		}
+		boost::unique_lock<boost::mutex> lock(_idleMutex);
+		while (!_stopping && !_totalQueued)
+			_idle.wait(lock);
+		if (_stopping)
+			return;
+	}
+}
@@ -1,5 +1,6 @@
 /*
     Copyright 2016 Ulrik Mikaelsson <ulrik.mikaelsson@gmail.com>
+    Copyright 2026 agent <agent@local>
 
     Licensed under the Apache License, Version 2.0 (the "License");
     you may not use this file except in compliance with the License.
@@ -14,26 +15,101 @@
     limitations under the License.
 */
 
-
 #ifndef BITHORDED_GRANDCENTRALDISPATCH_HPP
 #define BITHORDED_GRANDCENTRALDISPATCH_HPP
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include <boost/asio/io_context.hpp>
 #include <boost/core/noncopyable.hpp>
 #include <boost/thread.hpp>
 
 namespace bithorded {
 
+/**
+ * Shared by jobs that become pointless together, like the reads of a client that disconnected.
+ * Jobs not yet started when cancelled are skipped, and completions not yet delivered are dropped.
+ */
+class CancelToken {
+	std::shared_ptr< std::atomic<bool> > _cancelled;
+public:
+	/**
+	 * A token that is never cancelled.
+	 */
+	CancelToken() {}
+	static CancelToken create();
+
+	void cancel();
+	bool cancelled() const { return _cancelled && *_cancelled; }
+
+	/**
+	 * Token of the innermost Scope on this thread, for passing implicitly through code unaware of
+	 * it, such as to the reads of an asset.
+	 */
+	static const CancelToken& current();
+
+	class Scope {
+		const CancelToken* _previous;
+	public:
+		explicit Scope(const CancelToken& token);
+		Scope(const Scope&) = delete;
+		~Scope();
+	};
+};
+
 /**
  * The Grand Central Dispatch is a scheme to avoid blocking processing in the mainloop,
  * and to utilize parallelism in a controlled manner. Jobs sent to the GCD is assumed to
  * be const, and have no locking or other threading-issues.
+ *
+ * Each worker has its own queue, with one lane per priority. Workers run the most urgent job
+ * queued anywhere, preferring their own queue and stealing from others when it is empty. A lane
+ * passed over for too many more urgent jobs in a row gets to run one of its own first.
+ * Completions are delivered back to the controller in batches.
  */
 class GrandCentralDispatch : boost::noncopyable
 {
+public:
+	enum Priority {
+		INTERACTIVE, // Reads someone is waiting for
+		WRITE,       // Writes into the cache
+		HASH,        // Verifying written data
+		MAINTENANCE, // Anything no-one waits for
+		PRIORITIES,
+	};
+	static const char* priorityName(Priority priority);
+private:
+	typedef std::function<void()> Task;
+
+	struct Queue {
+		boost::mutex mutex;
+		std::deque<Task> lanes[PRIORITIES];
+	};
+
+	/**
+	 * Completions awaiting delivery to the controller. Shared with posted deliveries, which may
+	 * run after the GCD is gone.
+	 */
+	struct Completions {
+		boost::mutex mutex;
+		std::vector<Task> tasks;
+	};
+
 	boost::asio::io_context& _controller;
-	boost::asio::io_context _jobService;
-	boost::asio::io_context::work _work;
+	std::vector< std::unique_ptr<Queue> > _queues;
+	std::atomic<size_t> _queued[PRIORITIES];
+	std::atomic<unsigned> _passedOver[PRIORITIES];
+	std::atomic<size_t> _totalQueued;
+	std::atomic<size_t> _nextQueue;
+	std::atomic<uint64_t> _stolen;
+	std::shared_ptr<Completions> _completions;
+	boost::mutex _idleMutex;
+	boost::condition_variable _idle;
+	bool _stopping;
 	boost::thread_group _workers;
 public:
 	GrandCentralDispatch(boost::asio::io_context& controller, int parallel);
@@ -41,17 +117,55 @@ public:
 
 	boost::asio::io_context& ioCtx() const { return _controller; }
 
+	/**
+	 * Runs /job/ on a worker, then /handler/ with its result on the controller. Neither runs if
+	 * /token/ is cancelled before they start.
+	 *
+	 * Both are always destroyed on the controller, even when cancelled, since what they hold may
+	 * not be safe to release from a worker.
+	 */
 	template<typename Job, typename CompletionHandler>
-	void submit(Job job, CompletionHandler handler) {
-		_jobService.post([=](){ runJob(job, handler); });
+	void submit(Job job, CompletionHandler handler, Priority priority=MAINTENANCE, const CancelToken& token=CancelToken()) {
+		typedef Pending<Job, CompletionHandler> P;
+		auto pending = std::make_shared<P>(std::move(job), std::move(handler));
+		// The only reference travels with the task and then the completion, never left on a worker
+		enqueue(priority, std::bind([this, token](std::shared_ptr<P>& pending) {
+			if (token.cancelled())
+				return complete(std::bind(&dispose<P>, std::move(pending)));
+			auto res = pending->job();
+			complete(std::bind(&deliver<P, decltype(res)>, std::move(pending), token, std::move(res)));
+		}, std::move(pending)));
 	}
 
+	size_t queued(Priority priority) const;
+
+	/**
+	 * Jobs run by another worker than the one they were queued on.
+	 */
+	uint64_t stolen() const;
+
 private:
 	template<typename Job, typename CompletionHandler>
-	void runJob(Job job, CompletionHandler handler) {
-		auto res = job();
-		_controller.post([=](){ handler(res); });
+	struct Pending {
+		Job job;
+		CompletionHandler handler;
+		Pending(Job&& job, CompletionHandler&& handler) : job(std::move(job)), handler(std::move(handler)) {}
+	};
+
+	template<typename P, typename Result>
+	static void deliver(const std::shared_ptr<P>& pending, const CancelToken& token, const Result& res) {
+		if (!token.cancelled())
+			pending->handler(res);
 	}
+
+	template<typename P>
+	static void dispose(const std::shared_ptr<P>&) {}
+
+	void enqueue(Priority priority, Task&& task);
+	void complete(Task&& completion);
+	bool take(size_t worker, Task& task);
+	bool takeFrom(int priority, size_t worker, Task& task);
+	void run(size_t worker);
 };
 
 }
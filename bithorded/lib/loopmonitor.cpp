@@ -0,0 +1,149 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "loopmonitor.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "log.hpp"
+
+using namespace std;
+
+using namespace bithorded;
+
+namespace bithorded {
+	Logger loopLog;
+}
+
+namespace {
+	thread_local LoopMonitor* loopMonitor = nullptr;
+
+	double toMs(LoopMonitor::Clock::duration d) {
+		return chrono::duration_cast<chrono::microseconds>(d).count() / 1000.0;
+	}
+}
+
+LoopMonitor::Scope::Scope(const char* tag) :
+	_monitor(loopMonitor), _tag(tag)
+{
+	if (_monitor)
+		_started = Clock::now();
+}
+
+LoopMonitor::Scope::~Scope()
+{
+	if (_monitor)
+		_monitor->onHandler(_tag, Clock::now() - _started);
+}
+
+LoopMonitor::LoopMonitor(TimerService& ts, Clock::duration interval, Clock::duration threshold) :
+	_probe(ts, std::bind(&LoopMonitor::onProbe, this)),
+	_interval(interval),
+	_threshold(threshold),
+	_worstLag(Clock::duration::zero()),
+	_slowestTag(nullptr),
+	_slowest(Clock::duration::zero()),
+	_lag("bithorded_loop_lag_seconds", "How late the event-loop ran a probe scheduled at a fixed interval"),
+	_handlers("bithorded_loop_handler_seconds", "Time spent in tagged handlers on the event-loop"),
+	_stalls("bithorded_loop_stalls_total", "Times the event-loop lagged beyond the threshold"),
+	_blockedSeconds("bithorded_loop_blocked_seconds_total", "Time each tagged handler blocked the event-loop beyond the threshold", "counter",
+		std::bind(&LoopMonitor::collectOffenders, this, std::placeholders::_1, std::placeholders::_2, true)),
+	_blockedCount("bithorded_loop_blocked_total", "Times each tagged handler blocked the event-loop beyond the threshold", "counter",
+		std::bind(&LoopMonitor::collectOffenders, this, std::placeholders::_1, std::placeholders::_2, false))
+{
+	loopMonitor = this;
+	if (_interval > Clock::duration::zero())
+		schedule();
+}
+
+LoopMonitor::~LoopMonitor()
+{
+	if (loopMonitor == this)
+		loopMonitor = nullptr;
+}
+
+void LoopMonitor::schedule()
+{
+	_expected = Clock::now() + _interval;
+	_probe.arm(boost::posix_time::microseconds(chrono::duration_cast<chrono::microseconds>(_interval).count()));
+}
+
+void LoopMonitor::onProbe()
+{
+	auto lag = std::max(Clock::now() - _expected, Clock::duration::zero());
+	_lag.record(chrono::duration_cast<chrono::microseconds>(lag).count());
+	_worstLag = std::max(_worstLag, lag);
+	if (lag >= _threshold) {
+		_stalls += 1;
+		if (_slowestTag) {
+			BOOST_LOG_SEV(loopLog, warning) << "Event-loop lagged " << toMs(lag) << "ms, slowest handler was "
+				<< _slowestTag << " running " << toMs(_slowest) << "ms";
+		} else {
+			BOOST_LOG_SEV(loopLog, warning) << "Event-loop lagged " << toMs(lag) << "ms in untagged handlers";
+		}
+	}
+	_slowestTag = nullptr;
+	_slowest = Clock::duration::zero();
+	schedule();
+}
+
+void LoopMonitor::onHandler(const char* tag, Clock::duration duration)
+{
+	_handlers.record(chrono::duration_cast<chrono::microseconds>(duration).count());
+	if (duration > _slowest) {
+		_slowest = duration;
+		_slowestTag = tag;
+	}
+	if (duration >= _threshold) {
+		auto& offender = _offenders[tag];
+		offender.count++;
+		offender.total += duration;
+		offender.worst = std::max(offender.worst, duration);
+		BOOST_LOG_SEV(loopLog, debug) << tag << " blocked the event-loop for " << toMs(duration) << "ms";
+	}
+}
+
+void LoopMonitor::collectOffenders(const string& name, metrics::SampleList& samples, bool seconds) const
+{
+	for (auto iter = _offenders.begin(); iter != _offenders.end(); iter++) {
+		const auto& offender = iter->second;
+		double value = seconds ? chrono::duration<double>(offender.total).count() : offender.count;
+		samples.push_back(metrics::Sample{name, {{"handler", iter->first}}, value});
+	}
+}
+
+void LoopMonitor::describe(management::Info& target) const
+{
+	target << "lag p50 " << (_lag.percentile(0.5) / 1000.0) << "ms, p99 " << (_lag.percentile(0.99) / 1000.0)
+		<< "ms, worst " << toMs(_worstLag) << "ms, " << stalls() << " stalls";
+}
+
+void LoopMonitor::inspect(management::InfoList& target) const
+{
+	// Worst offenders first, by total time blocked
+	vector<decltype(_offenders)::const_iterator> sorted;
+	for (auto iter = _offenders.begin(); iter != _offenders.end(); iter++)
+		sorted.push_back(iter);
+	std::sort(sorted.begin(), sorted.end(), [](decltype(_offenders)::const_iterator a, decltype(_offenders)::const_iterator b) {
+		return a->second.total > b->second.total;
+	});
+	for (auto& iter : sorted) {
+		const auto& offender = iter->second;
+		target.append(iter->first) << offender.count << " times over threshold, worst " << toMs(offender.worst)
+			<< "ms, " << toMs(offender.total) << "ms total";
+	}
+}
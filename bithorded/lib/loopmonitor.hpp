@@ -0,0 +1,99 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef BITHORDED_LOOPMONITOR_HPP
+#define BITHORDED_LOOPMONITOR_HPP
+
+#include <chrono>
+#include <map>
+#include <string>
+
+#include <boost/core/noncopyable.hpp>
+
+#include <lib/timer.h>
+
+#include "management.hpp"
+#include "metrics.hpp"
+
+namespace bithorded {
+
+/**
+ * Watches the responsiveness of the event-loop. A probe is scheduled every interval, and how late
+ * it actually runs is recorded as loop lag.
+ *
+ * Handlers that may block mark themselves with a Scope. Tagged handlers running longer than the
+ * threshold are tallied as offenders, and when the loop lags, the slowest handler since the
+ * previous probe is named in the log.
+ */
+class LoopMonitor : public management::DescriptiveDirectory, boost::noncopyable {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	/**
+	 * Names the handler running on the loop thread while in scope. Scopes may nest, and are
+	 * ignored on other threads, or without a monitor.
+	 */
+	class Scope : boost::noncopyable {
+		LoopMonitor* _monitor;
+		const char* _tag;
+		Clock::time_point _started;
+	public:
+		explicit Scope(const char* tag);
+		~Scope();
+	};
+
+	struct Offender {
+		uint64_t count;
+		Clock::duration total;
+		Clock::duration worst;
+	};
+private:
+	Timer _probe;
+	Clock::duration _interval;
+	Clock::duration _threshold;
+	Clock::time_point _expected;
+	Clock::duration _worstLag;
+	const char* _slowestTag;
+	Clock::duration _slowest;
+	std::map<std::string, Offender> _offenders;
+
+	metrics::Histogram _lag;
+	metrics::Histogram _handlers;
+	metrics::Counter _stalls;
+	metrics::Collector _blockedSeconds, _blockedCount;
+public:
+	/**
+	 * Monitors the loop of the calling thread. interval 0 disables probing, but still tallies
+	 * offenders.
+	 */
+	LoopMonitor(TimerService& ts, Clock::duration interval, Clock::duration threshold);
+	virtual ~LoopMonitor();
+
+	const std::map<std::string, Offender>& offenders() const { return _offenders; }
+	uint64_t stalls() const { return _stalls.value(); }
+
+	virtual void describe(management::Info& target) const;
+	virtual void inspect(management::InfoList& target) const;
+private:
+	void schedule();
+	void onProbe();
+	void onHandler(const char* tag, Clock::duration duration);
+	void collectOffenders(const std::string& name, metrics::SampleList& samples, bool seconds) const;
+};
+
+}
+
+#endif // BITHORDED_LOOPMONITOR_HPP
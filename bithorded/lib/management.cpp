@@ -17,11 +17,16 @@
 
 #include "management.hpp"
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <sstream>
 #include <string>
 
+#include <boost/lexical_cast.hpp>
+
 using namespace std;
 
 using namespace bithorded::management;
@@ -78,8 +83,47 @@ ostream& Info::renderJSON(ostream& output) const {
 	return output;
 }
 
+namespace {
+	/// Entries rendered per write, when streaming a directory
+	const size_t RENDER_BATCH = 256;
+}
+
+InfoList::InfoList() :
+	offset(0),
+	limit(std::numeric_limits<size_t>::max()),
+	total(0),
+	_discarded(NULL, string())
+{}
+
+bool InfoList::matches(const string& name) const
+{
+	return filter.empty() || (name.find(filter) != string::npos);
+}
+
+void InfoList::window(size_t count, size_t& first, size_t& last) const
+{
+	auto end = offset + std::min(limit, std::numeric_limits<size_t>::max() - offset);
+	first = (offset > total) ? std::min(offset - total, count) : 0;
+	last = (end > total) ? std::min(end - total, count) : 0;
+	last = std::max(first, last);
+}
+
+void InfoList::skip(size_t count)
+{
+	total += count;
+}
+
 Info& InfoList::append(const string& name, const http::server::RequestRouter* child, const Leaf* renderer)
 {
+	bool listed = false;
+	if (matches(name)) {
+		auto idx = total++;
+		listed = (idx >= offset) && (idx - offset < limit);
+	}
+	if (!listed) {
+		_discarded.str(string());
+		return _discarded;
+	}
 	push_back(Info(child, name));
 	if (renderer)
 		renderer->describe(back());
@@ -97,58 +141,112 @@ Info& InfoList::append(const string& name, const Leaf& leaf)
 }
 
 ostream& InfoList::renderHTML(ostream& output) const {
-	output << "<html><head><title>Bithorde Management</title></head><body>"
-		<< "<table><tr><th>Name</th><th>Value</th></tr>";
+	return render(output, HTML, 0, size());
+}
 
-	for (auto iter=begin(); iter != end(); iter++) {
-		iter->renderHTML(output);
-	}
+ostream& InfoList::renderJSON(ostream& output) const {
+	return render(output, JSON, 0, size());
+}
 
-	output << "</table></body></html>";
-	return output;
+ostream& InfoList::renderText(ostream& output) const {
+	return render(output, TEXT, 0, size());
 }
 
-ostream& InfoList::renderJSON(ostream& output) const {
-	output << "{";
-	for (auto iter=begin(); iter != end(); iter++) {
-		if (iter != begin()) {
-			output << ',';
+ostream& InfoList::render(ostream& output, Format format, size_t first, size_t last) const {
+	if (first == 0) {
+		switch (format) {
+		case HTML:
+			output << "<html><head><title>Bithorde Management</title></head><body>"
+				<< "<table><tr><th>Name</th><th>Value</th></tr>";
+			break;
+		case JSON:
+			output << "{";
+			break;
+		case TEXT:
+			break;
 		}
-		iter->renderJSON(output);
 	}
-	output << "}";
 
-	return output;
-}
-
-ostream& InfoList::renderText(ostream& output) const {
-	for (auto iter=begin(); iter != end(); iter++) {
-		iter->renderText(output);
+	for (auto idx = first; idx < last; idx++) {
+		auto& info = at(idx);
+		switch (format) {
+		case HTML:
+			info.renderHTML(output);
+			break;
+		case JSON:
+			if (idx)
+				output << ',';
+			info.renderJSON(output);
+			break;
+		case TEXT:
+			info.renderText(output);
+			break;
+		}
 	}
 
+	if (last == size()) {
+		switch (format) {
+		case HTML:
+			output << "</table>";
+			if (size() < total)
+				output << "<p>" << offset << '-' << (offset + size()) << " of " << total << "</p>";
+			output << "</body></html>";
+			break;
+		case JSON:
+			output << "}";
+			break;
+		case TEXT:
+			break;
+		}
+	}
 	return output;
 }
 
 bool Directory::handle(const http::server::RequestRouter::path& path, const http::server::request& req, http::server::reply& reply) const
 {
-	InfoList table;
-	inspect(table);
 	if (path.empty()) {
-		std::ostringstream buf;
-		std::string type;
+		auto table = std::make_shared<InfoList>();
+		string param;
+		try {
+			req.query("filter", table->filter);
+			if (req.query("offset", param))
+				table->offset = boost::lexical_cast<size_t>(param);
+			if (req.query("limit", param))
+				table->limit = boost::lexical_cast<size_t>(param);
+		} catch (const boost::bad_lexical_cast&) {
+			reply = http::server::reply::stock_reply(http::server::reply::bad_request);
+			return true;
+		}
+		inspect(*table);
 
+		InfoList::Format format;
+		string type;
 		if (type = "application/json", req.accepts(type)) {
-			table.renderJSON(buf);
+			format = InfoList::JSON;
 		} else if (type = "text/html", req.accepts(type)) {
-			table.renderHTML(buf);
+			format = InfoList::HTML;
 		} else {
 			type = "text/plain";
-			table.renderText(buf);
+			format = InfoList::TEXT;
 		}
 
-		reply.fill(buf.str(), type);
+		// Rendered in batches, to not hold up the loop on large directories
+		reply.status = http::server::reply::ok;
+		reply.headers.push_back({"Content-Type", type});
+		reply.headers.push_back({"X-Total-Count", boost::lexical_cast<string>(table->total)});
+		size_t rendered = 0;
+		reply.generate(req.keep_alive(), [table, format, rendered](string& chunk) mutable {
+			auto last = std::min(rendered + RENDER_BATCH, table->size());
+			std::ostringstream buf;
+			table->render(buf, format, rendered, last);
+			chunk = buf.str();
+			rendered = last;
+			return rendered < table->size();
+		});
 		return true;
 	} else {
+		InfoList table;
+		inspect(table);
 		auto node = path.begin();
 		for (auto iter = table.begin(); iter != table.end(); iter++) {
 			if (iter->child && (*node == iter->name))
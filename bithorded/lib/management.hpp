@@ -19,6 +19,7 @@
 #define MANAGEMENT_HPP
 
 #include <sstream>
+#include <vector>
 
 #include "../http_server/request_router.hpp"
 
@@ -47,6 +48,31 @@ public:
 
 class DescriptiveDirectory;
 struct InfoList : public std::vector<Info> {
+	enum Format {
+		TEXT,
+		HTML,
+		JSON,
+	};
+
+	/// Only entries with names containing filter are listed, and of those the limit from offset, to
+	/// page through large directories. All matching entries are counted in total.
+	std::string filter;
+	size_t offset;
+	size_t limit;
+	size_t total;
+
+	InfoList();
+
+	bool matches(const std::string& name) const;
+
+	/// Of /count/ further matching entries, the range [first, last) that would be listed. Directories with
+	/// many entries may use it to only format those, and skip() the rest.
+	void window(size_t count, size_t& first, size_t& last) const;
+
+	/// Counts /count/ matching entries as passed, without listing them.
+	void skip(size_t count);
+
+	/// Entries outside the window are returned as a scratch Info, and not listed.
 	Info& append(const std::string& name, const http::server::RequestRouter* child=NULL, const Leaf* renderer=NULL);
 	Info& append(const std::string& name, const DescriptiveDirectory& dir);
 	Info& append(const std::string& name, const Leaf& leaf);
@@ -54,6 +80,12 @@ struct InfoList : public std::vector<Info> {
 	std::ostream& renderHTML(std::ostream& output) const;
 	std::ostream& renderJSON(std::ostream& output) const;
 	std::ostream& renderText(std::ostream& output) const;
+
+	/// Renders the entries [first, last), with the header before the first entry and the footer after the
+	/// last, so large lists can be rendered piecewise.
+	std::ostream& render(std::ostream& output, Format format, size_t first, size_t last) const;
+private:
+	Info _discarded;
 };
 
 class Directory : public http::server::RequestRouter
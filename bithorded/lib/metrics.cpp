@@ -0,0 +1,245 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "metrics.hpp"
+
+#include <lib/trace.h>
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+using namespace bithorded::metrics;
+
+namespace {
+	void renderLabels(ostream& output, const Labels& labels) {
+		if (labels.empty())
+			return;
+		output << '{';
+		for (auto iter = labels.begin(); iter != labels.end(); iter++) {
+			if (iter != labels.begin())
+				output << ',';
+			output << iter->first << "=\"";
+			for (auto c : iter->second) {
+				switch (c) {
+				case '\\': output << "\\\\"; break;
+				case '"': output << "\\\""; break;
+				case '\n': output << "\\n"; break;
+				default: output << c;
+				}
+			}
+			output << '"';
+		}
+		output << '}';
+	}
+
+	void renderValue(ostream& output, double value) {
+		if (std::isinf(value))
+			output << (value > 0 ? "+Inf" : "-Inf");
+		else if ((std::floor(value) == value) && (std::fabs(value) < 9007199254740992.0))
+			output << static_cast<int64_t>(value);
+		else
+			output << std::setprecision(12) << value;
+	}
+}
+
+Metric::Metric(const string& name, const string& help, const char* type, const Labels& labels) :
+	_name(name), _help(help), _type(type), _labels(labels)
+{
+	Registry::instance().add(this);
+}
+
+Metric::~Metric()
+{
+	Registry::instance().remove(this);
+}
+
+Counter::Counter(const string& name, const string& help, const Labels& labels) :
+	Metric(name, help, "counter", labels), _value(0)
+{}
+
+void Counter::collect(SampleList& samples) const
+{
+	samples.push_back(Sample{name(), _labels, static_cast<double>(value())});
+}
+
+const int Histogram::SUB_BITS;
+const int Histogram::BUCKETS;
+
+Histogram::Histogram(const string& name, const string& help, const Labels& labels, double scale) :
+	Metric(name, help, "histogram", labels), _count(0), _sum(0), _scale(scale)
+{
+	for (auto& bucket : _buckets)
+		bucket.store(0, std::memory_order_relaxed);
+}
+
+int Histogram::bucketOf(uint64_t value)
+{
+	const uint64_t SUB_BUCKETS = 1 << SUB_BITS;
+	if (value < SUB_BUCKETS)
+		return value;
+	int exponent = 63 - __builtin_clzll(value);
+	return ((exponent - SUB_BITS + 1) << SUB_BITS) + ((value >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+uint64_t Histogram::lowerBound(int bucket)
+{
+	const int SUB_BUCKETS = 1 << SUB_BITS;
+	if (bucket < SUB_BUCKETS)
+		return bucket;
+	int exponent = (bucket >> SUB_BITS) + SUB_BITS - 1;
+	uint64_t sub = bucket & (SUB_BUCKETS - 1);
+	return (SUB_BUCKETS + sub) << (exponent - SUB_BITS);
+}
+
+void Histogram::record(uint64_t value)
+{
+	_buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
+	_sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+void Histogram::recordSince(std::chrono::steady_clock::time_point start)
+{
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+uint64_t Histogram::percentile(double percentile) const
+{
+	uint64_t count = this->count();
+	if (!count)
+		return 0;
+	uint64_t rank = std::ceil(count * percentile);
+	if (rank < 1)
+		rank = 1;
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKETS; i++) {
+		seen += _buckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank)
+			return lowerBound(i);
+	}
+	return lowerBound(BUCKETS - 1);
+}
+
+void Histogram::collect(SampleList& samples) const
+{
+	// Exported at power-of-two boundaries, up to the largest one seen. Boundaries are never
+	// removed, since counts never decrease.
+	int highest = -1;
+	for (int i = BUCKETS - 1; i >= 0; i--) {
+		if (_buckets[i].load(std::memory_order_relaxed)) {
+			highest = i;
+			break;
+		}
+	}
+	const int SUB_BUCKETS = 1 << SUB_BITS;
+	uint64_t cumulative = 0;
+	for (int i = 0; i <= highest; i++) {
+		cumulative += _buckets[i].load(std::memory_order_relaxed);
+		// Last bucket below a power of two. The boundary itself is counted in the next one.
+		if ((i + 1 < BUCKETS) && ((i + 1 < SUB_BUCKETS) || ((i + 1) % SUB_BUCKETS == 0))) {
+			auto labels = _labels;
+			std::ostringstream le;
+			renderValue(le, lowerBound(i + 1) * _scale);
+			labels.emplace_back("le", le.str());
+			samples.push_back(Sample{name() + "_bucket", labels, static_cast<double>(cumulative)});
+		}
+	}
+	auto labels = _labels;
+	labels.emplace_back("le", "+Inf");
+	samples.push_back(Sample{name() + "_bucket", labels, static_cast<double>(count())});
+	samples.push_back(Sample{name() + "_sum", _labels, sum() * _scale});
+	samples.push_back(Sample{name() + "_count", _labels, static_cast<double>(count())});
+}
+
+Collector::Collector(const string& name, const string& help, const char* type, const Collector::Function& function) :
+	Metric(name, help, type), _function(function)
+{}
+
+void Collector::collect(SampleList& samples) const
+{
+	_function(name(), samples);
+}
+
+Registry& Registry::instance()
+{
+	static Registry instance;
+	return instance;
+}
+
+void Registry::add(const Metric* metric)
+{
+	lock_guard<mutex> guard(_lock);
+	_metrics.emplace(metric->name(), metric);
+}
+
+void Registry::remove(const Metric* metric)
+{
+	lock_guard<mutex> guard(_lock);
+	auto range = _metrics.equal_range(metric->name());
+	for (auto iter = range.first; iter != range.second; iter++) {
+		if (iter->second == metric) {
+			_metrics.erase(iter);
+			return;
+		}
+	}
+}
+
+ostream& Registry::render(ostream& output) const
+{
+	lock_guard<mutex> guard(_lock);
+	SampleList samples;
+	for (auto iter = _metrics.begin(); iter != _metrics.end(); iter++) {
+		auto metric = iter->second;
+		if (iter == _metrics.begin() || (prev(iter)->first != iter->first)) {
+			output << "# HELP " << metric->name() << ' ' << metric->help() << '\n'
+				<< "# TYPE " << metric->name() << ' ' << metric->type() << '\n';
+		}
+		samples.clear();
+		metric->collect(samples);
+		for (auto& sample : samples) {
+			output << sample.name;
+			renderLabels(output, sample.labels);
+			output << ' ';
+			renderValue(output, sample.value);
+			output << '\n';
+		}
+	}
+	return output;
+}
+
+bool Exporter::handle(const path& path, const http::server::request& req, http::server::reply& reply) const
+{
+	if (!path.empty())
+		return false;
+	std::ostringstream buf;
+	Registry::instance().render(buf);
+	reply.fill(buf.str(), "text/plain; version=0.0.4");
+	return true;
+}
+
+bool TraceExporter::handle(const path& path, const http::server::request& req, http::server::reply& reply) const
+{
+	if (!path.empty())
+		return false;
+	std::ostringstream buf;
+	bithorde::trace::Tracer::instance().renderChromeTrace(buf);
+	reply.fill(buf.str(), "application/json");
+	return true;
+}
@@ -0,0 +1,160 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef BITHORDED_METRICS_HPP
+#define BITHORDED_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/core/noncopyable.hpp>
+
+#include "../http_server/request_router.hpp"
+
+namespace bithorded {
+
+namespace metrics {
+
+typedef std::vector< std::pair<std::string, std::string> > Labels;
+
+struct Sample {
+	std::string name;
+	Labels labels;
+	double value;
+};
+typedef std::vector<Sample> SampleList;
+
+/**
+ * A metric exported in the Prometheus text format. Metrics register themselves with the Registry
+ * for their lifetime. Several metrics may share a name, with differing labels.
+ */
+class Metric : boost::noncopyable {
+	std::string _name, _help;
+	const char* _type;
+protected:
+	Labels _labels;
+public:
+	Metric(const std::string& name, const std::string& help, const char* type, const Labels& labels=Labels());
+	virtual ~Metric();
+
+	const std::string& name() const { return _name; }
+	const std::string& help() const { return _help; }
+	const char* type() const { return _type; }
+
+	virtual void collect(SampleList& samples) const = 0;
+};
+
+class Counter : public Metric {
+	std::atomic<uint64_t> _value;
+public:
+	Counter(const std::string& name, const std::string& help, const Labels& labels=Labels());
+
+	void operator+=(uint64_t amount) { _value.fetch_add(amount, std::memory_order_relaxed); }
+	uint64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+	virtual void collect(SampleList& samples) const;
+};
+
+/**
+ * Log-linear histogram, in the spirit of HDR histograms. Each power of two is split in four
+ * buckets, bounding the error to 25% over the full 64-bit range in constant memory. Recording
+ * is lock-free and safe from any thread.
+ *
+ * Values are recorded in integral units, and multiplied by /scale/ on export, so durations
+ * can be recorded in microseconds and exported in seconds.
+ */
+class Histogram : public Metric {
+public:
+	static const int SUB_BITS = 2;
+	static const int BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+private:
+	std::array<std::atomic<uint64_t>, BUCKETS> _buckets;
+	std::atomic<uint64_t> _count, _sum;
+	double _scale;
+public:
+	Histogram(const std::string& name, const std::string& help, const Labels& labels=Labels(), double scale=1e-6);
+
+	static int bucketOf(uint64_t value);
+	static uint64_t lowerBound(int bucket);
+
+	void record(uint64_t value);
+
+	/// Records the microseconds passed since start
+	void recordSince(std::chrono::steady_clock::time_point start);
+
+	uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+	uint64_t sum() const { return _sum.load(std::memory_order_relaxed); }
+
+	/// Lower bound of the bucket holding the given percentile, 0 if empty.
+	uint64_t percentile(double percentile) const;
+
+	virtual void collect(SampleList& samples) const;
+};
+
+/**
+ * Produces samples on demand, for state owned elsewhere, such as per-peer statistics.
+ */
+class Collector : public Metric {
+public:
+	typedef std::function<void (const std::string& name, SampleList& samples)> Function;
+private:
+	Function _function;
+public:
+	Collector(const std::string& name, const std::string& help, const char* type, const Function& function);
+
+	virtual void collect(SampleList& samples) const;
+};
+
+class Registry : boost::noncopyable {
+	mutable std::mutex _lock;
+	std::multimap<std::string, const Metric*> _metrics;
+public:
+	static Registry& instance();
+
+	void add(const Metric* metric);
+	void remove(const Metric* metric);
+
+	std::ostream& render(std::ostream& output) const;
+};
+
+/**
+ * Serves the Registry in the Prometheus text exposition format.
+ */
+class Exporter : public http::server::RequestRouter {
+public:
+	virtual bool handle(const path& path, const http::server::request& req, http::server::reply& reply) const;
+};
+
+/**
+ * Serves the spans buffered by the bithorde::trace::Tracer, as Chrome trace JSON.
+ */
+class TraceExporter : public http::server::RequestRouter {
+public:
+	virtual bool handle(const path& path, const http::server::request& req, http::server::reply& reply) const;
+};
+
+}}
+
+#endif // BITHORDED_METRICS_HPP
@@ -16,6 +16,7 @@
 
 
 #include "randomaccessfile.hpp"
+#include "metrics.hpp"
 
 #include <boost/assert.hpp>
 #include <boost/filesystem.hpp>
@@ -30,6 +31,11 @@ using namespace bithorded;
 namespace bsys = boost::system;
 namespace fs = boost::filesystem;
 
+namespace {
+	metrics::Histogram diskReadLatency("bithorded_disk_io_seconds", "Latency of disk reads and writes", {{"op", "read"}});
+	metrics::Histogram diskWriteLatency("bithorded_disk_io_seconds", "Latency of disk reads and writes", {{"op", "write"}});
+}
+
 ssize_t IDataArray::write ( uint64_t offset, const string& buf ) {
 	return write(offset, buf.data(), buf.length());
 }
@@ -117,17 +123,26 @@ uint32_t RandomAccessFile::blocks(size_t blockSize) const
 ssize_t RandomAccessFile::read ( uint64_t offset, size_t size, byte* buf ) const {
 	BOOST_ASSERT(buf);
 	BOOST_ASSERT(offset+size <= _size);
-	return pread(_fd, buf, size, offset);
+	auto start = std::chrono::steady_clock::now();
+	auto res = pread(_fd, buf, size, offset);
+	diskReadLatency.recordSince(start);
+	return res;
 }
 
 ssize_t RandomAccessFile::write(uint64_t offset, const void* src, size_t size)
 {
+	auto start = std::chrono::steady_clock::now();
 	ssize_t written = pwrite(_fd, src, size, offset);
+	diskWriteLatency.recordSince(start);
 	if ((size_t)written != size)
 		throw std::ios_base::failure("Failed to write");
 	return written;
 }
 
+int RandomAccessFile::fileDescriptor(uint64_t& offset) const {
+	return _fd;
+}
+
 string RandomAccessFile::describe() {
 	return _path.string();
 }
@@ -167,6 +182,11 @@ ssize_t DataArraySlice::write ( uint64_t offset, const void* src, size_t size )
 	return _parent->write(_offset + offset, src, size);
 }
 
+int DataArraySlice::fileDescriptor ( uint64_t& offset ) const {
+	offset += _offset;
+	return _parent->fileDescriptor(offset);
+}
+
 string DataArraySlice::describe() {
 	ostringstream buf;
 	buf << _parent->describe() << '[' << _offset << ':' << _size << ']';
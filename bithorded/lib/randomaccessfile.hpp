@@ -51,6 +51,12 @@ public:
 	 */
 	virtual ssize_t write(uint64_t offset, const std::string& buf);
 
+	/**
+	 * The open file holding the data, for zero-copy transfers. /offset/ is translated to the
+	 * position in the file. -1 if not backed by a single file.
+	 */
+	virtual int fileDescriptor(uint64_t& offset) const { return -1; }
+
 	/**
 	 * Describe the DataArray I.E. the name of the file
 	 */
@@ -105,6 +111,7 @@ public:
 	/// Implement IDataArray
 	virtual ssize_t read(uint64_t offset, size_t size, byte* buf) const;
 	virtual ssize_t write(uint64_t offset, const void* src, size_t size);
+	virtual int fileDescriptor(uint64_t& offset) const;
 	virtual std::string describe();
 
 	/**
@@ -122,6 +129,7 @@ public:
 	virtual uint64_t size() const;
 	virtual ssize_t read ( uint64_t offset, size_t size, byte* buf ) const;
 	virtual ssize_t write ( uint64_t offset, const void* src, size_t size );
+	virtual int fileDescriptor ( uint64_t& offset ) const;
     virtual std::string describe();
 };
 
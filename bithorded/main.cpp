@@ -2,6 +2,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/log/core.hpp>
 #include <boost/log/utility/setup.hpp>
+#include <csignal>
 #include <iostream>
 
 #include "buildconf.hpp"
@@ -26,6 +27,9 @@ int main(int argc, char* argv[]) {
 	boost::log::register_simple_formatter_factory< bithorded::log_severity_level, char >("Severity");
 	boost::log::add_common_attributes();
 
+	// A peer hanging up should show up as EPIPE on the socket; sendfile() has no MSG_NOSIGNAL
+	signal(SIGPIPE, SIG_IGN);
+
 	try {
 		Config cfg(argc, argv);
 		boost::log::add_console_log(std::clog, keywords::format = cfg.logFormat, keywords::filter = "%Severity% >= " + cfg.logLevel);
@@ -26,24 +26,48 @@
 #include <lib/random.h>
 
 #include <bithorded/lib/log.hpp>
+#include <bithorded/server/server.hpp>
 
 using namespace bithorde;
 using namespace bithorded::router;
 using namespace std;
 
 const int32_t DEFAULT_TIMEOUT_MS = 5000;
+const size_t MIN_HEDGE_SAMPLES = 8;
 
 namespace bithorded { namespace router {
 	Logger assetLogger;
 } }
 
+std::vector<UpstreamRead>::iterator PendingRead::findAttempt(const std::string& peername, int reqid)
+{
+	for (auto iter = attempts.begin(); iter != attempts.end(); iter++) {
+		if (iter->peername == peername && iter->reqid == reqid)
+			return iter;
+	}
+	return attempts.end();
+}
+
+bool PendingRead::hasTried(const std::string& peername) const
+{
+	for (auto iter = attempts.begin(); iter != attempts.end(); iter++) {
+		if (iter->peername == peername)
+			return true;
+	}
+	return false;
+}
+
 void PendingRead::cancel()
 {
-	cb(offset, bithorde::NullBuffer::instance);
+	for (auto iter = waiters.begin(); iter != waiters.end(); iter++)
+		iter->cb(iter->offset, bithorde::NullBuffer::instance);
 }
 
 UpstreamBinding::UpstreamBinding(std::shared_ptr<ForwardedAsset> parent, std::string peerName, bithorded::Client::Ptr f, bithorde::Ids ids) :
-	ReadAsset(f, ids)
+	ReadAsset(f, ids),
+	reads("reads"),
+	hedged("reads"),
+	hedgeWins("reads")
 {
 	auto parent_ = std::weak_ptr<ForwardedAsset>(parent);
 
@@ -51,7 +75,7 @@ UpstreamBinding::UpstreamBinding(std::shared_ptr<ForwardedAsset> parent, std::st
 		if (auto p = parent_.lock()) { p->onUpstreamStatus(peerName, status); }
 	});
 	_dataConnection = dataArrived.connect([=](uint64_t offset, const std::shared_ptr<bithorde::IBuffer>& data, int tag) {
-		if (auto p = parent_.lock()) { p->onData(offset, data, tag); }
+		if (auto p = parent_.lock()) { p->onData(peerName, offset, data, tag); }
 	});
 }
 
@@ -60,15 +84,26 @@ ForwardedAsset::ForwardedAsset(Router& router, const bithorde::Ids& ids) :
 	_requestedIds(ids),
 	_reqParameters(NULL),
 	_size(-1),
+	_loopDetected(false),
+	_answeredNotFound(false),
+	_upstreamLost(false),
+	_broadcast(false),
 	_upstream(),
-	_pendingReads()
+	_pendingReads(),
+	_nextReadId(0),
+	_sendingRead(-1),
+	_largestRead(0)
 {
 }
 
 ForwardedAsset::~ForwardedAsset()
 {
-	for (auto iter=_pendingReads.begin(); iter != _pendingReads.end(); iter++)
-		iter->cancel();
+	for (auto iter=_pendingReads.begin(); iter != _pendingReads.end(); iter++) {
+		auto& read = iter->second;
+		for (auto attempt = read.attempts.begin(); attempt != read.attempts.end(); attempt++)
+			_router.upstreamWindow(attempt->peername).released(read.size);
+		read.cancel();
+	}
 }
 
 bool bithorded::router::ForwardedAsset::hasUpstream(const std::string peername)
@@ -86,6 +121,8 @@ void bithorded::router::ForwardedAsset::apply(const bithorded::AssetRequestParam
 	auto requesters_ = requestTrace(current.requesters);
 	auto& friends = _router.connectedFriends();
 	_reqParameters = &current;
+	if (current.requesters.empty())
+		_skipped.clear(); // Nobody left to fall back to them for
 
 	int32_t timeout(DEFAULT_TIMEOUT_MS);
 	if ((status->status() != bithorde::SUCCESS) && (!current.deadline.is_special())) {
@@ -108,12 +145,29 @@ void bithorded::router::ForwardedAsset::apply(const bithorded::AssetRequestParam
 				dropUpstream(peername);
 			}
 		} else if (bind_new) {
-			addUpstream(f, timeout, requesters_);
+			if (!_broadcast && !_router.mayHave(peername, _requestedIds))
+				_skipped.insert(peername);
+			else
+				addUpstream(f, timeout, requesters_);
 		}
 	}
 	updateStatus();
 }
 
+void ForwardedAsset::bindSkipped()
+{
+	// None of the friends likely to have the asset had it, fall back to asking the others
+	_broadcast = true;
+	auto& friends = _router.connectedFriends();
+	for (auto iter = _skipped.begin(); iter != _skipped.end(); iter++) {
+		auto f = friends.find(*iter);
+		if ((f != friends.end()) && !_upstream.count(*iter) && !_reqParameters->isRequester(f->second))
+			addUpstream(f->second);
+	}
+	_skipped.clear();
+	updateStatus();
+}
+
 void ForwardedAsset::addUpstream(const bithorded::Client::Ptr& f)
 {
 	int32_t timeout(DEFAULT_TIMEOUT_MS);
@@ -127,10 +181,12 @@ void bithorded::router::ForwardedAsset::addUpstream(const bithorded::Client::Ptr
 	const auto& peername = f->peerName();
 	BOOST_ASSERT( _router.connectedFriends().count(peername) );
 
-	auto inserted = _upstream.emplace(std::piecewise_construct, std::make_tuple(peername), std::make_tuple	(shared_from_this(), peername, f, _requestedIds));
+	// With several streams to the friend, the asset sticks to one of them for all its reads
+	auto stream = _router.pickStream(peername);
+	auto inserted = _upstream.emplace(std::piecewise_construct, std::make_tuple(peername), std::make_tuple	(shared_from_this(), peername, stream, _requestedIds));
 	BOOST_ASSERT( inserted.second );
 
-	if ( !f->bind(inserted.first->second, timeout, requesters) )
+	if ( !stream->bind(inserted.first->second, timeout, requesters) )
 		_upstream.erase(peername);
 }
 
@@ -142,6 +198,7 @@ void bithorded::router::ForwardedAsset::onUpstreamStatus(const string& peername,
 		}
 		if ( overlaps(_reqParameters->requesters, status.servers().begin(), status.servers().end()) ) {
 			BOOST_LOG_SEV(assetLogger, bithorded::debug) << idsToString(_requestedIds) << " Loop detected " << peername;
+			_loopDetected = true;
 			dropUpstream(peername);
 		} else {
 			BOOST_LOG_SEV(assetLogger, bithorded::debug) << idsToString(_requestedIds) << " Found upstream " << peername;
@@ -150,6 +207,7 @@ void bithorded::router::ForwardedAsset::onUpstreamStatus(const string& peername,
 					_size = status.size();
 				} else if (_size != (int64_t)status.size()) {
 					BOOST_LOG_SEV(assetLogger, bithorded::warning) << peername << " " << idsToString(_requestedIds) << " responded with mismatching size, ignoring...";
+					_upstreamLost = true;
 					dropUpstream(peername);
 				}
 			} else if (status.ids().size()) {
@@ -158,6 +216,11 @@ void bithorded::router::ForwardedAsset::onUpstreamStatus(const string& peername,
 		}
 	} else {
 		BOOST_LOG_SEV(assetLogger, bithorded::debug) << idsToString(_requestedIds) << " Failed upstream " << peername;
+		// Only a live upstream saying NOTFOUND is an answer, not one that disconnected or failed
+		if (status.status() == bithorde::Status::NOTFOUND)
+			_answeredNotFound = true;
+		else
+			_upstreamLost = true;
 		dropUpstream(peername);
 	}
 	updateStatus();
@@ -170,6 +233,17 @@ void bithorded::router::ForwardedAsset::updateStatus() {
 		if (asset.status == bithorde::Status::SUCCESS)
 			status = bithorde::Status::SUCCESS;
 	}
+	// Upstreams are also dropped when the last downstream leaves, which calls for neither
+	// falling back to skipped friends, nor remembering a miss.
+	bool requested = _reqParameters && !_reqParameters->requesters.empty();
+	if ((status == bithorde::Status::NOTFOUND) && requested && !_broadcast && !_skipped.empty())
+		return bindSkipped();
+	// A miss is when every upstream asked answered NOTFOUND. Not when the asset was once found,
+	// or an upstream went away without answering.
+	bool missed = _answeredNotFound && !_upstreamLost && !_loopDetected;
+	if ((status == bithorde::Status::NOTFOUND) && (this->status->status() == bithorde::Status::NONE) && missed && requested)
+		_router.rememberMiss(_requestedIds);
+
 	auto trx = this->status.change();
 	if (_size > 0) {
 		trx->set_size(_size);
@@ -204,34 +278,250 @@ void bithorded::router::ForwardedAsset::asyncRead(uint64_t offset, size_t size,
 {
 	if (_upstream.empty())
 		return cb(-1, bithorde::NullBuffer::instance);
-	auto chosen = _upstream.begin();
+
+	// Piggyback on an in-flight read covering the same range, if any
+	auto candidate = _pendingByOffset.upper_bound(offset);
+	while (candidate != _pendingByOffset.begin()) {
+		candidate--;
+		if (candidate->first + _largestRead <= offset)
+			break;
+		auto& inflight = _pendingReads.at(candidate->second);
+		if (offset + size <= inflight.offset + inflight.size) {
+			inflight.waiters.push_back(ReadWaiter{offset, size, cb, bithorde::trace::Span(bithorde::trace::Context::current())});
+			return;
+		}
+	}
+
+	auto now = boost::posix_time::microsec_clock::universal_time();
+	auto readId = _nextReadId++;
+	auto& read = _pendingReads[readId];
+	read.offset = offset;
+	read.size = size;
+	read.waiters.push_back(ReadWaiter{offset, size, cb, bithorde::trace::Span(bithorde::trace::Context::current())});
+	read.deadline = now + boost::posix_time::milliseconds(timeout);
+	_pendingByOffset.emplace(offset, readId);
+	if (size > _largestRead)
+		_largestRead = size;
+
+	_router.readIssued();
+	if (!startRead(readId, now)) {
+		// Every upstream has its window full, wait for one to open up, or the deadline
+		read.timer.reset(new Timer(*_upstream.begin()->second.client()->timerService(), [=](const boost::posix_time::ptime&) {
+			expireRead(readId);
+		}));
+		read.timer->arm(read.deadline);
+		if (_queuedReads.empty())
+			_router.waitForWindow(shared_from_this());
+		_queuedReads.push_back(readId);
+	}
+}
+
+bool ForwardedAsset::startRead(uint64_t readId, const boost::posix_time::ptime& now)
+{
+	auto& read = _pendingReads.at(readId);
+	bool congested = false;
+	auto chosen = pickUpstream(read, &congested);
+	if (chosen == _upstream.end()) {
+		if (congested)
+			return false;
+		chosen = _upstream.begin();
+	}
+	read.timer.reset();
+	auto& latency = _router.upstreamLatency(chosen->first);
+	if ((_router.server().config().hedgeBudget > 0) && (latency.samples() >= MIN_HEDGE_SAMPLES)) {
+		read.timer.reset(new Timer(*chosen->second.client()->timerService(), [=](const boost::posix_time::ptime& now) {
+			hedgeRead(readId, now);
+		}));
+		read.timer->arm(boost::posix_time::milliseconds(latency.value()));
+	}
+	sendRead(readId, chosen->first, false, (read.deadline - now).total_milliseconds());
+	return true;
+}
+
+void ForwardedAsset::expireRead(uint64_t readId)
+{
+	auto iter = _pendingReads.find(readId);
+	if (iter != _pendingReads.end() && iter->second.attempts.empty())
+		completeRead(iter, bithorde::NullBuffer::instance);
+}
+
+void ForwardedAsset::dispatchQueued()
+{
+	auto now = boost::posix_time::microsec_clock::universal_time();
+	while (!_queuedReads.empty()) {
+		auto readId = _queuedReads.front();
+		_queuedReads.pop_front();
+		auto iter = _pendingReads.find(readId);
+		if (iter == _pendingReads.end() || !iter->second.attempts.empty())
+			continue;
+		if (_upstream.empty() || iter->second.deadline <= now) {
+			completeRead(iter, bithorde::NullBuffer::instance);
+		} else if (!startRead(readId, now)) {
+			_queuedReads.push_front(readId);
+			_router.waitForWindow(shared_from_this());
+			return;
+		}
+	}
+}
+
+std::map<std::string, UpstreamBinding>::iterator ForwardedAsset::pickUpstream(const PendingRead& read, bool* congested)
+{
+	auto chosen = _upstream.end();
 	uint32_t current_best = 1000*60*60*24;
 	for (auto iter = _upstream.begin(); iter != _upstream.end(); iter++) {
 		auto& a = iter->second;
-		if (a.status != bithorde::SUCCESS)
+		if (a.status != bithorde::SUCCESS || read.hasTried(iter->first))
 			continue;
+		if (!_router.upstreamWindow(iter->first).hasRoom(read.size) || !_router.mayDownload(iter->first)) {
+			if (congested)
+				*congested = true;
+			continue;
+		}
 		if (current_best > a.readResponseTime.value()) {
 			current_best = a.readResponseTime.value();
 			chosen = iter;
 		}
 	}
-	PendingRead read;
-	read.offset = offset;
-	read.size = size;
-	read.cb = cb;
-	_pendingReads.push_back(read);
-	chosen->second.aSyncRead(offset, size, timeout);
+	return chosen;
 }
 
-void bithorded::router::ForwardedAsset::onData( uint64_t offset, const std::shared_ptr<bithorde::IBuffer>& data, int tag ) {
-	for (auto iter=_pendingReads.begin(); iter != _pendingReads.end(); ) {
-		if (iter->offset == offset) {
-			iter->cb(offset, data);
-			iter = _pendingReads.erase(iter); // Will increase the iterator
-		} else {
-			iter++;	// Move to next
+void ForwardedAsset::sendRead(uint64_t readId, const string& peername, bool hedge, int32_t timeout)
+{
+	auto& upstream = _upstream.at(peername);
+	auto& read = _pendingReads.at(readId);
+	auto marker = _router.upstreamWindow(peername).sent(read.size);
+	_router.downloading(peername, read.size);
+	read.attempts.push_back(UpstreamRead{peername, -1, hedge, boost::posix_time::microsec_clock::universal_time(), marker});
+	upstream.reads += 1;
+	if (hedge)
+		upstream.hedged += 1;
+
+	// A failed send is reported synchronously through onData(), before the reqid is known
+	_sendingRead = readId;
+	auto reqid = upstream.aSyncRead(read.offset, read.size, timeout);
+	_sendingRead = -1;
+
+	auto iter = _pendingReads.find(readId);
+	if (iter == _pendingReads.end())
+		return;
+	auto attempt = iter->second.findAttempt(peername, -1);
+	if (attempt == iter->second.attempts.end())
+		return;
+	if (reqid < 0) {
+		attemptFailed(iter, attempt);
+	} else {
+		attempt->reqid = reqid;
+		_pendingByReqid[make_pair(peername, reqid)] = readId;
+	}
+}
+
+void ForwardedAsset::hedgeRead(uint64_t readId, const boost::posix_time::ptime& now)
+{
+	auto iter = _pendingReads.find(readId);
+	if (iter == _pendingReads.end())
+		return;
+	auto& read = iter->second;
+	auto remaining = (read.deadline - now).total_milliseconds();
+	if (remaining <= 0)
+		return;
+	auto upstream = pickUpstream(read);
+	if (upstream == _upstream.end() || !_router.takeHedgeCredit())
+		return;
+	BOOST_LOG_SEV(assetLogger, bithorded::debug) << idsToString(_requestedIds) << " hedging read at " << read.offset << " to " << upstream->first;
+	sendRead(readId, upstream->first, true, remaining);
+}
+
+void ForwardedAsset::attemptFailed(std::map<uint64_t, PendingRead>::iterator read, std::vector<UpstreamRead>::iterator attempt)
+{
+	if (attempt->reqid >= 0)
+		_pendingByReqid.erase(make_pair(attempt->peername, attempt->reqid));
+	_router.upstreamWindow(attempt->peername).released(read->second.size);
+	read->second.attempts.erase(attempt);
+	if (read->second.attempts.empty())
+		completeRead(read, bithorde::NullBuffer::instance);
+	else
+		_router.windowOpened();
+}
+
+void ForwardedAsset::completeRead(std::map<uint64_t, PendingRead>::iterator iter, const std::shared_ptr<bithorde::IBuffer>& data)
+{
+	auto& read = iter->second;
+	for (auto attempt = read.attempts.begin(); attempt != read.attempts.end(); attempt++) {
+		if (attempt->reqid >= 0)
+			_pendingByReqid.erase(make_pair(attempt->peername, attempt->reqid));
+		_router.upstreamWindow(attempt->peername).released(read.size);
+	}
+	bool released = !read.attempts.empty();
+	auto range = _pendingByOffset.equal_range(read.offset);
+	for (auto entry = range.first; entry != range.second; entry++) {
+		if (entry->second == iter->first) {
+			_pendingByOffset.erase(entry);
+			break;
 		}
 	}
+	auto offset = read.offset;
+	auto waiters = std::move(read.waiters);
+	_pendingReads.erase(iter);
+
+	for (auto waiter = waiters.begin(); waiter != waiters.end(); waiter++) {
+		waiter->trace.finish("upstream");
+		auto skip = waiter->offset - offset;
+		if (skip == 0 && waiter->size >= data->size())
+			waiter->cb(waiter->offset, data);
+		else if (skip < data->size())
+			waiter->cb(waiter->offset, std::make_shared<bithorde::SubBuffer>(data, skip, std::min(waiter->size, data->size() - skip)));
+		else
+			waiter->cb(waiter->offset, bithorde::NullBuffer::instance);
+	}
+	if (released)
+		_router.windowOpened();
+}
+
+void bithorded::router::ForwardedAsset::onData(const string& peername, uint64_t offset, const std::shared_ptr<bithorde::IBuffer>& data, int tag ) {
+	if (!data->size()) {
+		auto read = _pendingReads.end();
+		auto indexed = _pendingByReqid.find(make_pair(peername, tag));
+		if (indexed != _pendingByReqid.end())
+			read = _pendingReads.find(indexed->second);
+		else if (_sendingRead >= 0)
+			read = _pendingReads.find(_sendingRead);
+		if (read == _pendingReads.end())
+			return;
+		auto attempt = read->second.findAttempt(peername, (indexed != _pendingByReqid.end()) ? tag : -1);
+		if (attempt != read->second.attempts.end())
+			attemptFailed(read, attempt);
+		return;
+	}
+
+	// All reads at this offset sent to this upstream are answered by the same response
+	std::vector<uint64_t> answered;
+	auto range = _pendingByOffset.equal_range(offset);
+	for (auto iter = range.first; iter != range.second; iter++) {
+		if (_pendingReads.at(iter->second).hasTried(peername))
+			answered.push_back(iter->second);
+	}
+
+	auto now = boost::posix_time::microsec_clock::universal_time();
+	auto winner = _upstream.find(peername);
+	for (auto readId = answered.begin(); readId != answered.end(); readId++) {
+		auto iter = _pendingReads.find(*readId);
+		if (iter == _pendingReads.end())
+			continue;
+		auto& read = iter->second;
+		for (auto attempt = read.attempts.begin(); attempt != read.attempts.end(); attempt++) {
+			if (attempt->peername == peername) {
+				_router.upstreamLatency(peername).post((now - attempt->issuedAt).total_milliseconds());
+				_router.upstreamWindow(peername).delivered(data->size(), attempt->marker, now - attempt->issuedAt);
+				if (attempt->hedge && winner != _upstream.end())
+					winner->second.hedgeWins += 1;
+			} else if (attempt->reqid >= 0) {
+				auto loser = _upstream.find(attempt->peername);
+				if (loser != _upstream.end())
+					loser->second.cancelRequest(offset, attempt->reqid);
+			}
+		}
+		completeRead(iter, data);
+	}
 }
 
 uint64_t bithorded::router::ForwardedAsset::size()
@@ -250,7 +540,16 @@ void ForwardedAsset::inspect_upstreams(bithorded::management::InfoList& target)
 	for (auto iter = _upstream.begin(); iter != _upstream.end(); iter++) {
 		ostringstream buf;
 		buf << "upstream_" << iter->first;
-		target.append(buf.str()) << bithorde::Status_Name(iter->second.status) << ", responseTime: " << iter->second.readResponseTime;
+		const auto& upstream = iter->second;
+		auto reads = upstream.reads.value();
+		auto hedged = upstream.hedged.value();
+		const auto& window = _router.upstreamWindow(iter->first);
+		target.append(buf.str()) << bithorde::Status_Name(upstream.status) << ", responseTime: " << upstream.readResponseTime
+			<< ", hedgeDelay: " << _router.upstreamLatency(iter->first)
+			<< ", hedgeRate: " << (reads ? (hedged*100/reads) : 0) << "%"
+			<< ", hedgeWinRate: " << (hedged ? (upstream.hedgeWins.value()*100/hedged) : 0) << "%"
+			<< ", inFlight: " << window.inFlight() << '/' << window.window() << "B"
+			<< ", bandwidth: " << window.bandwidth().autoScale() << ", rtt: " << window.rtt();
 	}
 }
 
@@ -258,8 +557,11 @@ void ForwardedAsset::dropUpstream(const string& peername)
 {
 	auto upstream = _upstream.find(peername);
 	if (upstream != _upstream.end()) {
+		// Failing its reads opens windows, and may dispatch reads right away. Out of the running
+		// first, so none of them lands on this upstream just before it is gone.
+		upstream->second.status = bithorde::Status::NONE;
 		upstream->second.cancelRequests();
-		_upstream.erase(upstream);
+		_upstream.erase(peername);
 	}
 }
 
@@ -17,24 +17,52 @@
 #ifndef BITHORDED_ROUTER_ASSET_H
 #define BITHORDED_ROUTER_ASSET_H
 
+#include <deque>
 #include <map>
 #include <memory>
+#include <unordered_set>
+#include <vector>
 
 #include "../server/asset.hpp"
 #include "../server/client.hpp"
 #include <bithorded/lib/subscribable.hpp>
 #include "../../lib/asset.h"
 #include "../../lib/client.h"
+#include "../../lib/counter.h"
+#include "../../lib/timer.h"
 
 namespace bithorded {
 namespace router {
 class Router;
 
-struct PendingRead {
+struct UpstreamRead {
+	std::string peername;
+	int reqid; // -1 until the request has been sent
+	bool hedge;
+	boost::posix_time::ptime issuedAt;
+	uint64_t marker; // See UpstreamWindow::sent()
+};
+
+struct ReadWaiter {
 	uint64_t offset;
 	size_t size;
 	IAsset::ReadCallback cb;
+	bithorde::trace::Span trace; // Until answered
+};
+
+/**
+ * An upstream read in flight, answering all downstream reads (waiters) within its range.
+ */
+struct PendingRead {
+	uint64_t offset;
+	size_t size;
+	std::vector<ReadWaiter> waiters;
+	boost::posix_time::ptime deadline;
+	std::vector<UpstreamRead> attempts;
+	std::unique_ptr<Timer> timer; // Hedges the read when sent, expires it while queued
 
+	std::vector<UpstreamRead>::iterator findAttempt(const std::string& peername, int reqid);
+	bool hasTried(const std::string& peername) const;
 	void cancel();
 };
 
@@ -45,6 +73,10 @@ class UpstreamBinding : public bithorde::ReadAsset {
     boost::signals2::scoped_connection _dataConnection;
 public:
     UpstreamBinding(std::shared_ptr<ForwardedAsset>, std::string, bithorded::Client::Ptr, bithorde::Ids);
+
+    Counter reads;
+    Counter hedged;
+    Counter hedgeWins;
 };
 
 class ForwardedAsset : public bithorded::IAsset, public boost::noncopyable, public std::enable_shared_from_this<ForwardedAsset>
@@ -54,8 +86,19 @@ class ForwardedAsset : public bithorded::IAsset, public boost::noncopyable, publ
 	bithorde::Ids _requestedIds;
 	const AssetRequestParameters* _reqParameters;
 	int64_t _size;
+	bool _loopDetected;
+	bool _answeredNotFound; // Set when an upstream answered it does not have the asset
+	bool _upstreamLost; // Set when an upstream went away without such an answer
+	bool _broadcast; // Set when binding also to friends whose summary says they lack the asset
+	std::unordered_set<std::string> _skipped;
 	std::map<std::string, UpstreamBinding> _upstream;
-	std::list<PendingRead> _pendingReads;
+	std::map<uint64_t, PendingRead> _pendingReads;
+	std::multimap<uint64_t, uint64_t> _pendingByOffset;
+	std::map<std::pair<std::string, int>, uint64_t> _pendingByReqid;
+	uint64_t _nextReadId;
+	int64_t _sendingRead;
+	size_t _largestRead;
+	std::deque<uint64_t> _queuedReads;
 public:
 	typedef std::shared_ptr<ForwardedAsset> Ptr;
 	typedef std::weak_ptr<ForwardedAsset> WeakPtr;
@@ -76,13 +119,26 @@ public:
 	void apply(const bithorded::AssetRequestParameters& old, const bithorded::AssetRequestParameters& current);
 
 	void addUpstream(const bithorded::Client::Ptr& f);
+
+	/**
+	 * Sends reads held back by full upstream windows, as far as windows allow.
+	 */
+	void dispatchQueued();
 private:
 	void addUpstream(const bithorded::Client::Ptr& f, int32_t timeout, const bithorde::RouteTrace requesters);
 	void dropUpstream(const std::string& peername);
-	void onData(uint64_t offset, const std::shared_ptr<bithorde::IBuffer>& data, int tag);
+	std::map<std::string, UpstreamBinding>::iterator pickUpstream(const PendingRead& read, bool* congested=NULL);
+	bool startRead(uint64_t readId, const boost::posix_time::ptime& now);
+	void expireRead(uint64_t readId);
+	void sendRead(uint64_t readId, const std::string& peername, bool hedge, int32_t timeout);
+	void hedgeRead(uint64_t readId, const boost::posix_time::ptime& now);
+	void completeRead(std::map<uint64_t, PendingRead>::iterator read, const std::shared_ptr<bithorde::IBuffer>& data);
+	void attemptFailed(std::map<uint64_t, PendingRead>::iterator read, std::vector<UpstreamRead>::iterator attempt);
+	void onData(const std::string& peername, uint64_t offset, const std::shared_ptr<bithorde::IBuffer>& data, int tag);
 	void onUpstreamStatus(const std::string& peername, const bithorde::AssetStatus& status);
 	bithorde::RouteTrace requestTrace(const std::unordered_set< uint64_t >& requesters) const;
 	void updateStatus();
+	void bindSkipped();
 };
 
 }
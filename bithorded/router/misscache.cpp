@@ -0,0 +1,65 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "misscache.hpp"
+
+using namespace bithorded::router;
+namespace ptime = boost::posix_time;
+
+MissCache::MissCache(size_t capacity) :
+	_capacity(capacity)
+{
+}
+
+void MissCache::remember(const bithorde::Id& id, const ptime::ptime& expires)
+{
+	if (id.empty())
+		return;
+	auto known = _misses.find(id);
+	if (known != _misses.end()) {
+		known->second->first = expires;
+		_queue.splice(_queue.end(), _queue, known->second);
+		return;
+	}
+	_misses[id] = _queue.insert(_queue.end(), std::make_pair(expires, id));
+
+	while (_misses.size() > _capacity) {
+		_misses.erase(_queue.front().second);
+		_queue.pop_front();
+	}
+}
+
+bool MissCache::contains(const bithorde::Id& id, const ptime::ptime& now)
+{
+	while (_queue.size() && _queue.front().first <= now) {
+		_misses.erase(_queue.front().second);
+		_queue.pop_front();
+	}
+
+	auto iter = _misses.find(id);
+	return (iter != _misses.end()) && (iter->second->first > now);
+}
+
+void MissCache::clear()
+{
+	_misses.clear();
+	_queue.clear();
+}
+
+size_t MissCache::size() const
+{
+	return _misses.size();
+}
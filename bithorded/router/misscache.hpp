@@ -0,0 +1,64 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef BITHORDED_ROUTER_MISSCACHE_HPP
+#define BITHORDED_ROUTER_MISSCACHE_HPP
+
+#include <list>
+#include <unordered_map>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "../../lib/hashes.h"
+
+namespace bithorded {
+namespace router {
+
+/**
+ * Assets recently looked for at every friend, and found at none. Bounded, the least recently
+ * remembered entries making room for new ones.
+ */
+class MissCache
+{
+	typedef std::list< std::pair<boost::posix_time::ptime, bithorde::Id> > Queue;
+	size_t _capacity;
+	Queue _queue; // Least recently remembered first
+	std::unordered_map<bithorde::Id, Queue::iterator> _misses;
+public:
+	explicit MissCache(size_t capacity);
+
+	/**
+	 * Remembers /id/ as missing until /expires/, replacing any earlier expiry.
+	 */
+	void remember(const bithorde::Id& id, const boost::posix_time::ptime& expires);
+
+	/**
+	 * Whether /id/ is a miss not yet expired at /now/.
+	 */
+	bool contains(const bithorde::Id& id, const boost::posix_time::ptime& now);
+
+	/**
+	 * Forgets all misses, such as when a friend connects that may have any of them.
+	 */
+	void clear();
+
+	size_t size() const;
+};
+
+} }
+
+#endif // BITHORDED_ROUTER_MISSCACHE_HPP
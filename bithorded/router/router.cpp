@@ -16,6 +16,7 @@
 
 #include "router.hpp"
 
+#include <algorithm>
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/placeholders.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -33,6 +34,15 @@ using namespace bithorded::router;
 using namespace std;
 
 const ptime::seconds RECONNECT_INTERVAL(5);
+const ptime::seconds STREAM_CONNECT_INTERVAL(1);
+const size_t UPSTREAM_LATENCY_WINDOW = 64;
+const float MAX_HEDGE_CREDITS = 10.0;
+const size_t MAX_CACHED_MISSES = 16384;
+const ptime::minutes SUMMARY_INTERVAL(1);
+const size_t MAX_SUMMARY_SIZE = 120*1024; // Must fit within a single message
+const uint32_t MAX_SUMMARY_HASHES = 32;
+const ptime::millisec REBIND_INTERVAL(100);
+const size_t REBIND_BATCH = 64;
 
 namespace bithorded { namespace router {
 	Logger routerLog;
@@ -99,13 +109,22 @@ private:
 			scheduleRestart();
 		} else if (!_cancelled) {
 			_server.hookup(_socket, _f);
-			scheduleRestart(RECONNECT_INTERVAL * 2);
+			_socket = std::make_shared<boost::asio::ip::tcp::socket>(_server.ioCtx());
+			// Keeps connecting until cancelled by the router, when enough streams are up
+			scheduleRestart((_f.streams > 1) ? ptime::time_duration(STREAM_CONNECT_INTERVAL) : RECONNECT_INTERVAL * 2);
 		}
 	}
 };
 
 bithorded::router::Router::Router(Server& server)
-	: _server(server)
+	: _server(server),
+	_misses(MAX_CACHED_MISSES),
+	_hedgeCredits(0),
+	_dispatching(false),
+	_windowOpened(false),
+	_buildingSummary(false),
+	_summaryTimer(server.timerService(), [=](const ptime::ptime&) { _publishSummary(); }, SUMMARY_INTERVAL),
+	_rebindTimer(server.timerService(), [=](const ptime::ptime&) { _rebind(); })
 {
 }
 
@@ -131,33 +150,261 @@ const map< string, Client::Ptr >& Router::connectedFriends() const
 	return _connectedFriends;
 }
 
+Client::Ptr Router::pickStream(const string& peername) const
+{
+	Client::Ptr res;
+	auto streams = _friendStreams.find(peername);
+	if (streams != _friendStreams.end()) {
+		for (auto iter = streams->second.begin(); iter != streams->second.end(); iter++) {
+			if (!res || (*iter)->clientAssets().size() < res->clientAssets().size())
+				res = *iter;
+		}
+	}
+	if (!res) {
+		auto primary = _connectedFriends.find(peername);
+		if (primary != _connectedFriends.end())
+			res = primary->second;
+	}
+	return res;
+}
+
+std::vector<Client::Ptr> Router::streams(const string& peername) const
+{
+	auto streams = _friendStreams.find(peername);
+	if (streams != _friendStreams.end())
+		return streams->second;
+	return std::vector<Client::Ptr>();
+}
+
+WindowedPercentile& Router::upstreamLatency(const string& peername)
+{
+	auto iter = _upstreamLatency.find(peername);
+	if (iter == _upstreamLatency.end()) {
+		auto percentile = _server.config().hedgePercentile / 100.0;
+		iter = _upstreamLatency.emplace(std::piecewise_construct, std::make_tuple(peername), std::make_tuple(UPSTREAM_LATENCY_WINDOW, percentile, "ms")).first;
+	}
+	return iter->second;
+}
+
+void Router::readIssued()
+{
+	_hedgeCredits += _server.config().hedgeBudget / 100.0;
+	if (_hedgeCredits > MAX_HEDGE_CREDITS)
+		_hedgeCredits = MAX_HEDGE_CREDITS;
+}
+
+bool Router::takeHedgeCredit()
+{
+	if (_hedgeCredits < 1.0)
+		return false;
+	_hedgeCredits -= 1.0;
+	return true;
+}
+
+UpstreamWindow& Router::upstreamWindow(const string& peername)
+{
+	return _upstreamWindows[peername];
+}
+
+void Router::waitForWindow(const ForwardedAsset::Ptr& asset)
+{
+	_congested.push_back(asset);
+}
+
+void Router::windowOpened()
+{
+	if (_dispatching) {
+		_windowOpened = true;
+		return;
+	}
+	_dispatching = true;
+	do {
+		_windowOpened = false;
+		std::list<ForwardedAsset::WeakPtr> waiting;
+		waiting.swap(_congested);
+		for (auto iter = waiting.begin(); iter != waiting.end(); iter++) {
+			if (auto asset = iter->lock())
+				asset->dispatchQueued();
+		}
+	} while (_windowOpened && !_congested.empty());
+	_dispatching = false;
+}
+
 void Router::onConnected(const bithorded::Client::Ptr& client )
 {
 	string peerName = client->peerName();
 	if (_friends.count(peerName)) {
+		if (_friendStreams[peerName].size() >= _friends[peerName].streams) {
+			// Newest connection replaces the oldest, likely already dead without us noticing.
+			// Closing it runs onDisconnected(), rebinding what was bound over it.
+			auto oldest = _friendStreams[peerName].front();
+			BOOST_LOG_SEV(routerLog, bithorded::info) << "Friend " << peerName << " reconnected, closing its oldest stream";
+			oldest->close();
+		}
+		auto& streams = _friendStreams[peerName];
+		streams.push_back(client);
+		if (streams.size() >= _friends[peerName].streams) {
+			if (_connectors[peerName].get())
+				_connectors[peerName]->cancel();
+			_connectors.erase(peerName);
+		}
+		if (_connectedFriends.count(peerName) && (streams.size() > 1)) {
+			// Additional stream to an already connected friend. Will be used for new bindings.
+			BOOST_LOG_SEV(routerLog, bithorded::info) << "Friend " << peerName << " connected stream " << streams.size();
+			return;
+		}
+
 		BOOST_LOG_SEV(routerLog, bithorded::info) << "Friend " << peerName << " connected";
-		if (_connectors[peerName].get())
-			_connectors[peerName]->cancel();
-		_connectors.erase(peerName);
 		_connectedFriends[peerName] = client;
-		for (auto iter=_openAssets.begin(); iter != _openAssets.end(); iter++) {
-			if (auto forwardedAsset = iter->lock()) {
-				forwardedAsset->addUpstream(client);
+		_misses.clear();
+		if (_localSummary)
+			_sendSummary(client);
+		else
+			_publishSummary(); // Sent once built
+
+		// Binding every open asset at once floods the new connection, and stalls the event-loop
+		// while doing so. Queue them up, and bind in paced batches instead.
+		_queueRebind(peerName);
+		_rebind();
+	}
+}
+
+void Router::_queueRebind(const string& peerName)
+{
+	auto& queue = _rebindQueues[peerName];
+	queue.clear();
+	for (auto iter=_openAssets.begin(); iter != _openAssets.end(); iter++)
+		queue.push_back(*iter);
+}
+
+void Router::_rebind()
+{
+	_rebindTimer.clear();
+	for (auto queue = _rebindQueues.begin(); queue != _rebindQueues.end();) {
+		auto f = _connectedFriends.find(queue->first);
+		if (f == _connectedFriends.end()) {
+			queue = _rebindQueues.erase(queue);
+			continue;
+		}
+		auto& client = f->second;
+		auto& assets = queue->second;
+		auto& streams = _friendStreams[queue->first];
+		for (auto stream = streams.begin(); stream != streams.end(); stream++)
+			(*stream)->batchBinds();
+		std::vector<ForwardedAsset::WeakPtr> added;
+		for (size_t bound = 0; bound < REBIND_BATCH && !assets.empty(); assets.pop_front()) {
+			if (auto forwardedAsset = assets.front().lock()) {
+				if (!forwardedAsset->hasUpstream(queue->first)) {
+					forwardedAsset->addUpstream(client);
+					added.push_back(assets.front());
+					bound++;
+				}
 			}
 		}
+		for (auto stream = streams.begin(); stream != streams.end(); stream++)
+			(*stream)->flushBinds();
+		// Binds that could not be sent failed their assets' upstreams. Take those back, to try
+		// again with a later batch.
+		for (auto iter = added.begin(); iter != added.end(); iter++) {
+			auto forwardedAsset = iter->lock();
+			if (forwardedAsset && !forwardedAsset->hasUpstream(queue->first))
+				assets.push_back(*iter);
+		}
+		if (assets.empty())
+			queue = _rebindQueues.erase(queue);
+		else
+			queue++;
 	}
+	if (!_rebindQueues.empty())
+		_rebindTimer.arm(REBIND_INTERVAL);
 }
 
 void Router::onDisconnected(const bithorded::Client::Ptr& client)
 {
 	string peerName = client->peerName();
+	bool wasStream = false;
+	auto streams = _friendStreams.find(peerName);
+	if (streams != _friendStreams.end()) {
+		auto& clients = streams->second;
+		auto removed = std::remove(clients.begin(), clients.end(), client);
+		wasStream = (removed != clients.end());
+		clients.erase(removed, clients.end());
+		if (clients.empty())
+			_friendStreams.erase(streams);
+	}
 	auto iter = _connectedFriends.find(peerName);
-	if ((iter != _connectedFriends.end()) && (iter->second == client))
-		_connectedFriends.erase(iter);
+	if (wasStream && (iter != _connectedFriends.end())) {
+		streams = _friendStreams.find(peerName);
+		if (streams == _friendStreams.end()) {
+			if (iter->second == client) {
+				_connectedFriends.erase(iter);
+				_friendSummaries.erase(peerName);
+				_rebindQueues.erase(peerName);
+			}
+		} else {
+			// Other streams remain, rebind the assets lost with this one over them
+			iter->second = streams->second.front();
+			_queueRebind(peerName);
+			_rebindTimer.clear();
+			_rebindTimer.arm(REBIND_INTERVAL);
+		}
+	}
 	if (_friends.count(peerName) && _friends[peerName].port && !_connectors.count(peerName))
 		_connectors[peerName] = FriendConnector::create(_server, _friends[peerName]);
 }
 
+void Router::onAvailabilitySummary(const string& peername, const bithorde::AvailabilitySummary& summary)
+{
+	if (!_connectedFriends.count(peername))
+		return;
+	if (summary.bloom().empty() || summary.bloom().size() > MAX_SUMMARY_SIZE || summary.hashes() > MAX_SUMMARY_HASHES) {
+		BOOST_LOG_SEV(routerLog, bithorded::warning) << "Ignoring malformed availability summary from " << peername;
+		return;
+	}
+	_friendSummaries.erase(peername);
+	_friendSummaries.emplace(peername, BloomFilter(summary.bloom(), summary.hashes()));
+}
+
+bool Router::mayHave(const string& peername, const bithorde::Ids& ids) const
+{
+	auto summary = _friendSummaries.find(peername);
+	if (summary == _friendSummaries.end())
+		return true;
+	auto tigerId = findBithordeId(ids, bithorde::HashType::TREE_TIGER);
+	return tigerId.empty() || summary->second.mayContain(tigerId.raw());
+}
+
+void Router::_publishSummary()
+{
+	if (_buildingSummary)
+		return;
+	_buildingSummary = true;
+	// The asset indexes are only safe to read here, but hashing every id into the filter can
+	// be left to a worker
+	auto tigerIds = std::make_shared< std::vector<bithorde::Id> >(_server.localTigerIds());
+	_server.submit([tigerIds]() {
+		auto summary = std::make_shared<BloomFilter>(BloomFilter::forItems(tigerIds->size(), MAX_SUMMARY_SIZE));
+		for (auto iter = tigerIds->begin(); iter != tigerIds->end(); iter++)
+			summary->insert(iter->raw());
+		return std::shared_ptr<const BloomFilter>(summary);
+	}, [this](const std::shared_ptr<const BloomFilter>& summary) {
+		_buildingSummary = false;
+		_localSummary = summary;
+		for (auto iter = _connectedFriends.begin(); iter != _connectedFriends.end(); iter++)
+			_sendSummary(iter->second);
+	}, GrandCentralDispatch::MAINTENANCE);
+}
+
+void Router::_sendSummary(const bithorded::Client::Ptr& client)
+{
+	if (client->protoVersion() < 3)
+		return;
+	bithorde::AvailabilitySummary msg;
+	msg.set_bloom(_localSummary->bits());
+	msg.set_hashes(_localSummary->hashes());
+	client->sendMessage(bithorde::Connection::AvailabilitySummary, msg);
+}
+
 UpstreamRequestBinding::Ptr Router::findAsset( const bithorde::BindRead& req )
 {
 	// TODO; make sure returned asset isn't stale
@@ -174,12 +421,23 @@ void Router::inspect(management::InfoList& target) const
 		} else {
 			target.append(name) << iter->second.addr << ':' << iter->second.port;
 		}
+		auto streams = _friendStreams.find(name);
+		if (streams == _friendStreams.end())
+			continue;
+		for (size_t i=0; i < streams->second.size(); i++) {
+			auto& stream = streams->second[i];
+			if ((connectedIter == _connectedFriends.end()) || (stream != connectedIter->second))
+				target.append(name + '#' + boost::lexical_cast<string>(i+1), *stream);
+		}
 	}
 }
 
 void Router::describe(management::Info& target) const
 {
-	target << upstreams() << " upstreams (" << friends() << " configured)";
+	size_t rebinds = 0;
+	for (auto iter = _rebindQueues.begin(); iter != _rebindQueues.end(); iter++)
+		rebinds += iter->second.size();
+	target << upstreams() << " upstreams (" << friends() << " configured), " << _friendSummaries.size() << " availability summaries, " << _misses.size() << " cached misses, " << rebinds << " pending rebinds";
 }
 
 bithorded::IAsset::Ptr bithorded::router::Router::openAsset(const bithorde::BindRead& req)
@@ -188,6 +446,8 @@ bithorded::IAsset::Ptr bithorded::router::Router::openAsset(const bithorde::Bind
 
 	if (_isBlacklisted(now, req.requesters()))
 		throw bithorded::BindError(bithorde::WOULD_LOOP);
+	if (_misses.contains(findBithordeId(req.ids(), bithorde::HashType::TREE_TIGER), now))
+		throw bithorded::BindError(bithorde::NOTFOUND);
 
 	auto asset = std::make_shared<ForwardedAsset, Router&, const bithorde::Ids&>(*this, req.ids());
 	_openAssets.insert(asset);
@@ -223,3 +483,41 @@ bool Router::_isBlacklisted(const ptime::ptime& now, const google::protobuf::Rep
 
 	return false;
 }
+
+bool Router::mayDownload(const string& peername)
+{
+	auto limits = _server.limits().download(peername);
+	auto now = TokenBucket::Clock::now();
+	for (auto iter = limits.begin(); iter != limits.end(); iter++) {
+		auto& limit = **iter;
+		if (limit.ready(now))
+			continue;
+		// Each limit wakes reads up when it has refilled, however the others are doing
+		auto& timer = _limitTimers[*iter];
+		if (!timer)
+			timer.reset(new Timer(_server.timerService(), [=](const ptime::ptime&) { windowOpened(); }));
+		if (!timer->armed()) {
+			auto delay = std::chrono::duration_cast<std::chrono::microseconds>(limit.delay(now));
+			timer->arm(ptime::microseconds(delay.count()));
+		}
+		return false;
+	}
+	return true;
+}
+
+void Router::downloading(const string& peername, size_t bytes)
+{
+	auto limits = _server.limits().download(peername);
+	auto now = TokenBucket::Clock::now();
+	for (auto iter = limits.begin(); iter != limits.end(); iter++)
+		(*iter)->take(bytes, now);
+}
+
+void Router::rememberMiss(const bithorde::Ids& ids)
+{
+	auto ttl = _server.config().missCacheTTL;
+	auto tigerId = findBithordeId(ids, bithorde::HashType::TREE_TIGER);
+	if (!ttl || tigerId.empty())
+		return;
+	_misses.remember(tigerId, ptime::microsec_clock::universal_time() + ptime::seconds(ttl));
+}
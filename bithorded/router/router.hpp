@@ -19,17 +19,25 @@
 #define BITHORDED_ROUTER_ROUTER_HPP
 
 #include <boost/asio/io_context.hpp>
+#include <deque>
 #include <map>
 #include <memory>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "../lib/assetsessions.hpp"
+#include "../lib/bloomfilter.hpp"
 #include "../lib/management.hpp"
 #include "../lib/weakmap.hpp"
+#include "../../lib/hashes.h"
+#include "../../lib/counter.h"
+#include "../../lib/tokenbucket.h"
 #include "../server/config.hpp"
 #include "../server/client.hpp"
 #include "asset.hpp"
+#include "misscache.hpp"
+#include "window.hpp"
 
 #include "bithorde.pb.h"
 
@@ -44,10 +52,32 @@ class Router : public AssetSessions, public management::DescriptiveDirectory, pu
 	std::map<std::string, Config::Friend> _friends;
 	std::map<std::string, std::shared_ptr<FriendConnector> > _connectors;
 	std::map<std::string, Client::Ptr > _connectedFriends;
+	std::map<std::string, std::vector<Client::Ptr> > _friendStreams;
 
 	std::unordered_set<uint64_t> _blacklist;
 	std::queue< std::pair<boost::posix_time::ptime,uint64_t> > _blacklistQueue;
+
+	MissCache _misses;
 	bithorded::WeakSet<ForwardedAsset> _openAssets;
+
+	std::map<std::string, WindowedPercentile> _upstreamLatency;
+	float _hedgeCredits;
+
+	std::map<std::string, UpstreamWindow> _upstreamWindows;
+	std::list<ForwardedAsset::WeakPtr> _congested;
+	bool _dispatching;
+	bool _windowOpened;
+
+	std::map<std::string, BloomFilter> _friendSummaries;
+	std::shared_ptr<const BloomFilter> _localSummary;
+	bool _buildingSummary;
+	PeriodicTimer _summaryTimer;
+
+	std::map<std::string, std::deque<ForwardedAsset::WeakPtr> > _rebindQueues;
+	Timer _rebindTimer;
+
+	// Per download-limit, armed while it is out of tokens
+	std::map<TokenBucket::Ptr, std::unique_ptr<Timer> > _limitTimers;
 public:
 	Router(Server& server);
 
@@ -60,8 +90,71 @@ public:
 
 	const std::map<std::string, Client::Ptr >& connectedFriends() const;
 
+	/**
+	 * The connection to the friend with the fewest assets bound, to bind a new asset over.
+	 */
+	Client::Ptr pickStream(const std::string& peername) const;
+
+	/**
+	 * All connections to the friend, empty if not connected.
+	 */
+	std::vector<Client::Ptr> streams(const std::string& peername) const;
+
+	/**
+	 * Recent read response-times of a friend, at the configured hedge-percentile.
+	 */
+	WindowedPercentile& upstreamLatency(const std::string& peername);
+
+	/**
+	 * Accounts for one upstream read, earning credit for hedging according to the hedge-budget.
+	 */
+	void readIssued();
+
+	/**
+	 * Returns true, and spends one credit, if the hedge-budget allows issuing one more hedged read.
+	 */
+	bool takeHedgeCredit();
+
+	/**
+	 * Bandwidth, rtt and reads in flight for a friend.
+	 */
+	UpstreamWindow& upstreamWindow(const std::string& peername);
+
+	/**
+	 * Registers /asset/ to be told, through dispatchQueued(), when some upstream window has room again.
+	 */
+	void waitForWindow(const ForwardedAsset::Ptr& asset);
+
+	/**
+	 * Called when reads in flight to some friend has completed.
+	 */
+	void windowOpened();
+
+	/**
+	 * False if a download-limit for the friend is out of tokens. windowOpened() is then called
+	 * once it has refilled.
+	 */
+	bool mayDownload(const std::string& peername);
+
+	/**
+	 * Charges the download-limits of a friend for a read of /bytes/.
+	 */
+	void downloading(const std::string& peername, size_t bytes);
+
+	/**
+	 * Remembers that no friend had the asset, for the configured missCacheTTL.
+	 */
+	void rememberMiss(const bithorde::Ids& ids);
+
 	void onConnected(const bithorded::Client::Ptr& client);
 	void onDisconnected(const bithorded::Client::Ptr& client);
+	void onAvailabilitySummary(const std::string& peername, const bithorde::AvailabilitySummary& summary);
+
+	/**
+	 * False if the friend has told us it does not have the asset. True if it might, or if it
+	 * has not told us.
+	 */
+	bool mayHave(const std::string& peername, const bithorde::Ids& ids) const;
 
 	virtual UpstreamRequestBinding::Ptr findAsset(const bithorde::BindRead& req);
 
@@ -73,6 +166,10 @@ protected:
 private:
 	void _addToBlacklist(const boost::posix_time::ptime& deadline, uint64_t uid);
 	bool _isBlacklisted(const boost::posix_time::ptime& now, const google::protobuf::RepeatedField< google::protobuf::uint64 >& uids);
+	void _publishSummary();
+	void _sendSummary(const bithorded::Client::Ptr& client);
+	void _queueRebind(const std::string& peerName);
+	void _rebind();
 };
 
 }}
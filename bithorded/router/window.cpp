@@ -0,0 +1,82 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "window.hpp"
+
+#include <algorithm>
+
+using namespace bithorded::router;
+
+const size_t SAMPLE_WINDOW = 32;
+const size_t INITIAL_WINDOW = 1024*1024;
+const size_t MIN_WINDOW = 256*1024;
+const size_t MAX_WINDOW = 64*1024*1024;
+
+UpstreamWindow::UpstreamWindow() :
+	_rtt(SAMPLE_WINDOW, 0.0, "ms"),
+	_bandwidth(SAMPLE_WINDOW, 1.0, "B/s"),
+	_delivered(0),
+	_inFlight(0)
+{
+}
+
+size_t UpstreamWindow::window() const
+{
+	if (!_bandwidth.samples())
+		return INITIAL_WINDOW;
+	uint64_t bdp = _bandwidth.value() * std::max<uint64_t>(_rtt.value(), 1) / 1000;
+	return std::min<uint64_t>(std::max<uint64_t>(2*bdp, MIN_WINDOW), MAX_WINDOW);
+}
+
+size_t UpstreamWindow::inFlight() const
+{
+	return _inFlight;
+}
+
+const TypedValue& UpstreamWindow::rtt() const
+{
+	return _rtt;
+}
+
+const TypedValue& UpstreamWindow::bandwidth() const
+{
+	return _bandwidth;
+}
+
+bool UpstreamWindow::hasRoom(size_t bytes) const
+{
+	return (_inFlight == 0) || (_inFlight + bytes <= window());
+}
+
+uint64_t UpstreamWindow::sent(size_t bytes)
+{
+	_inFlight += bytes;
+	return _delivered;
+}
+
+void UpstreamWindow::delivered(size_t bytes, uint64_t marker, const boost::posix_time::time_duration& elapsed)
+{
+	_delivered += bytes;
+	auto ms = std::max<int64_t>(elapsed.total_milliseconds(), 1);
+	_rtt.post(ms);
+	// Everything delivered while this read was in flight, over the time it took
+	_bandwidth.post((_delivered - marker) * 1000 / ms);
+}
+
+void UpstreamWindow::released(size_t bytes)
+{
+	_inFlight -= std::min(bytes, _inFlight);
+}
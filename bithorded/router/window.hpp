@@ -0,0 +1,67 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef BITHORDED_ROUTER_WINDOW_HPP
+#define BITHORDED_ROUTER_WINDOW_HPP
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "../../lib/counter.h"
+
+namespace bithorded {
+namespace router {
+
+/**
+ * Estimates bandwidth and round-trip time of an upstream from completed reads, and limits the
+ * bytes in flight to it to about twice the bandwidth-delay product.
+ */
+class UpstreamWindow
+{
+	WindowedPercentile _rtt;
+	WindowedPercentile _bandwidth;
+	uint64_t _delivered;
+	size_t _inFlight;
+public:
+	UpstreamWindow();
+
+	size_t window() const;
+	size_t inFlight() const;
+	const TypedValue& rtt() const;
+	const TypedValue& bandwidth() const;
+
+	/**
+	 * A single read is always allowed, even if larger than the window.
+	 */
+	bool hasRoom(size_t bytes) const;
+
+	/**
+	 * Accounts /bytes/ as sent. Returns a marker to hand back to delivered().
+	 */
+	uint64_t sent(size_t bytes);
+
+	/**
+	 * Records a successful read of /bytes/, sent at /marker/ and answered after /elapsed/.
+	 * Does not free the window, see released().
+	 */
+	void delivered(size_t bytes, uint64_t marker, const boost::posix_time::time_duration& elapsed);
+
+	void released(size_t bytes);
+};
+
+}}
+
+#endif // BITHORDED_ROUTER_WINDOW_HPP
@@ -36,10 +36,12 @@ AssetBinding::AssetBinding(const AssetBinding& other) :
 	_ptr(other._ptr),
 	_assetIds(other.assetIds()),
 	_requesters(other._requesters),
-	_deadline(other.deadline())
+	_deadline(other.deadline()),
+	_statusUpdate(other._statusUpdate)
 {
 	if (_ptr) {
 		_ptr->bindDownstream(this);
+		subscribe();
 	}
 }
 
@@ -89,14 +91,11 @@ bool AssetBinding::bind( const std::shared_ptr< UpstreamRequestBinding >& asset,
 	auto res = bind(asset, assetIds, requesters, deadline);
 
 	if (res) {
-		auto& status = _ptr->shared()->status;
-
 		// Remember to inform peer about changes in asset-status.
-		auto weak_self = weak();
-		_statusConnection = status.onChange.connect([=](const bithorde::AssetStatus&, const bithorde::AssetStatus& current) {
-			statusUpdate(weak_self.lock(), current);
-		});
+		_statusUpdate = statusUpdate;
+		subscribe();
 
+		auto& status = _ptr->shared()->status;
 		if ( status->status() != bithorde::Status::NONE ) {
 			// We already have a valid status for the asset, so inform about it
 			statusUpdate(shared(), *status);
@@ -106,9 +105,22 @@ bool AssetBinding::bind( const std::shared_ptr< UpstreamRequestBinding >& asset,
 	return res;
 }
 
+void AssetBinding::subscribe()
+{
+	_statusConnection.disconnect();
+	if (!_statusUpdate)
+		return;
+	auto statusUpdate = _statusUpdate;
+	auto weak_self = weak();
+	_statusConnection = _ptr->shared()->status.onChange.connect([=](const bithorde::AssetStatus&, const bithorde::AssetStatus& current) {
+		statusUpdate(weak_self.lock(), current);
+	});
+}
+
 void AssetBinding::reset()
 {
 	_statusConnection.disconnect();
+	_statusUpdate = nullptr;
 	if (_ptr) {
 		_ptr->unbindDownstream(this);
 	}
@@ -124,8 +136,11 @@ AssetBinding& AssetBinding::operator=(const AssetBinding& other)
 	}
 	_ptr = other._ptr;
 	_requesters = other._requesters;
+	_statusUpdate = other._statusUpdate;
+	_statusConnection.disconnect();
 	if (_ptr) {
 		_ptr->bindDownstream(this);
+		subscribe();
 	}
 	return *this;
 }
@@ -48,6 +48,10 @@ class AssetBinding {
 	boost::signals2::connection _statusConnection;
 public:
 	typedef std::function<void (const std::shared_ptr< IAsset >&, const bithorde::AssetStatus&)> StatusFunc;
+private:
+	StatusFunc _statusUpdate;
+	void subscribe();
+public:
 
 	AssetBinding();
 	AssetBinding(const AssetBinding& other);
@@ -147,6 +151,18 @@ public:
 	 */
 	virtual size_t canRead(uint64_t offset, size_t size) = 0;
 
+	/**
+	 * The file holding locally available data from /offset/, for zero-copy transfers. Returns how
+	 * many bytes, up to /size/, can be sent straight from /fd/ at /fileOffset/. 0 if none.
+	 */
+	virtual size_t mapFile(uint64_t offset, size_t size, int& fd, uint64_t& fileOffset) { return 0; }
+
+	/**
+	 * A downstream about to read at /offset/ is not keeping up with what it is sent. Hold back on
+	 * reading ahead for it.
+	 */
+	virtual void downstreamCongested(uint64_t offset) {}
+
 	virtual void describe(management::Info& target) const;
 };
 
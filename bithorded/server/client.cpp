@@ -20,6 +20,7 @@
 #include <iostream>
 
 #include <bithorded/lib/log.hpp>
+#include <bithorded/lib/loopmonitor.hpp>
 #include <lib/buffer.hpp>
 #include <lib/hashes.h>
 #include <lib/magneturi.h>
@@ -27,6 +28,8 @@
 
 const size_t MAX_ASSETS = 1024;
 const size_t MAX_CHUNK = 128*1024;
+const size_t UPLOAD_QUEUE_MAX = 2*1024*1024;
+const size_t UPLOAD_QUEUE_RESUME = UPLOAD_QUEUE_MAX/2;
 
 using namespace std;
 namespace fs = boost::filesystem;
@@ -37,16 +40,61 @@ namespace bithorded {
 	Logger clientLogger;
 }
 
+namespace {
+	metrics::Histogram bindLatency("bithorded_bind_seconds", "Time from BindRead until the first asset status");
+	metrics::Histogram storeReadLatency("bithorded_read_seconds", "Time to serve a read, by source", {{"source", "store"}});
+	metrics::Histogram cacheReadLatency("bithorded_read_seconds", "Time to serve a read, by source", {{"source", "cache"}});
+	metrics::Histogram upstreamReadLatency("bithorded_read_seconds", "Time to serve a read, by source", {{"source", "upstream"}});
+	metrics::Counter readsStalled("bithorded_reads_stalled_total", "Reads held back until the requesters send-queue drained");
+	metrics::Counter readsDropped("bithorded_reads_dropped_total", "Reads served, but not sent for a full send-queue");
+
+	/**
+	 * The most a read will produce, and thus occupy in the send-queue.
+	 */
+	size_t readCost(const bithorde::Read::Request& msg) {
+		return std::min<size_t>(msg.size(), MAX_CHUNK);
+	}
+
+	/**
+	 * Whether the whole read is served from local disk. Others wait on upstreams, rather than on
+	 * this node.
+	 */
+	bool readsLocally(IAsset& asset, uint64_t offset, size_t size) {
+		int fd;
+		uint64_t fileOffset;
+		return asset.mapFile(offset, size, fd, fileOffset) >= size;
+	}
+
+	metrics::Histogram& readLatencyOf(const IAsset* asset) {
+		if (dynamic_cast<const router::ForwardedAsset*>(asset))
+			return upstreamReadLatency;
+		else if (dynamic_cast<const cache::CachedAsset*>(asset) || dynamic_cast<const cache::CachingAsset*>(asset))
+			return cacheReadLatency;
+		else
+			return storeReadLatency;
+	}
+}
+
 Client::Client( Server& server) :
 	bithorde::Client(server.ioCtx(), server.name()),
-	_server(server)
+	_server(server),
+	_readFlow(server.readQueue().flow(server.config().clientWeight)),
+	_readBytesInFlight(0),
+	_readsCancel(CancelToken::create()),
+	_uploadsFull(0)
 {
+	writable.connect(std::bind(&Client::resumeReadRequests, this));
 }
 
 Client::Ptr Client::shared_from_this() {
 	return std::static_pointer_cast<Client>(bithorde::Client::shared_from_this());
 }
 
+void Client::setReadWeight(uint16_t weight)
+{
+	_readFlow->setWeight(weight);
+}
+
 size_t Client::serverAssets() const
 {
 	size_t res = 0;
@@ -68,10 +116,17 @@ void Client::inspect(management::InfoList& tgt) const
 {
 	tgt.append("incomingCurrent") << stats->incomingBitrateCurrent.autoScale() << ", " << stats->incomingMessagesCurrent.autoScale();
 	tgt.append("outgoingCurrent") << stats->outgoingBitrateCurrent.autoScale() << ", " << stats->outgoingMessagesCurrent.autoScale();
+	tgt.append("incomingWindow") << stats->incomingBitrateCurrent.windowed().autoScale() << ", peak " << stats->incomingBitrateCurrent.percentile(1.0).autoScale();
+	tgt.append("outgoingWindow") << stats->outgoingBitrateCurrent.windowed().autoScale() << ", peak " << stats->outgoingBitrateCurrent.percentile(1.0).autoScale();
 	tgt.append("incomingTotal") << stats->incomingBytes.autoScale() << ", " << stats->incomingMessages.autoScale();
 	tgt.append("outgoingTotal") << stats->outgoingBytes.autoScale() << ", " << stats->outgoingMessages.autoScale();
 	tgt.append("assetResponseTime") << assetResponseTime;
 	tgt.append("bytesAllocated") << bytesAllocated();
+	tgt.append("readWeight") << _readFlow->weight() << ", " << _readFlow->queued() << " reads queued, " << _stalledReads.size() << " stalled, " << _readBytesInFlight << " bytes in flight";
+	size_t uploadPending = 0;
+	for (auto iter = _uploads.begin(); iter != _uploads.end(); iter++)
+		uploadPending += iter->second.pending;
+	tgt.append("uploads") << _uploads.size() << " writing, " << uploadPending << " bytes pending, " << _uploadsFull << " full";
 	for (auto iter=clientAssets().begin(); iter != clientAssets().end(); iter++) {
 		ostringstream name;
 		name << '+' << iter->first;
@@ -96,6 +151,8 @@ void Client::onMessage( const std::shared_ptr< bithorde::MessageContext< bithord
 	if (!(state() & SaidHello)) {
 		auto client_config = _server.getClientConfig( msg.name());
 		setSecurity(client_config.key, (bithorde::CipherType)client_config.cipher);
+		if (auto weight = _server.readWeight( msg.name()))
+			setReadWeight(weight);
 		sayHello();
 	}
 	BOOST_LOG_SEV(clientLogger, bithorded::info) << "Connected: " << msg.name();
@@ -104,6 +161,7 @@ void Client::onMessage( const std::shared_ptr< bithorde::MessageContext< bithord
 
 void Client::onMessage( const std::shared_ptr< bithorde::MessageContext< bithorde::BindWrite > >& msgCtx )
 {
+	LoopMonitor::Scope loop("client.bindWrite");
 	const auto& msg = msgCtx->message();
 	auto h = msg.handle();
 	if ((_assets.size() > h) && _assets[h]) {
@@ -135,6 +193,7 @@ void Client::onMessage( const std::shared_ptr< bithorde::MessageContext< bithord
 
 void Client::onMessage( const std::shared_ptr< bithorde::MessageContext< bithorde::BindRead > >& msgCtx )
 {
+	LoopMonitor::Scope loop("client.bindRead");
 	const auto& msg = msgCtx->message();
 	auto h = msg.handle();
 
@@ -167,6 +226,7 @@ void Client::onMessage( const std::shared_ptr< bithorde::MessageContext< bithord
 					auto now = boost::posix_time::microsec_clock::universal_time();
 					deadline = now + boost::posix_time::milliseconds(msg.timeout());
 				}
+				_bindStarted[h] = bithorde::Message::Clock::now();
 				assignAsset(h, asset, msg.ids(), msg.requesters(), deadline);
 			} else {
 				informAssetStatus(h, bithorde::NOTFOUND);
@@ -181,43 +241,132 @@ void Client::onMessage( const std::shared_ptr< bithorde::MessageContext< bithord
 }
 
 void Client::onMessage( const std::shared_ptr< bithorde::MessageContext< bithorde::Read::Request > >& msgCtx )
+{
+	auto deadline = bithorde::Message::in(msgCtx->message().timeout());
+	// Keep order behind already stalled reads
+	if (!_stalledReads.empty() || sendCongested(_readBytesInFlight + readCost(msgCtx->message())))
+		stallReadRequest(msgCtx, deadline);
+	else
+		submitReadRequest(msgCtx, deadline);
+}
+
+void Client::submitReadRequest(const std::shared_ptr< bithorde::MessageContext< bithorde::Read::Request > >& msgCtx, bithorde::Message::Deadline deadline)
+{
+	// Reserve room in the send-queue for the response already, while queued behind other
+	// clients reads, in proportion to our weight
+	size_t cost = readCost(msgCtx->message());
+	_readBytesInFlight += cost;
+	auto self = shared_from_this();
+	bithorde::trace::Span queued(bithorde::trace::Tracer::instance().sample(msgCtx->message().reqid(), msgCtx->message().handle()));
+	_server.readQueue().submit(_readFlow, cost, [=](const FairQueue::Ticket& ticket) {
+		queued.finish("queued");
+		self->processReadRequest(msgCtx, deadline, ticket, queued.context());
+	});
+}
+
+void Client::stallReadRequest(const std::shared_ptr< bithorde::MessageContext< bithorde::Read::Request > >& msgCtx, bithorde::Message::Deadline deadline)
+{
+	// Whatever we read now would only be dropped at the full send-queue, or waste upstream
+	// bandwidth on data the requester is not yet ready for. Wait for it to drain instead.
+	readsStalled += 1;
+	_stalledReads.push_back(StalledRead{msgCtx, deadline});
+	if (const AssetBinding& asset = getAsset(msgCtx->message().handle()))
+		asset->downstreamCongested(msgCtx->message().offset());
+}
+
+void Client::resumeReadRequests()
+{
+	auto now = bithorde::Message::Clock::now();
+	while (!_stalledReads.empty()) {
+		auto& read = _stalledReads.front();
+		if (read.deadline < now) {
+			auto reqid = read.msgCtx->message().reqid();
+			_stalledReads.pop_front();
+			sendReadStatus(reqid, bithorde::TIMEOUT);
+			continue;
+		}
+		if (sendCongested(_readBytesInFlight + readCost(read.msgCtx->message())))
+			break;
+		auto msgCtx = std::move(read.msgCtx);
+		auto deadline = read.deadline;
+		_stalledReads.pop_front();
+		submitReadRequest(msgCtx, deadline);
+	}
+}
+
+void Client::readDone(const bithorde::Read::Request& msg)
+{
+	_readBytesInFlight -= readCost(msg);
+	resumeReadRequests();
+}
+
+void Client::processReadRequest(const std::shared_ptr< bithorde::MessageContext< bithorde::Read::Request > >& msgCtx, bithorde::Message::Deadline deadline, const FairQueue::Ticket& ticket, const bithorde::trace::Context& trace)
 {
 	const auto& msg = msgCtx->message();
+	auto now = bithorde::Message::Clock::now();
+	if (deadline < now) {
+		sendReadStatus(msg.reqid(), bithorde::TIMEOUT);
+		return readDone(msg);
+	}
 	const AssetBinding& asset = getAsset(msg.handle());
 	if (asset) {
 		uint64_t offset = msg.offset();
-		size_t size = msg.size();
-		if (size > MAX_CHUNK)
-			size = MAX_CHUNK;
+		size_t size = readCost(msg);
 
 		if (offset < asset->size()) {
 			// Raw pointer to this should be fine here, since asset has ownership of this. (Through member Ptr client)
-			auto deadline = bithorde::Message::in(msg.timeout());
-			asset->asyncRead(offset, size, msg.timeout(),
-				std::bind(&Client::onReadResponse, this, msgCtx, std::placeholders::_1, std::placeholders::_2, deadline));
+			auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+			// The ticket bounds reads busy on this node. One waiting for an upstream lets go of it
+			// once sent, or it would starve local reads, and friends forwarding to each other
+			// could deadlock on each others tickets.
+			auto held = readsLocally(*asset, offset, size) ? ticket : FairQueue::Ticket();
+			bithorde::trace::Scope scope(trace);
+			CancelToken::Scope cancel(_readsCancel);
+			asset->asyncRead(offset, size, timeout,
+				std::bind(&Client::onReadResponse, this, msgCtx, std::placeholders::_1, std::placeholders::_2, deadline, held, now, &readLatencyOf(asset.get()), bithorde::trace::Span(trace)));
+			return;
 		} else {
-			bithorde::Read::Response resp;
-			resp.set_reqid(msg.reqid());
-			resp.set_status(bithorde::ERROR);
-			sendMessage(bithorde::Connection::ReadResponse, resp);
+			sendReadStatus(msg.reqid(), bithorde::ERROR);
 		}
 	} else {
-		bithorde::Read::Response resp;
-		resp.set_reqid(msg.reqid());
-		resp.set_status(bithorde::INVALID_HANDLE);
-		sendMessage(bithorde::Connection::ReadResponse, resp);
+		sendReadStatus(msg.reqid(), bithorde::INVALID_HANDLE);
 	}
+	readDone(msg);
+}
+
+void Client::sendReadStatus(uint32_t reqid, bithorde::Status status)
+{
+	bithorde::Read::Response resp;
+	resp.set_reqid(reqid);
+	resp.set_status(status);
+	sendMessage(bithorde::Connection::ReadResponse, resp);
 }
 
 void Client::onMessage( const std::shared_ptr< bithorde::MessageContext< bithorde::DataSegment > >& msgCtx )
 {
+	LoopMonitor::Scope loop("client.write");
 	const auto& msg = msgCtx->message();
 	const AssetBinding& asset_ = getAsset(msg.handle());
 
 	if (asset_) {
 		bithorded::cache::CachedAsset::Ptr asset = dynamic_pointer_cast<bithorded::cache::CachedAsset>(asset_.shared());
 		if (asset) {
-			asset->write(msg.offset(), std::make_shared<bithorde::DataSegmentCtxBuffer>(msgCtx));
+			// Bound what each upload may have waiting for the disk, by not reading more from the
+			// uploader until writes catch up
+			auto handle = msg.handle();
+			size_t size = msg.content().size();
+			auto& upload = _uploads[handle];
+			upload.pending += size;
+			if (!upload.full && (upload.pending >= UPLOAD_QUEUE_MAX)) {
+				upload.full = true;
+				if (!_uploadsFull++)
+					pauseIncoming(true);
+			}
+			Client::WeakPtr weak(shared_from_this());
+			asset->write(msg.offset(), std::make_shared<bithorde::DataSegmentCtxBuffer>(msgCtx), [weak, handle, size]{
+				if (auto self = weak.lock())
+					self->uploadWritten(handle, size);
+			});
 		} else {
 			BOOST_LOG_SEV(clientLogger, bithorded::error) << peerName() << ':' << msg.handle() << " is not an upload-asset";
 		}
@@ -228,6 +377,22 @@ void Client::onMessage( const std::shared_ptr< bithorde::MessageContext< bithord
 	return;
 }
 
+void Client::uploadWritten(bithorde::Asset::Handle handle, size_t size)
+{
+	auto iter = _uploads.find(handle);
+	if (iter == _uploads.end())
+		return;
+	auto& upload = iter->second;
+	upload.pending -= size;
+	if (upload.full && (upload.pending < UPLOAD_QUEUE_RESUME)) {
+		upload.full = false;
+		if (!--_uploadsFull)
+			pauseIncoming(false);
+	}
+	if (!upload.pending)
+		_uploads.erase(iter);
+}
+
 void Client::setAuthenticated(const string peerName_)
 {
 	bithorde::Client::setAuthenticated(peerName_);
@@ -237,7 +402,10 @@ void Client::setAuthenticated(const string peerName_)
 	}
 }
 
-void Client::onReadResponse(const std::shared_ptr< bithorde::MessageContext<bithorde::Read::Request> >& reqCtx, int64_t offset, const std::shared_ptr<bithorde::IBuffer>& data, bithorde::Message::Deadline t) {
+void Client::onReadResponse(const std::shared_ptr< bithorde::MessageContext<bithorde::Read::Request> >& reqCtx, int64_t offset, const std::shared_ptr<bithorde::IBuffer>& data, bithorde::Message::Deadline t, const FairQueue::Ticket& ticket, bithorde::Message::Clock::time_point started, metrics::Histogram* latency, const bithorde::trace::Span& trace) {
+	latency->recordSince(started);
+	trace.finish("read");
+	bithorde::trace::Scope scope(trace.context());
 	bithorde::Read::Response resp;
 	resp.set_reqid( reqCtx->message().reqid());
 	auto size = data->size();
@@ -249,8 +417,10 @@ void Client::onReadResponse(const std::shared_ptr< bithorde::MessageContext<bith
 		resp.set_status(bithorde::NOTFOUND);
 	}
 	if (!sendMessage(bithorde::Connection::ReadResponse, resp, t)) {
+		readsDropped += 1;
 		BOOST_LOG_SEV(clientLogger, bithorded::warning) << "Failed to write data chunk, (offset " << offset << ')';
 	}
+	readDone(reqCtx->message());
 }
 
 void Client::informAssetStatus(bithorde::Asset::Handle h, bithorde::Status s)
@@ -259,6 +429,7 @@ void Client::informAssetStatus(bithorde::Asset::Handle h, bithorde::Status s)
 	if (asset_idx < _assets.size()) {
 		_assets[asset_idx].clearDeadline();
 	}
+	bindResolved(h);
 
 	bithorde::AssetStatus resp;
 	resp.set_handle(h);
@@ -274,6 +445,7 @@ void Client::informAssetStatusUpdate(bithorde::Asset::Handle h, const IAsset::Pt
 	if ((asset_idx >= _assets.size()) || (_assets[asset_idx] != asset))
 		return;
 	_assets[asset_idx].clearDeadline();
+	bindResolved(h);
 	bithorde::AssetStatus resp(status);
 	resp.set_handle(h);
 	if ((resp.status() == bithorde::SUCCESS)
@@ -292,6 +464,15 @@ void Client::informAssetStatusUpdate(bithorde::Asset::Handle h, const IAsset::Pt
 	sendMessage(bithorde::Connection::AssetStatus, resp, bithorde::Message::NEVER, true);
 }
 
+void Client::bindResolved(bithorde::Asset::Handle h)
+{
+	auto iter = _bindStarted.find(h);
+	if (iter != _bindStarted.end()) {
+		bindLatency.recordSince(iter->second);
+		_bindStarted.erase(iter);
+	}
+}
+
 void Client::assignAsset(bithorde::Asset::Handle handle_, const UpstreamRequestBinding::Ptr& a, const bithorde::Ids& assetIds, const bithorde::RouteTrace& requesters, const boost::posix_time::ptime& deadline)
 {
 	size_t handle = handle_;
@@ -321,6 +502,11 @@ void Client::assignAsset(bithorde::Asset::Handle handle_, const UpstreamRequestB
 
 void Client::onDisconnected()
 {
+	_readFlow->clear();
+	_readsCancel.cancel();
+	_stalledReads.clear();
+	_uploads.clear();
+	_uploadsFull = 0;
 	clearAssets();
 	bithorde::Client::onDisconnected();
 }
@@ -335,6 +521,7 @@ void Client::clearAssets()
 void Client::clearAsset(bithorde::Asset::Handle handle_)
 {
 	size_t handle = handle_;
+	_bindStarted.erase(handle_);
 	if (handle < _assets.size()) {
 		if ( auto& a = _assets[handle] ) {
 			a.reset();
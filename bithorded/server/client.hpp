@@ -18,11 +18,17 @@
 #ifndef BITHORDED_CLIENT_H
 #define BITHORDED_CLIENT_H
 
+#include "../lib/fairqueue.hpp"
+#include "../lib/grandcentraldispatch.hpp"
 #include "../lib/management.hpp"
+#include "../lib/metrics.hpp"
 #include "lib/allocator.h"
 #include "lib/client.h"
 #include "asset.hpp"
 
+#include <deque>
+#include <unordered_map>
+
 namespace bithorded {
 
 class Server;
@@ -30,6 +36,23 @@ class Client : public bithorde::Client, public management::DescriptiveDirectory
 {
 	Server& _server;
 	std::vector< AssetBinding > _assets;
+	std::unordered_map< bithorde::Asset::Handle, bithorde::Message::Clock::time_point > _bindStarted;
+	FairQueue::Flow::Ptr _readFlow;
+
+	struct StalledRead {
+		std::shared_ptr< bithorde::MessageContext< bithorde::Read::Request > > msgCtx;
+		bithorde::Message::Deadline deadline;
+	};
+	std::deque<StalledRead> _stalledReads; // Held back while our send-queue is congested
+	size_t _readBytesInFlight; // Admitted for reading, not yet responded to
+	CancelToken _readsCancel; // Drops reads still queued for the disk when disconnected
+
+	struct Upload {
+		size_t pending; // Received, but not yet written and hashed
+		bool full;
+	};
+	std::unordered_map<bithorde::Asset::Handle, Upload> _uploads;
+	size_t _uploadsFull; // While any upload is full, no more is read from the peer
 public:
 	typedef std::shared_ptr<Client> Ptr;
 	typedef std::weak_ptr<Client> WeakPtr;
@@ -41,6 +64,11 @@ public:
 
 	size_t serverAssets() const;
 
+	/**
+	 * Share of the servers read-capacity given to this client, relative to other clients.
+	 */
+	void setReadWeight(uint16_t weight);
+
 	virtual void describe(management::Info& target) const;
 	virtual void inspect(management::InfoList& target) const;
 
@@ -61,7 +89,15 @@ protected:
 private:
 	void informAssetStatus(bithorde::Asset::Handle h, bithorde::Status s);
 	void informAssetStatusUpdate(bithorde::Asset::Handle h, const bithorded::IAsset::Ptr& asset, const bithorde::AssetStatus& status);
-	void onReadResponse( const std::shared_ptr< bithorde::MessageContext< bithorde::Read::Request > >& reqCtx, int64_t offset, const std::shared_ptr< bithorde::IBuffer >& data, bithorde::Message::Deadline t );
+	void submitReadRequest( const std::shared_ptr< bithorde::MessageContext< bithorde::Read::Request > >& msgCtx, bithorde::Message::Deadline t );
+	void stallReadRequest( const std::shared_ptr< bithorde::MessageContext< bithorde::Read::Request > >& msgCtx, bithorde::Message::Deadline t );
+	void resumeReadRequests();
+	void readDone(const bithorde::Read::Request& msg);
+	void sendReadStatus(uint32_t reqid, bithorde::Status status);
+	void uploadWritten(bithorde::Asset::Handle handle, size_t size);
+	void processReadRequest( const std::shared_ptr< bithorde::MessageContext< bithorde::Read::Request > >& msgCtx, bithorde::Message::Deadline t, const FairQueue::Ticket& ticket, const bithorde::trace::Context& trace );
+	void onReadResponse( const std::shared_ptr< bithorde::MessageContext< bithorde::Read::Request > >& reqCtx, int64_t offset, const std::shared_ptr< bithorde::IBuffer >& data, bithorde::Message::Deadline t, const FairQueue::Ticket& ticket, bithorde::Message::Clock::time_point started, metrics::Histogram* latency, const bithorde::trace::Span& trace );
+	void bindResolved(bithorde::Asset::Handle h);
 	void assignAsset( bithorde::Asset::Handle handle_, const bithorded::UpstreamRequestBinding::Ptr& a, const bithorde::Ids& assetIds, const bithorde::RouteTrace& requesters, const boost::posix_time::ptime& deadline );
 	void clearAssets();
 	void clearAsset(bithorde::Asset::Handle handle);
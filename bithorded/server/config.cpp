@@ -104,11 +104,11 @@ public:
 };
 
 bithorded::Config::Client::Client() :
-	name(), cipher(CLEARTEXT), key()
+	name(), cipher(CLEARTEXT), key(), weight(0), uploadLimit(0), downloadLimit(0)
 {}
 
 bithorded::Config::Friend::Friend() :
-	addr(), port(0)
+	addr(), port(0), streams(1)
 {}
 
 
@@ -130,6 +130,15 @@ void read_client(const OptionGroup& options, bithorded::Config::Client& c) {
 		else if ((cipher == "PLAIN") || cipher == "CLEARTEXT")
 			c.cipher = bithorded::Config::Client::CLEARTEXT;
 	}
+	auto weight = options["weight"];
+	if (!weight.empty())
+		c.weight = boost::lexical_cast<uint16_t>(weight.as<string>());
+	auto upload = options["upload"];
+	if (!upload.empty())
+		c.uploadLimit = boost::lexical_cast<uint32_t>(upload.as<string>());
+	auto download = options["download"];
+	if (!download.empty())
+		c.downloadLimit = boost::lexical_cast<uint32_t>(download.as<string>());
 }
 
 std::string head(const std::string& str, char delim) {
@@ -168,12 +177,18 @@ bithorded::Config::Config(int argc, char* argv[])
 			"TCP port to listen on for incoming connections")
 		("server.inspectPort", po::value<uint16_t>(&inspectPort)->default_value(BITHORDED_DEFAULT_INSPECT_PORT),
 			"HTTP port to serve up inspection interface on")
+		("server.gatewayPort", po::value<uint16_t>(&gatewayPort)->default_value(0),
+			"HTTP port to serve assets on, as /tiger/<base32> or by magnet-link. Set to 0 to disable.")
+		("server.gatewayAddress", po::value<string>(&gatewayAddress)->default_value("127.0.0.1"),
+			"Address for the HTTP gateway to listen on.")
 		("server.unixSocket", po::value<string>(&unixSocket)->default_value(BITHORDED_DEFAULT_UNIX_SOCKET),
 			"Path to UNIX-socket to listen on")
 		("server.unixPerms", po::value<string>(&unixPerms)->default_value("0666"),
 			"Permissions for the created UNIX-socket.")
 		("server.parallel", po::value<uint16_t>(&parallel)->default_value(hardwareCores),
 			"How many workers to run for parallel job processing.")
+		("server.memoryBudget", po::value<uint32_t>(&memoryBudgetMB)->default_value(256),
+			"Max memory held by connections, in MB; received messages and send-queues. The heaviest peers are not read from while over. Set to 0 for unlimited.")
 	;
 
 	po::options_description cache_options("Cache Options");
@@ -184,7 +199,55 @@ bithorded::Config::Config(int argc, char* argv[])
 			"Max size of the cache, in MB.")
 	;
 
-	cli_options.add(log_options).add(server_options).add(cache_options);
+	po::options_description router_options("Router Options");
+	router_options.add_options()
+		("router.hedgeBudget", po::value<uint16_t>(&hedgeBudget)->default_value(10),
+			"Max percentage of upstream reads that may be duplicated to a second friend when the first is slow. Set to 0 to disable.")
+		("router.hedgePercentile", po::value<uint16_t>(&hedgePercentile)->default_value(95),
+			"Response-time percentile of a friend after which a read is hedged.")
+		("router.missCacheTTL", po::value<uint32_t>(&missCacheTTL)->default_value(30),
+			"Seconds to remember that no friend had an asset, answering repeated requests directly. Set to 0 to disable.")
+	;
+
+	po::options_description scheduler_options("Scheduler Options");
+	scheduler_options.add_options()
+		("scheduler.maxReads", po::value<uint16_t>(&maxReads)->default_value(32),
+			"How many reads to serve concurrently. Further reads are queued, and taken fairly from all clients by their weight.")
+		("scheduler.localWeight", po::value<uint16_t>(&localWeight)->default_value(8),
+			"Share of served bandwidth for clients on the local socket.")
+		("scheduler.clientWeight", po::value<uint16_t>(&clientWeight)->default_value(4),
+			"Share of served bandwidth for remote clients, unless given as weight for the client.")
+		("scheduler.friendWeight", po::value<uint16_t>(&friendWeight)->default_value(1),
+			"Share of served bandwidth for friends, unless given as weight for the friend.")
+	;
+
+	po::options_description limits_options("Bandwidth Limits, in KiB/s. 0 means unlimited");
+	limits_options.add_options()
+		("limits.upload", po::value<uint32_t>(&uploadLimit)->default_value(0),
+			"Total upload to all remote peers.")
+		("limits.download", po::value<uint32_t>(&downloadLimit)->default_value(0),
+			"Total download from all friends.")
+		("limits.friendUpload", po::value<uint32_t>(&friendUploadLimit)->default_value(0),
+			"Total upload to friends.")
+		("limits.friendDownload", po::value<uint32_t>(&friendDownloadLimit)->default_value(0),
+			"Total download from friends.")
+		("limits.clientUpload", po::value<uint32_t>(&clientUploadLimit)->default_value(0),
+			"Total upload to remote clients, that are not friends.")
+	;
+
+	po::options_description tracing_options("Tracing Options");
+	tracing_options.add_options()
+		("tracing.sampleEvery", po::value<uint32_t>(&traceSampleEvery)->default_value(0),
+			"Trace one in every N read requests, exported as Chrome trace from the inspection interface. Set to 0 to disable.")
+		("tracing.spans", po::value<uint32_t>(&traceSpans)->default_value(65536),
+			"How many of the latest spans to keep.")
+		("tracing.loopInterval", po::value<uint32_t>(&loopInterval)->default_value(25),
+			"Milliseconds between probes measuring event-loop lag. Set to 0 to disable.")
+		("tracing.loopThreshold", po::value<uint32_t>(&loopThreshold)->default_value(50),
+			"Milliseconds of event-loop lag, or of a single handler running, counted as a stall.")
+	;
+
+	cli_options.add(log_options).add(server_options).add(cache_options).add(router_options).add(scheduler_options).add(limits_options).add(tracing_options);
 
 	DynamicMap vm;
 	vm.store(po::parse_command_line(argc, argv, cli_options));
@@ -195,7 +258,7 @@ bithorded::Config::Config(int argc, char* argv[])
 
 	if (!configPath.empty()) {
 		po::options_description config_options;
-		config_options.add(log_options).add(server_options).add(cache_options);
+		config_options.add(log_options).add(server_options).add(cache_options).add(router_options).add(scheduler_options).add(limits_options).add(tracing_options);
 		std::ifstream cfg(configPath);
 		if (!cfg.is_open())
 			throw ArgumentError("Failed to open config-file");
@@ -234,6 +297,9 @@ bithorded::Config::Config(int argc, char* argv[])
 			else
 				f.port = boost::lexical_cast<ushort>(addr.substr(colpos+1));
 		}
+		auto opt_streams = (*opt)["streams"];
+		if (!opt_streams.empty())
+			f.streams = std::max(boost::lexical_cast<uint16_t>(opt_streams.as<string>()), static_cast<uint16_t>(1));
 		friends.push_back(f);
 	}
 
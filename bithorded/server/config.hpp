@@ -55,12 +55,15 @@ struct Config
 			AES_CTR = 3
 		} cipher;
 		std::string key;
+		uint16_t weight; // 0 means the default for its class
+		uint32_t uploadLimit, downloadLimit; // KiB/s, 0 means unlimited
 	};
 
 	struct Friend : public Client {
 		Friend();
 		std::string addr;
 		ushort port;
+		uint16_t streams; // Parallel connections to keep with the friend
 	};
 
 	Config(int argc, char* argv[]);
@@ -73,14 +76,37 @@ struct Config
 
 	std::string nodeName;
 	uint16_t parallel;
+	uint32_t memoryBudgetMB;
 
 	std::string cacheDir;
 	int cacheSizeMB;
 
+	uint16_t hedgeBudget;
+	uint16_t hedgePercentile;
+	uint32_t missCacheTTL;
+
+	uint16_t maxReads;
+	uint16_t localWeight;
+	uint16_t clientWeight;
+	uint16_t friendWeight;
+
+	uint32_t uploadLimit;
+	uint32_t downloadLimit;
+	uint32_t friendUploadLimit;
+	uint32_t friendDownloadLimit;
+	uint32_t clientUploadLimit;
+
+	uint32_t traceSampleEvery;
+	uint32_t traceSpans;
+	uint32_t loopInterval;
+	uint32_t loopThreshold;
+
 	uint16_t tcpPort;
 	std::string unixSocket;
 	std::string unixPerms;
 	uint16_t inspectPort;
+	uint16_t gatewayPort;
+	std::string gatewayAddress;
 
 	std::vector<Source> sources;
 	std::vector<Friend> friends;
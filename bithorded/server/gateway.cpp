@@ -0,0 +1,401 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "gateway.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <map>
+#include <sys/sendfile.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <bithorded/http_server/request_handler.hpp>
+#include <bithorded/lib/log.hpp>
+#include <bithorded/lib/loopmonitor.hpp>
+#include <bithorded/lib/metrics.hpp>
+#include <bithorded/server/server.hpp>
+#include <lib/buffer.hpp>
+#include <lib/hashes.h>
+#include <lib/magneturi.h>
+#include <lib/random.h>
+#include <lib/timer.h>
+
+using namespace std;
+
+namespace asio = boost::asio;
+namespace ptime = boost::posix_time;
+
+using namespace bithorded;
+using http::server::reply;
+
+namespace bithorded {
+	Logger gatewayLog;
+}
+
+namespace {
+	// How long to wait for an asset to be found
+	const uint32_t BIND_TIMEOUT_MS = 10000;
+	// Timeout of each read through the asset
+	const uint32_t READ_TIMEOUT_MS = 5000;
+	const size_t READ_CHUNK = 64*1024;
+	// Reads kept in flight ahead of the socket
+	const size_t READ_AHEAD = 16;
+	// sendfile() reads from disk on the loop; keep each chunk short, and hint the next to the kernel
+	const size_t SENDFILE_CHUNK = 128*1024;
+
+	metrics::Counter sentZeroCopy("bithorded_gateway_sent_bytes_total", "Asset-data sent by the HTTP gateway", {{"method", "sendfile"}});
+	metrics::Counter sentCopied("bithorded_gateway_sent_bytes_total", "Asset-data sent by the HTTP gateway", {{"method", "copy"}});
+	size_t activeTransfers = 0;
+
+	reply::status_type httpStatus(bithorde::Status status) {
+		switch (status) {
+		case bithorde::NOTFOUND: return reply::not_found;
+		case bithorde::TIMEOUT: return reply::gateway_timeout;
+		case bithorde::NORESOURCES: return reply::service_unavailable;
+		default: return reply::bad_gateway;
+		}
+	}
+
+/**
+ * One HTTP-request for an asset; binds it, answers with its headers once found, and streams the
+ * requested range.
+ */
+class Transfer : public std::enable_shared_from_this<Transfer> {
+	Server& _server;
+	asio::ip::tcp::socket& _socket;
+	reply::done_handler _done;
+	bithorde::BindRead _bind;
+	http::server::request _request;
+	std::shared_ptr<Transfer> _self; // Kept alive until finished
+	AssetBinding _binding;
+	IAsset::Ptr _asset;
+	Timer _timeout;
+	reply _head;
+	uint64_t _pos, _requested, _end;
+	std::map< uint64_t, std::shared_ptr<bithorde::IBuffer> > _ready;
+	size_t _inFlight;
+	bool _responded, _writing, _filling, _finished;
+public:
+	Transfer(Server& server, asio::ip::tcp::socket& socket, const reply::done_handler& done, const bithorde::BindRead& bind, const http::server::request& request) :
+		_server(server),
+		_socket(socket),
+		_done(done),
+		_bind(bind),
+		_request(request),
+		_timeout(server.timerService(), std::bind(&Transfer::onTimeout, this)),
+		_pos(0), _requested(0), _end(0),
+		_inFlight(0),
+		_responded(false), _writing(false), _filling(false), _finished(false)
+	{
+		activeTransfers++;
+	}
+
+	~Transfer() {
+		activeTransfers--;
+	}
+
+	void start() {
+		_self = shared_from_this();
+		_timeout.arm(ptime::milliseconds(BIND_TIMEOUT_MS));
+		UpstreamRequestBinding::Ptr asset;
+		try {
+			asset = _server.asyncFindAsset(_bind);
+		} catch (const BindError& e) {
+			return respond(httpStatus(e.status));
+		}
+		if (!asset)
+			return respond(reply::not_found);
+		auto deadline = ptime::microsec_clock::universal_time() + ptime::milliseconds(BIND_TIMEOUT_MS);
+		std::weak_ptr<Transfer> weak(_self);
+		auto bound = _binding.bind(asset, _bind.ids(), _bind.requesters(), deadline,
+			[weak](const IAsset::Ptr&, const bithorde::AssetStatus& status) {
+				if (auto self = weak.lock())
+					self->onStatus(status);
+			}
+		);
+		if (!bound)
+			respond(reply::bad_gateway);
+	}
+
+private:
+	bool isHead() const {
+		return _request.method == "HEAD";
+	}
+
+	void onTimeout() {
+		if (!_responded)
+			respond(reply::gateway_timeout);
+	}
+
+	void onStatus(const bithorde::AssetStatus& status) {
+		if (_responded)
+			return;
+		switch (status.status()) {
+		case bithorde::NONE:
+			return;
+		case bithorde::SUCCESS:
+			return serve();
+		default:
+			return respond(httpStatus(status.status()));
+		}
+	}
+
+	void serve() {
+		_asset = _binding.shared();
+		auto size = _asset->size();
+		uint64_t first = 0, last = size - 1;
+		switch (size ? _request.range(size, first, last) : http::server::request::no_range) {
+		case http::server::request::unsatisfiable_range:
+			_head = reply::stock_reply(reply::range_not_satisfiable);
+			_head.headers.push_back({"Content-Range", "bytes */" + boost::lexical_cast<string>(size)});
+			return writeHead(true);
+		case http::server::request::valid_range:
+			_head.status = reply::partial_content;
+			_head.headers.push_back({"Content-Range", "bytes " + boost::lexical_cast<string>(first) + '-' +
+				boost::lexical_cast<string>(last) + '/' + boost::lexical_cast<string>(size)});
+			break;
+		case http::server::request::no_range:
+			_head.status = reply::ok;
+			break;
+		}
+		_pos = _requested = size ? first : 0;
+		_end = size ? last + 1 : 0;
+		_head.headers.push_back({"Content-Length", boost::lexical_cast<string>(_end - _pos)});
+		_head.headers.push_back({"Content-Type", "application/octet-stream"});
+		_head.headers.push_back({"Accept-Ranges", "bytes"});
+		auto tigerId = findBithordeId(_asset->status->ids(), bithorde::HashType::TREE_TIGER);
+		if (!tigerId.empty())
+			_head.headers.push_back({"ETag", '"' + tigerId.base32() + '"'});
+		BOOST_LOG_SEV(gatewayLog, debug) << "Serving " << _request.uri << " bytes " << _pos << '-' << _end << '/' << size;
+		writeHead(isHead() || (_pos == _end));
+	}
+
+	void respond(reply::status_type status) {
+		_head = reply::stock_reply(status);
+		writeHead(true);
+	}
+
+	void writeHead(bool last) {
+		_responded = true;
+		_writing = true;
+		_timeout.clear();
+		if (isHead())
+			_head.content.clear();
+		auto self = shared_from_this();
+		asio::async_write(_socket, _head.to_buffers(), [self, last](const boost::system::error_code& ec, size_t) {
+			self->_writing = false;
+			if (ec || last)
+				self->finish(ec);
+			else
+				self->send();
+		});
+	}
+
+	void send() {
+		if (_writing || _finished)
+			return;
+		if (_pos >= _end)
+			return finish(boost::system::error_code());
+
+		auto ready = _ready.find(_pos);
+		if (ready != _ready.end()) {
+			auto data = ready->second;
+			_ready.erase(ready);
+			_writing = true;
+			auto self = shared_from_this();
+			asio::async_write(_socket, asio::buffer(**data, data->size()), [self, data](const boost::system::error_code& ec, size_t written) {
+				self->onWritten(ec, written);
+			});
+			return fill();
+		}
+
+		if (_requested == _pos) {
+			int fd;
+			uint64_t fileOffset;
+			if (auto available = _asset->mapFile(_pos, std::min<uint64_t>(SENDFILE_CHUNK, _end - _pos), fd, fileOffset))
+				return sendFile(fd, fileOffset, available);
+		}
+		fill();
+	}
+
+	void onWritten(const boost::system::error_code& ec, size_t written) {
+		_writing = false;
+		if (ec)
+			return finish(ec);
+		_pos += written;
+		sentCopied += written;
+		send();
+	}
+
+	void sendFile(int fd, uint64_t fileOffset, size_t size) {
+		LoopMonitor::Scope loop("gateway.sendfile");
+		boost::system::error_code ec;
+		_socket.native_non_blocking(true, ec);
+		if (ec)
+			return finish(ec);
+		off_t offset = fileOffset;
+		auto sent = ::sendfile(_socket.native_handle(), fd, &offset, size);
+		if (sent < 0) {
+			if ((errno == EPIPE) || (errno == ECONNRESET)) {
+				BOOST_LOG_SEV(gatewayLog, debug) << "Client went away during " << _request.uri;
+				return finish(asio::error::connection_reset);
+			}
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+				return finish(boost::system::error_code(errno, boost::system::system_category()));
+		} else if (sent == 0) {
+			// File ended before the asset; must have been truncated under us
+			return finish(boost::system::errc::make_error_code(boost::system::errc::io_error));
+		} else {
+			_pos += sent;
+			_requested = _pos;
+			sentZeroCopy += sent;
+			if (_pos < _end)
+				::posix_fadvise(fd, offset, std::min<uint64_t>(SENDFILE_CHUNK, _end - _pos), POSIX_FADV_WILLNEED);
+		}
+		// Yield to the loop between chunks, whether the socket is full or not
+		_writing = true;
+		auto self = shared_from_this();
+		_socket.async_wait(asio::ip::tcp::socket::wait_write, [self](const boost::system::error_code& ec) {
+			self->_writing = false;
+			if (ec)
+				self->finish(ec);
+			else
+				self->send();
+		});
+	}
+
+	/**
+	 * Requests data from the asset, up to READ_AHEAD reads ahead of the socket, stopping at data
+	 * that can be sent straight from file.
+	 */
+	void fill() {
+		if (_filling || _finished)
+			return;
+		_filling = true;
+		while ((_inFlight < READ_AHEAD) && (_requested < _end)) {
+			auto chunk = std::min<uint64_t>(READ_CHUNK, _end - _requested);
+			int fd;
+			uint64_t fileOffset;
+			if ((_requested != _pos) && _asset->mapFile(_requested, chunk, fd, fileOffset))
+				break;
+			read(_requested, chunk);
+			_requested += chunk;
+		}
+		_filling = false;
+		// Reads may have completed synchronously
+		if (_ready.count(_pos))
+			send();
+	}
+
+	void read(uint64_t offset, size_t size) {
+		_inFlight++;
+		auto self = shared_from_this();
+		_asset->asyncRead(offset, size, READ_TIMEOUT_MS, [self, offset, size](int64_t, const std::shared_ptr<bithorde::IBuffer>& data) {
+			self->onRead(offset, size, data);
+		});
+	}
+
+	void onRead(uint64_t offset, size_t size, const std::shared_ptr<bithorde::IBuffer>& data) {
+		_inFlight--;
+		if (_finished)
+			return;
+		if (!data || !data->size()) {
+			BOOST_LOG_SEV(gatewayLog, warning) << "Failed to read " << _request.uri << " at " << offset;
+			return finish(boost::system::errc::make_error_code(boost::system::errc::io_error));
+		}
+		_ready[offset] = data;
+		// Issuing reads from inside a read-callback re-enters the asset, so continue from the loop
+		auto self = shared_from_this();
+		asio::post(_socket.get_executor(), [self, offset, size, data]() {
+			if (self->_finished)
+				return;
+			if (data->size() < size) // Short read, request the rest
+				self->read(offset + data->size(), size - data->size());
+			self->send();
+		});
+	}
+
+	void finish(const boost::system::error_code& ec) {
+		if (_finished)
+			return;
+		_finished = true;
+		_timeout.clear();
+		_ready.clear();
+		_binding.reset();
+		_asset.reset();
+		auto self = std::move(_self);
+		_done(ec);
+	}
+};
+
+}
+
+Gateway::Gateway(Server& server, const string& address, uint16_t port) :
+	_server(server),
+	_address(address),
+	_http(server.ioCtx(), address, port, *this),
+	_port(_http.port())
+{}
+
+bool Gateway::handle(const path& path, const http::server::request& req, reply& reply) const
+{
+	auto iter = path.begin();
+	if (iter == path.end())
+		return false;
+
+	MagnetURI magnet;
+	if (*iter == "tiger") {
+		if (++iter == path.end())
+			return false;
+		magnet.parse("magnet:?xt=urn:tree:tiger:" + *iter);
+	} else if (boost::starts_with(*iter, "magnet:")) {
+		// The query-string of the request is the magnet-link's own
+		string link;
+		http::server::request_handler::url_decode(req.uri.substr(req.uri.find("magnet:")), link);
+		magnet.parse(link);
+	} else {
+		return false;
+	}
+
+	if ((req.method != "GET") && (req.method != "HEAD")) {
+		reply = reply::stock_reply(reply::not_implemented);
+		return true;
+	}
+
+	bithorde::BindRead bind;
+	bind.set_handle(0);
+	*bind.mutable_ids() = magnet.toIdList();
+	bind.set_timeout(BIND_TIMEOUT_MS);
+	bind.add_requesters(rand64()); // Like any client, or the router has no requester to forward for
+	if (findBithordeId(bind.ids(), bithorde::HashType::TREE_TIGER).empty()) {
+		reply = reply::stock_reply(reply::bad_request);
+		return true;
+	}
+
+	auto& server = _server;
+	reply.stream = [&server, bind, req](asio::ip::tcp::socket& socket, const reply::done_handler& done) {
+		std::make_shared<Transfer>(server, socket, done, bind, req)->start();
+	};
+	return true;
+}
+
+void Gateway::describe(management::Info& target) const
+{
+	target << _address << ':' << _port << ", " << activeTransfers << " transfers active, "
+		<< (sentZeroCopy.value() >> 20) << " MiB sent with sendfile, " << (sentCopied.value() >> 20) << " MiB copied";
+}
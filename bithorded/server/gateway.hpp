@@ -0,0 +1,54 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef BITHORDED_GATEWAY_HPP
+#define BITHORDED_GATEWAY_HPP
+
+#include <string>
+
+#include "../http_server/server.hpp"
+#include "../lib/management.hpp"
+
+namespace bithorded {
+
+class Server;
+
+/**
+ * Serves assets over HTTP, for browsers and media players. Assets are requested as
+ * /tiger/<base32>, optionally followed by a file name, or as an url-encoded magnet-link, and
+ * bound like for any other client; from sources, the cache or through the router.
+ *
+ * Supports HEAD and single byte-ranges. Ranges held locally are sent straight from the file with
+ * sendfile(), the rest is read through the asset, keeping a window of reads in flight ahead of
+ * the socket.
+ */
+class Gateway : public http::server::RequestRouter, public management::Leaf {
+	Server& _server;
+	std::string _address;
+	http::server::server _http;
+	uint16_t _port;
+public:
+	Gateway(Server& server, const std::string& address, uint16_t port);
+
+	uint16_t port() const { return _port; }
+
+	virtual bool handle(const path& path, const http::server::request& req, http::server::reply& reply) const;
+	virtual void describe(management::Info& target) const;
+};
+
+}
+
+#endif // BITHORDED_GATEWAY_HPP
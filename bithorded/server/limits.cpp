@@ -0,0 +1,99 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "limits.hpp"
+
+#include <algorithm>
+
+using namespace bithorded;
+
+namespace {
+	const uint64_t MIN_BURST = 256*1024;
+
+	TokenBucket::Ptr bucket(uint32_t kibPerSec) {
+		uint64_t rate = static_cast<uint64_t>(kibPerSec) * 1024;
+		// Allow a seconds worth of burst, but at least a couple of full-sized messages
+		return std::make_shared<TokenBucket>(rate, std::max(rate, MIN_BURST));
+	}
+
+	void appendLimited(std::vector<TokenBucket::Ptr>& target, const TokenBucket::Ptr& limit) {
+		if (limit->rate())
+			target.push_back(limit);
+	}
+}
+
+BandwidthLimits::BandwidthLimits(const Config& cfg) :
+	_cfg(cfg),
+	_upload(bucket(cfg.uploadLimit)),
+	_download(bucket(cfg.downloadLimit)),
+	_friendUpload(bucket(cfg.friendUploadLimit)),
+	_friendDownload(bucket(cfg.friendDownloadLimit)),
+	_clientUpload(bucket(cfg.clientUploadLimit))
+{
+	for (auto iter = _cfg.friends.begin(); iter != _cfg.friends.end(); iter++) {
+		if (iter->uploadLimit)
+			_peerUpload[iter->name] = bucket(iter->uploadLimit);
+		if (iter->downloadLimit)
+			_peerDownload[iter->name] = bucket(iter->downloadLimit);
+	}
+	for (auto iter = _cfg.clients.begin(); iter != _cfg.clients.end(); iter++) {
+		if (iter->uploadLimit)
+			_peerUpload[iter->name] = bucket(iter->uploadLimit);
+	}
+}
+
+std::vector<TokenBucket::Ptr> BandwidthLimits::upload(const std::string& peername)
+{
+	std::vector<TokenBucket::Ptr> res;
+	appendLimited(res, _upload);
+	bool isFriend = false;
+	for (auto iter = _cfg.friends.begin(); iter != _cfg.friends.end(); iter++)
+		isFriend |= (iter->name == peername);
+	appendLimited(res, isFriend ? _friendUpload : _clientUpload);
+	auto peer = _peerUpload.find(peername);
+	if (peer != _peerUpload.end())
+		res.push_back(peer->second);
+	return res;
+}
+
+std::vector<TokenBucket::Ptr> BandwidthLimits::download(const std::string& peername)
+{
+	std::vector<TokenBucket::Ptr> res;
+	appendLimited(res, _download);
+	appendLimited(res, _friendDownload);
+	auto peer = _peerDownload.find(peername);
+	if (peer != _peerDownload.end())
+		res.push_back(peer->second);
+	return res;
+}
+
+void BandwidthLimits::describe(management::Info& target) const
+{
+	target << "upload: " << *_upload << ", download: " << *_download;
+}
+
+void BandwidthLimits::inspect(management::InfoList& target) const
+{
+	target.append("upload") << *_upload;
+	target.append("download") << *_download;
+	target.append("friendUpload") << *_friendUpload;
+	target.append("friendDownload") << *_friendDownload;
+	target.append("clientUpload") << *_clientUpload;
+	for (auto iter = _peerUpload.begin(); iter != _peerUpload.end(); iter++)
+		target.append("upload." + iter->first) << *iter->second;
+	for (auto iter = _peerDownload.begin(); iter != _peerDownload.end(); iter++)
+		target.append("download." + iter->first) << *iter->second;
+}
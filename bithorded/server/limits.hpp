@@ -0,0 +1,59 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef BITHORDED_LIMITS_HPP
+#define BITHORDED_LIMITS_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../lib/management.hpp"
+#include "../../lib/tokenbucket.h"
+#include "config.hpp"
+
+namespace bithorded {
+
+/**
+ * The configured bandwidth-limits, globally, per class of peer and per peer.
+ */
+class BandwidthLimits : public management::DescriptiveDirectory
+{
+	const Config& _cfg;
+	TokenBucket::Ptr _upload, _download;
+	TokenBucket::Ptr _friendUpload, _friendDownload, _clientUpload;
+	std::map<std::string, TokenBucket::Ptr> _peerUpload, _peerDownload;
+public:
+	BandwidthLimits(const Config& cfg);
+
+	/**
+	 * All limits applying to data sent to a remote peer.
+	 */
+	std::vector<TokenBucket::Ptr> upload(const std::string& peername);
+
+	/**
+	 * All limits applying to data read from a friend.
+	 */
+	std::vector<TokenBucket::Ptr> download(const std::string& peername);
+
+	virtual void describe(management::Info& target) const;
+	virtual void inspect(management::InfoList& target) const;
+};
+
+}
+
+#endif // BITHORDED_LIMITS_HPP
@@ -0,0 +1,77 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "memory.hpp"
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+using namespace bithorded;
+
+MemoryGovernor::MemoryGovernor(boost::asio::io_context& ioCtx, size_t limit, const ClientMap& clients) :
+	_clients(clients),
+	_budget(std::make_shared<MemoryBudget>(ioCtx, limit)),
+	_poolBytes("bithorded_memory_bytes", "Memory held by connections, per pool", "gauge",
+		[this](const std::string& name, metrics::SampleList& samples) {
+			for (int pool = 0; pool < MemoryBudget::POOLS; pool++) {
+				auto p = static_cast<MemoryBudget::Pool>(pool);
+				samples.push_back(metrics::Sample{name, {{"pool", MemoryBudget::poolName(p)}}, static_cast<double>(_budget->used(p))});
+			}
+		}),
+	_throttledClients("bithorded_memory_throttled_clients", "Peers not read from, for being among the heaviest while over the memory budget", "gauge",
+		[this](const std::string& name, metrics::SampleList& samples) {
+			samples.push_back(metrics::Sample{name, {}, static_cast<double>(_budget->throttled())});
+		}),
+	_throttleEvents("bithorded_memory_throttled_total", "Times a peer has been throttled by the memory budget", "counter",
+		[this](const std::string& name, metrics::SampleList& samples) {
+			samples.push_back(metrics::Sample{name, {}, static_cast<double>(_budget->throttleEvents())});
+		})
+{
+}
+
+void MemoryGovernor::govern(const bithorded::Client::Ptr& client)
+{
+	client->setMemoryBudget(_budget);
+}
+
+void MemoryGovernor::describe(management::Info& target) const
+{
+	target << *_budget;
+}
+
+void MemoryGovernor::inspect(management::InfoList& target) const
+{
+	target.append("limit") << (_budget->limit() >> 20) << "MiB, throttling down to " << (_budget->lowWater() >> 20) << "MiB";
+	for (int pool = 0; pool < MemoryBudget::POOLS; pool++) {
+		auto p = static_cast<MemoryBudget::Pool>(pool);
+		target.append(MemoryBudget::poolName(p)) << (_budget->used(p) >> 10) << "KiB";
+	}
+	target.append("throttled") << _budget->throttled() << " now, " << _budget->throttleEvents() << " times in total";
+
+	// Heaviest peers first
+	std::vector< std::tuple<size_t, std::string, bool> > peers;
+	for (auto iter = _clients.begin(); iter != _clients.end(); iter++) {
+		if (auto client = iter->second.lock())
+			peers.emplace_back(client->memoryHeld(), iter->first, client->memoryThrottled());
+	}
+	std::sort(peers.rbegin(), peers.rend());
+	for (auto iter = peers.begin(); iter != peers.end(); iter++) {
+		auto& info = target.append("peer." + std::get<1>(*iter)) << (std::get<0>(*iter) >> 10) << "KiB";
+		if (std::get<2>(*iter))
+			info << ", throttled";
+	}
+}
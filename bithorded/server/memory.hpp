@@ -0,0 +1,60 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef BITHORDED_MEMORY_HPP
+#define BITHORDED_MEMORY_HPP
+
+#include <string>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/core/noncopyable.hpp>
+
+#include "../lib/management.hpp"
+#include "../lib/metrics.hpp"
+#include "../lib/weakmap.hpp"
+#include "lib/memorybudget.h"
+#include "client.hpp"
+
+namespace bithorded {
+
+/**
+ * Holds the memory used by all connections within the configured budget, by no longer reading
+ * from the heaviest peers while over it. Exposes usage per pool and peer.
+ */
+class MemoryGovernor : public management::DescriptiveDirectory, boost::noncopyable {
+public:
+	typedef WeakMap<std::string, bithorded::Client> ClientMap;
+private:
+	const ClientMap& _clients;
+	MemoryBudget::Ptr _budget;
+	metrics::Collector _poolBytes, _throttledClients, _throttleEvents;
+public:
+	MemoryGovernor(boost::asio::io_context& ioCtx, size_t limit, const ClientMap& clients);
+
+	/**
+	 * Accounts /client/ in the budget, throttling it when among the heaviest while over.
+	 */
+	void govern(const bithorded::Client::Ptr& client);
+
+	const MemoryBudget& budget() const { return *_budget; }
+
+	virtual void describe(management::Info& target) const;
+	virtual void inspect(management::InfoList& target) const;
+};
+
+}
+
+#endif // BITHORDED_MEMORY_HPP
@@ -63,12 +63,35 @@ bithorded::Config::Client null_client;
 Server::Server(asio::io_context& ioCtx, Config& cfg) :
 	GrandCentralDispatch(ioCtx, cfg.parallel),
 	_cfg(cfg),
-	_timerSvc(new TimerService(ioCtx)),
+	_timerSvc(TimerService::forContext(ioCtx)),
+	_loopMonitor(*_timerSvc, std::chrono::milliseconds(cfg.loopInterval), std::chrono::milliseconds(cfg.loopThreshold)),
 	_tcpListener(ioCtx),
 	_localListener(ioCtx),
+	_memory(ioCtx, static_cast<size_t>(cfg.memoryBudgetMB)*1024*1024, _connections),
+	_readQueue(cfg.maxReads, 128*1024),
+	_limits(cfg),
 	_router(*this),
-	_cache(*this, _router, cfg.cacheDir, static_cast<intmax_t>(cfg.cacheSizeMB)*1024*1024)
+	_cache(*this, _router, cfg.cacheDir, static_cast<intmax_t>(cfg.cacheSizeMB)*1024*1024),
+	_peerSentBytes("bithorded_peer_sent_bytes_total", "Bytes sent to each connected peer", "counter",
+		std::bind(&Server::collectPeers, this, std::placeholders::_1, std::placeholders::_2, [](const bithorde::ConnectionStats& s) { return s.outgoingBytes.value(); }, &PeerTraffic::sent)),
+	_peerReceivedBytes("bithorded_peer_received_bytes_total", "Bytes received from each connected peer", "counter",
+		std::bind(&Server::collectPeers, this, std::placeholders::_1, std::placeholders::_2, [](const bithorde::ConnectionStats& s) { return s.incomingBytes.value(); }, &PeerTraffic::received)),
+	_peerSendQueue("bithorded_peer_send_queue_bytes", "Bytes waiting to be sent to each connected peer", "gauge",
+		std::bind(&Server::collectPeers, this, std::placeholders::_1, std::placeholders::_2, [](const bithorde::ConnectionStats& s) { return s.outgoingQueued; }, nullptr)),
+	_dispatchQueued("bithorded_dispatch_queued_jobs", "Jobs waiting for a worker, per priority", "gauge",
+		[this](const std::string& name, metrics::SampleList& samples) {
+			for (int priority = 0; priority < PRIORITIES; priority++) {
+				auto p = static_cast<Priority>(priority);
+				samples.push_back(metrics::Sample{name, {{"priority", priorityName(p)}}, static_cast<double>(queued(p))});
+			}
+		}),
+	_dispatchStolen("bithorded_dispatch_stolen_jobs_total", "Jobs run by another worker than queued on", "counter",
+		[this](const std::string& name, metrics::SampleList& samples) {
+			samples.push_back(metrics::Sample{name, {}, static_cast<double>(stolen())});
+		})
 {
+	bithorde::trace::Tracer::instance().configure(cfg.traceSpans, cfg.traceSampleEvery);
+
 	for (auto iter=_cfg.sources.begin(); iter != _cfg.sources.end(); iter++)
 		_assetStores.push_back( unique_ptr<source::Store>(new source::Store(*this, iter->name, iter->root)) );
 
@@ -113,6 +136,11 @@ Server::Server(asio::io_context& ioCtx, Config& cfg) :
 		BOOST_LOG_SEV(serverLog, info) << "Inspection interface listening on port " << _cfg.inspectPort;
 	}
 
+	if (_cfg.gatewayPort) {
+		_gateway.reset(new Gateway(*this, _cfg.gatewayAddress, _cfg.gatewayPort));
+		BOOST_LOG_SEV(serverLog, info) << "HTTP gateway listening on " << _cfg.gatewayAddress << ':' << _gateway->port();
+	}
+
 	BOOST_LOG_SEV(serverLog, info) << "Server started, version " << bithorde::build_version;
 }
 
@@ -132,6 +160,10 @@ void Server::hookup ( const std::shared_ptr< asio::ip::tcp::socket >& socket, co
 	bithorded::Client::Ptr c = bithorded::Client::create(*this);
 	auto conn = bithorde::Connection::create(ioCtx(), std::make_shared<bithorde::ConnectionStats>(_timerSvc), socket);
 	c->setSecurity(client.key, (bithorde::CipherType)client.cipher);
+	c->authenticated.connect([=](bithorde::Client& c, const std::string& peerName){
+		// Only remote peers are limited, local clients are not metered
+		c.setSendLimits(_limits.upload(peerName));
+	});
 	if (client.name.empty())
 		c->hookup(conn);
 	else
@@ -145,6 +177,7 @@ void Server::waitForLocalConnection()
 	_localListener.async_accept(*sock, [=](const boost::system::error_code& error) {
 		if (!error) {
 			bithorded::Client::Ptr c = bithorded::Client::create(*this);
+			c->setReadWeight(_cfg.localWeight);
 			c->hookup(bithorde::Connection::create(ioCtx(), std::make_shared<bithorde::ConnectionStats>(_timerSvc), sock));
 			clientConnected(c);
 			waitForLocalConnection();
@@ -156,6 +189,21 @@ void Server::inspect(management::InfoList& target) const
 {
 	target.append("router", _router);
 	target.append("connections", _connections);
+	target.append("limits", _limits);
+	target.append("memory", _memory);
+	if (_gateway)
+		target.append("gateway", *_gateway);
+	target.append("metrics", &_metricsExporter) << "Prometheus metrics";
+	auto& tracer = bithorde::trace::Tracer::instance();
+	target.append("trace", &_traceExporter) << (tracer.enabled() ? "enabled" : "disabled") << ", " << tracer.recorded() << " spans recorded";
+	target.append("loop", _loopMonitor);
+	auto& dispatch = target.append("dispatch");
+	for (int priority = 0; priority < PRIORITIES; priority++) {
+		auto p = static_cast<Priority>(priority);
+		dispatch << priorityName(p) << ' ' << queued(p) << ", ";
+	}
+	dispatch << stolen() << " stolen";
+	target.append("readQueue") << _readQueue.active() << '/' << _readQueue.maxActive() << " reads active, " << _readQueue.queued() << " queued";
 	if (_cache.enabled())
 		target.append("cache", _cache);
 	for (auto iter=_assetStores.begin(); iter!=_assetStores.end(); iter++) {
@@ -164,8 +212,43 @@ void Server::inspect(management::InfoList& target) const
 	}
 }
 
+bool Server::isFriend(const string& name) const
+{
+	for (auto iter = _cfg.friends.begin(); iter != _cfg.friends.end(); iter++) {
+		if (name == iter->name)
+			return true;
+	}
+	return false;
+}
+
+void Server::collectPeers(const string& name, metrics::SampleList& samples, std::function<double(const bithorde::ConnectionStats&)> value, uint64_t PeerTraffic::* closed) const
+{
+	std::map<std::string, double> totals;
+	if (closed) {
+		for (auto iter = _closedTraffic.begin(); iter != _closedTraffic.end(); iter++)
+			totals[iter->first] = iter->second.*closed;
+	}
+	for (auto iter=_connections.begin(); iter != _connections.end(); iter++) {
+		auto conn = iter->second.lock();
+		if (!conn)
+			continue;
+		auto streams = _router.streams(iter->first);
+		if (streams.empty() && conn->isConnected())
+			streams.push_back(conn);
+		auto& total = totals[iter->first];
+		for (auto& stream : streams) {
+			if (stream->stats)
+				total += value(*stream->stats);
+		}
+	}
+	for (auto iter = totals.begin(); iter != totals.end(); iter++)
+		samples.push_back(metrics::Sample{name, {{"peer", iter->first}}, iter->second});
+}
+
 void Server::clientConnected(const bithorded::Client::Ptr& client)
 {
+	_memory.govern(client);
+
 	Client::WeakPtr weak(client);
 	client->authenticated.connect([=](bithorde::Client&, const std::string& peerName){
 		if (Client::Ptr client = weak.lock()) {
@@ -174,10 +257,19 @@ void Server::clientConnected(const bithorded::Client::Ptr& client)
 		}
 	});
 
+	client->availabilitySummary.connect([=](bithorde::Client& c, const bithorde::AvailabilitySummary& summary){
+		_router.onAvailabilitySummary(c.peerName(), summary);
+	});
+
 	auto mut = client;
 	client->disconnected.connect([=]() mutable {
 		if (mut) {
 			BOOST_LOG_SEV(serverLog, info) << "Disconnected: " << mut->peerName();
+			if (mut->stats && isFriend(mut->peerName())) {
+				auto& traffic = _closedTraffic[mut->peerName()];
+				traffic.sent += mut->stats->outgoingBytes.value();
+				traffic.received += mut->stats->incomingBytes.value();
+			}
 			_router.onDisconnected(mut);
 			mut.reset();
 		}
@@ -197,6 +289,19 @@ const bithorded::Config::Client& Server::getClientConfig(const string& name)
 	return null_client;
 }
 
+uint16_t Server::readWeight(const string& name) const
+{
+	for (auto iter = _cfg.friends.begin(); iter != _cfg.friends.end(); iter++) {
+		if (name == iter->name)
+			return iter->weight ? iter->weight : _cfg.friendWeight;
+	}
+	for (auto iter = _cfg.clients.begin(); iter != _cfg.clients.end(); iter++) {
+		if (name == iter->name)
+			return iter->weight ? iter->weight : _cfg.clientWeight;
+	}
+	return 0;
+}
+
 UpstreamRequestBinding::Ptr Server::asyncLinkAsset(const boost::filesystem::path& filePath)
 {
 	for (auto iter=_assetStores.begin(); iter != _assetStores.end(); iter++) {
@@ -219,6 +324,16 @@ UpstreamRequestBinding::Ptr Server::asyncFindAsset(const bithorde::BindRead& req
 		return _router.findAsset(req);
 }
 
+std::vector<bithorde::Id> Server::localTigerIds() const
+{
+	auto res = _cache.tigerIds();
+	for (auto iter=_assetStores.begin(); iter != _assetStores.end(); iter++) {
+		auto storeIds = (*iter)->tigerIds();
+		res.insert(res.end(), storeIds.begin(), storeIds.end());
+	}
+	return res;
+}
+
 UpstreamRequestBinding::Ptr Server::prepareUpload(uint64_t size)
 {
 	UpstreamRequestBinding::Ptr res;
@@ -29,12 +29,18 @@
 
 #include "../cache/manager.hpp"
 #include "../http_server/server.hpp"
+#include "../lib/fairqueue.hpp"
+#include "../lib/loopmonitor.hpp"
 #include "../lib/management.hpp"
+#include "../lib/metrics.hpp"
 #include "../lib/grandcentraldispatch.hpp"
 #include "../router/router.hpp"
 #include "../source/store.hpp"
 #include "bithorde.pb.h"
 #include "client.hpp"
+#include "gateway.hpp"
+#include "limits.hpp"
+#include "memory.hpp"
 
 namespace bithorded {
 
@@ -55,32 +61,74 @@ class Server : public GrandCentralDispatch, public management::Directory
 {
 	Config &_cfg;
 	TimerService::Ptr _timerSvc;
+	LoopMonitor _loopMonitor;
 
 	boost::asio::ip::tcp::acceptor _tcpListener;
 	boost::asio::local::stream_protocol::acceptor _localListener;
 
 	ConnectionList _connections;
+	struct PeerTraffic {
+		uint64_t sent, received;
+	};
+	std::map<std::string, PeerTraffic> _closedTraffic; // Bytes moved over closed connections to friends
+	MemoryGovernor _memory;
+	FairQueue _readQueue;
+	BandwidthLimits _limits;
 
 	std::vector< std::unique_ptr<bithorded::source::Store> > _assetStores;
 	router::Router _router;
 	cache::CacheManager _cache;
+
+	metrics::Exporter _metricsExporter;
+	metrics::TraceExporter _traceExporter;
+	metrics::Collector _peerSentBytes, _peerReceivedBytes, _peerSendQueue;
+	metrics::Collector _dispatchQueued, _dispatchStolen;
+
 	std::unique_ptr<http::server::server> _httpInterface;
+	std::unique_ptr<Gateway> _gateway;
 public:
 	Server(boost::asio::io_context& ioCtx, Config& cfg);
 
 	std::string name() { return _cfg.nodeName; }
+	const Config& config() const { return _cfg; }
+	TimerService& timerService() { return *_timerSvc; }
 	const Config::Client& getClientConfig(const std::string& name);
 
+	/**
+	 * Weight of a configured friend or client, from its own config or its class. 0 if not configured.
+	 */
+	uint16_t readWeight(const std::string& name) const;
+
+	/**
+	 * Admits Read-requests from all clients, in proportion to their weights.
+	 */
+	FairQueue& readQueue() { return _readQueue; }
+
+	BandwidthLimits& limits() { return _limits; }
+
 	UpstreamRequestBinding::Ptr asyncLinkAsset(const boost::filesystem::path& filePath);
 	UpstreamRequestBinding::Ptr asyncFindAsset(const bithorde::BindRead& req);
 	UpstreamRequestBinding::Ptr prepareUpload(uint64_t size);
 
+	/**
+	 * The tigerIds of all assets in sources and cache.
+	 */
+	std::vector<bithorde::Id> localTigerIds() const;
+
 	void hookup( const std::shared_ptr< boost::asio::ip::tcp::socket >& socket, const Config::Client& client);
 
 	virtual void inspect(management::InfoList& target) const;
 private:
 	void clientConnected(const bithorded::Client::Ptr& client);
 
+	bool isFriend(const std::string& name) const;
+
+	/**
+	 * One sample per connected peer, summing /value/ over all connections to it. For counters,
+	 * /closed/ adds what connections to friends moved before closing, so totals never go down.
+	 */
+	void collectPeers(const std::string& name, metrics::SampleList& samples, std::function<double(const bithorde::ConnectionStats&)> value, uint64_t PeerTraffic::* closed) const;
+
 	void waitForTCPConnection();
 	void waitForLocalConnection();
 };
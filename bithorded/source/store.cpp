@@ -22,6 +22,7 @@
 
 #include <bithorded/lib/grandcentraldispatch.hpp>
 #include <bithorded/lib/log.hpp>
+#include <bithorded/lib/loopmonitor.hpp>
 #include <bithorded/lib/relativepath.hpp>
 
 using namespace std;
@@ -72,6 +73,7 @@ const string& Store::label() const
 
 SourceAsset::Ptr Store::addAsset ( const boost::filesystem::path& file )
 {
+	LoopMonitor::Scope loop("source.link");
 	auto target = fs::canonical( file );
 	if (fs::path_is_in(target, _baseDir)) {
 		auto assetPath(AssetStore::newAsset());
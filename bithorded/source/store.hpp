@@ -44,6 +44,8 @@ public:
 
 	const std::string& label() const;
 
+	using AssetStore::tigerIds;
+
 	/**
 	 * Add an asset to the idx, creating a hash in the background. When hashing is done,
 	 * the status of the asset will be updated to reflect it.
@@ -19,8 +19,10 @@
 #include "hashstore.hpp"
 
 #include "../lib/grandcentraldispatch.hpp"
+#include "../lib/metrics.hpp"
 #include "../lib/rounding.hpp"
 #include <lib/buffer.hpp>
+#include <lib/trace.h>
 
 #include <boost/filesystem.hpp>
 #include <boost/shared_array.hpp>
@@ -48,17 +50,24 @@ StoredAsset::StoredAsset( GrandCentralDispatch& gcd, const string& id, const Has
 
 void StoredAsset::asyncRead(uint64_t offset, size_t size, uint32_t timeout, bithorded::IAsset::ReadCallback cb)
 {
-	auto buf = std::make_shared<bithorde::MemoryBuffer>(size);
 	auto dataSize = _data->size();
 	BOOST_ASSERT(offset < dataSize);
 	auto clamped_size = std::min(size, static_cast<size_t>(dataSize-offset));
-	auto read = _data->read(offset, clamped_size, **buf);
-	if (read > 0) {
+	bithorde::trace::Span disk(bithorde::trace::Context::current());
+	auto data = _data;
+	auto job = [=]() -> bithorde::IBuffer::Ptr {
+		auto buf = std::make_shared<bithorde::MemoryBuffer>(clamped_size);
+		auto read = data->read(offset, clamped_size, **buf);
+		if (read <= 0)
+			return bithorde::NullBuffer::instance;
 		buf->trim(read);
+		return buf;
+	};
+	// Off the mainloop, ahead of writes and hashing. Dropped if the reader goes away meanwhile.
+	_gcd.submit(job, [=](const bithorde::IBuffer::Ptr& buf) {
+		disk.finish("disk");
 		cb(offset, buf);
-	} else {
-		cb(offset, bithorde::NullBuffer::instance);
-	}
+	}, GrandCentralDispatch::INTERACTIVE, CancelToken::current());
 }
 
 size_t StoredAsset::canRead(uint64_t offset, size_t size)
@@ -86,6 +95,22 @@ size_t StoredAsset::canRead(uint64_t offset, size_t size)
 	return res;
 }
 
+size_t StoredAsset::mapFile(uint64_t offset, size_t size, int& fd, uint64_t& fileOffset)
+{
+	fileOffset = offset;
+	fd = _data->fileDescriptor(fileOffset);
+	if (fd < 0)
+		return 0;
+	size_t res = 0;
+	while (res < size) {
+		auto available = canRead(offset + res, size - res);
+		if (!available)
+			break;
+		res += available;
+	}
+	return res;
+}
+
 bool StoredAsset::hasRootHash()
 {
 	auto root = _hashTree.getRoot();
@@ -128,7 +153,13 @@ void StoredAsset::updateStatus()
 	}
 }
 
+namespace {
+	metrics::Counter hashedBytes("bithorded_hashed_bytes_total", "Bytes of asset data hashed");
+	metrics::Histogram hashLatency("bithorded_hash_block_seconds", "Time to read and hash one leaf block");
+}
+
 boost::shared_array<byte> crunch_piece(IDataArray* file, uint64_t offset, size_t size) {
+	auto start = std::chrono::steady_clock::now();
 	byte BUF[size];
 	auto got = file->read(offset, size, BUF);
 	if (got != static_cast<ssize_t>(size)) {
@@ -137,6 +168,8 @@ boost::shared_array<byte> crunch_piece(IDataArray* file, uint64_t offset, size_t
 
 	auto res = boost::shared_array<byte>(new byte[Hasher::DigestSize]);
 	Hasher::Hasher::rootDigest(BUF, got, res.get());
+	hashedBytes += got;
+	hashLatency.recordSince(start);
 	return res;
 }
 
@@ -184,7 +217,7 @@ struct HashTail : public std::enable_shared_from_this<HashTail> {
 
 		offset += blockSize_;
 
-		gcd.submit(job_handler, result_handler);
+		gcd.submit(job_handler, result_handler, GrandCentralDispatch::HASH);
 	}
 
 	void add_piece(uint32_t offset, boost::shared_array<byte> leafDigest) {
@@ -58,6 +58,8 @@ public:
 	 */
 	virtual size_t canRead(uint64_t offset, size_t size);
 
+	virtual size_t mapFile(uint64_t offset, size_t size, int& fd, uint64_t& fileOffset);
+
 	/**
 	 * Is the root hash known yet?
 	 */
@@ -16,6 +16,7 @@
 
 #include "assetindex.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
@@ -97,24 +98,44 @@ double AssetIndexEntry::addScore(double amount) {
 
 void AssetIndex::inspect(management::InfoList& target) const
 {
-    std::multimap<double, AssetIndexEntry*> scoreMap;
+    const std::string prefix("urn:tree:tiger:");
+    std::vector<std::pair<double, const AssetIndexEntry*>> entries;
+    entries.reserve(_assetMap.size());
     for (auto& asset : _assetMap | boost::adaptors::map_values ) {
-        scoreMap.insert(std::pair<double, AssetIndexEntry*>(asset->score(), asset.get()));
+        if (target.filter.empty() || target.matches(prefix + asset->tigerId().base32()))
+            entries.emplace_back(asset->score(), asset.get());
     }
-    if (scoreMap.empty()) {
+    if (entries.empty()) {
         return;
     }
-    auto lowest = scoreMap.begin()->first;
-    for (auto& kv : scoreMap) {
-        auto asset = kv.second;
-        target.append("urn:tree:tiger:" + asset->tigerId().base32()) << std::fixed << std::setprecision(1) << (kv.first-lowest) << '\t' << asset->diskUsage() << '\t' << asset->fillPercent() << '%';
+    auto lowest = std::min_element(entries.begin(), entries.end())->first;
+
+    // Only the requested page needs sorting and formatting, the rest is just counted
+    size_t first, last;
+    target.window(entries.size(), first, last);
+    std::partial_sort(entries.begin(), entries.begin() + last, entries.end());
+    target.skip(first);
+    target.reserve(target.size() + (last - first));
+    for (auto entry = entries.begin() + first; entry != entries.begin() + last; entry++) {
+        auto asset = entry->second;
+        target.append(prefix + asset->tigerId().base32()) << std::fixed << std::setprecision(1) << (entry->first-lowest) << '\t' << asset->diskUsage() << '\t' << asset->fillPercent() << '%';
     }
+    target.skip(entries.size() - last);
 }
 
 size_t AssetIndex::assetCount() const {
     return _assetMap.size();
 }
 
+std::vector<bithorde::Id> AssetIndex::tigerIds() const {
+    std::vector<bithorde::Id> res;
+    res.reserve(_tigerMap.size());
+    for (auto& tigerId : _tigerMap | boost::adaptors::map_keys) {
+        res.push_back(tigerId);
+    }
+    return res;
+}
+
 void AssetIndex::addAsset(const std::string& assetId, const bithorde::Id& tigerId, uint64_t diskUsage, uint64_t diskAllocation, double score) {
     auto ptr = new AssetIndexEntry(assetId, tigerId, diskUsage, diskAllocation, score);
     auto& slot = _assetMap[assetId];
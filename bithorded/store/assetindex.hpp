@@ -21,6 +21,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "../../lib/hashes.h"
 
@@ -62,6 +63,9 @@ public:
 
     size_t assetCount() const;
 
+    /** Returns the tigerIds of all assets having one */
+    std::vector<bithorde::Id> tigerIds() const;
+
     void addAsset(const std::string& assetId, const bithorde::Id& tigerId, uint64_t diskUsage, uint64_t diskAllocation, double score);
 
     /** Returns the tigerId the asset had, if any. */
@@ -27,6 +27,7 @@
 #include <lib/hashes.h>
 #include <lib/random.h>
 #include <bithorded/lib/log.hpp>
+#include <bithorded/lib/loopmonitor.hpp>
 #include <bithorded/lib/management.hpp>
 #include <bithorded/lib/relativepath.hpp>
 
@@ -186,6 +187,7 @@ uint64_t AssetStore::removeAsset(const std::string& assetId) noexcept
 
 uint64_t AssetStore::removeAsset(const boost::filesystem::path& assetPath) noexcept
 {
+	LoopMonitor::Scope loop("store.removeAsset");
 	BOOST_LOG_SEV(bithorded::storeLog, info) << "removing asset " << assetPath.filename();
 	auto tigerId = _index.removeAsset(assetPath.filename().native());
 	if (!tigerId.empty()) {
@@ -205,6 +207,7 @@ void AssetStore::unlink(const fs::path& linkPath) noexcept
 
 void AssetStore::loadIndex()
 {
+	LoopMonitor::Scope loop("store.loadIndex");
 	boost::system::error_code ec;
 	fs::directory_iterator enddir;
 	uint64_t size_cleared = 0;
@@ -259,6 +262,11 @@ void AssetStore::loadIndex()
 	BOOST_LOG_SEV(bithorded::storeLog, info) << "Scan finished. " << _index.assetCount() << " assets, using " << (_index.totalDiskUsage()/1048576) << "MB. " << (size_cleared/1048576) << "MB cleared.";
 }
 
+std::vector<bithorde::Id> AssetStore::tigerIds() const
+{
+	return _index.tigerIds();
+}
+
 IAsset::Ptr AssetStore::openAsset(const bithorde::BindRead& req)
 {
 	auto tigerId = findBithordeId(req.ids(), bithorde::HashType::TREE_TIGER);
@@ -68,6 +68,11 @@ public:
 	 */
 	uint64_t assetDiskAllocated(const boost::filesystem::path& path) const;
 
+	/**
+	 * Returns the tigerIds of all assets in the store
+	 */
+	std::vector<bithorde::Id> tigerIds() const;
+
 	uint64_t removeAsset(const std::string& assetId) noexcept;
 	uint64_t removeAsset(const boost::filesystem::path& assetPath) noexcept;
 protected:
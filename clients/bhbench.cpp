@@ -0,0 +1,435 @@
+#include "bhbench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include <lib/buffer.hpp>
+
+#include "buildconf.hpp"
+
+namespace asio = boost::asio;
+namespace po = boost::program_options;
+using namespace std;
+
+using namespace bithorde;
+
+const static auto TICK = chrono::seconds(1);
+const static auto BIND_RETRY_DELAY = chrono::milliseconds(100);
+
+asio::io_context ioCtx;
+
+static double toMiB(double bytes) {
+	return bytes / (1024*1024);
+}
+
+static double toSeconds(Clock::duration d) {
+	return chrono::duration_cast< chrono::duration<double> >(d).count();
+}
+
+LatencyLog::LatencyLog() :
+	_sorted(true)
+{}
+
+void LatencyLog::record(Clock::duration latency)
+{
+	auto us = chrono::duration_cast<chrono::microseconds>(latency).count();
+	_samples.push_back(std::min<int64_t>(us, UINT32_MAX));
+	_sorted = false;
+}
+
+size_t LatencyLog::count() const
+{
+	return _samples.size();
+}
+
+double LatencyLog::percentile(double p)
+{
+	if (_samples.empty())
+		return 0;
+	if (!_sorted) {
+		std::sort(_samples.begin(), _samples.end());
+		_sorted = true;
+	}
+	size_t idx = std::min<size_t>(p * _samples.size(), _samples.size()-1);
+	return _samples[idx] / 1000.0;
+}
+
+BenchStream::BenchStream(BHBench& bench, const Client::Pointer& client, size_t idx) :
+	_bench(bench),
+	_client(client),
+	_idx(idx),
+	_retryTimer(ioCtx),
+	_nextOffset(0),
+	_readsSinceBind(0),
+	_ready(false)
+{}
+
+void BenchStream::start()
+{
+	bind();
+}
+
+void BenchStream::bind()
+{
+	if (!_bench.running())
+		return;
+	_ready = false;
+	_inFlight.clear();
+
+	auto asset = new ReadAsset(_client, _bench.pickAsset(_idx));
+	_asset.reset(asset);
+	_asset->statusUpdate.connect([=](const bithorde::AssetStatus& status) {
+		this->onStatusUpdate(asset, status);
+	});
+	_asset->dataArrived.connect([=](uint64_t offset, const std::shared_ptr<bithorde::IBuffer>& data, int tag) {
+		this->onDataChunk(asset, offset, data, tag);
+	});
+
+	_bindStarted = Clock::now();
+	if (!_client->bind(*_asset, _bench.optTimeoutMs)) {
+		_bench.bindFailures++;
+		rebind(BIND_RETRY_DELAY);
+	}
+}
+
+void BenchStream::rebind(Clock::duration delay)
+{
+	// Deferred, since we are normally inside a signal from the asset about to be replaced
+	_ready = false;
+	_retryTimer.expires_after(delay);
+	_retryTimer.async_wait([=](const boost::system::error_code& ec) {
+		if (!ec)
+			this->bind();
+	});
+}
+
+void BenchStream::onStatusUpdate(ReadAsset* asset, const AssetStatus& status)
+{
+	if (asset != _asset.get())
+		return;
+	if (status.status() == bithorde::SUCCESS && status.size() > 0) {
+		if (!_ready) {
+			_bench.bindLatency.record(Clock::now() - _bindStarted);
+			_ready = true;
+			_readsSinceBind = 0;
+			_nextOffset = 0;
+			fill();
+		}
+	} else {
+		_bench.bindFailures++;
+		rebind(BIND_RETRY_DELAY);
+	}
+}
+
+void BenchStream::onDataChunk(ReadAsset* asset, uint64_t offset, const std::shared_ptr<IBuffer>& data, int tag)
+{
+	if (asset != _asset.get())
+		return;
+	auto req = _inFlight.find(offset);
+	if (req == _inFlight.end())
+		return;
+	auto latency = Clock::now() - req->second;
+	_inFlight.erase(req);
+
+	if (data->size()) {
+		_bench.bytesRead += data->size();
+		_bench.readLatency.record(latency);
+	} else {
+		_bench.readFailures++;
+	}
+	fill();
+}
+
+void BenchStream::fill()
+{
+	auto rebindEvery = _bench.optRebindEvery;
+	while (_ready && _bench.running() && _inFlight.size() < _bench.optPipeline &&
+		(!rebindEvery || _readsSinceBind < rebindEvery)) {
+		auto offset = _bench.pickOffset(_asset->size(), _nextOffset);
+		// ReadAsset answers all reads of an offset with the first response, so never duplicate one
+		if (_inFlight.count(offset))
+			break;
+		if (_asset->aSyncRead(offset, _bench.optBlockSize, _bench.optTimeoutMs) < 0)
+			return;
+		_inFlight[offset] = Clock::now();
+		_readsSinceBind++;
+	}
+	if (_ready && rebindEvery && _readsSinceBind >= rebindEvery && _inFlight.empty())
+		rebind(Clock::duration::zero());
+}
+
+// Indexed by BHBench::Pattern
+const static char* PATTERN_NAMES[] = { "sequential", "random", "zipf", "churn" };
+
+static BHBench::Pattern parsePattern(const string& name)
+{
+	for (size_t i=0; i < sizeof(PATTERN_NAMES)/sizeof(*PATTERN_NAMES); i++) {
+		if (name == PATTERN_NAMES[i])
+			return static_cast<BHBench::Pattern>(i);
+	}
+	throw string("ERROR: Unknown pattern '") + name + "'";
+}
+
+BHBench::BHBench(po::variables_map& args) :
+	optMyName(args["name"].as<string>()),
+	optConnectUrl(args["url"].as<string>()),
+	optQuiet(args.count("quiet")),
+	optClients(args["clients"].as<uint32_t>()),
+	optStreams(args["streams"].as<uint32_t>()),
+	optPipeline(args["pipeline"].as<uint32_t>()),
+	optBlockSize(args["block-size"].as<uint32_t>()),
+	optDuration(args["duration"].as<uint32_t>()),
+	optTimeoutMs(args["timeout"].as<int32_t>()),
+	optZipfExponent(args["zipf-exponent"].as<double>()),
+	optPattern(parsePattern(args["pattern"].as<string>())),
+	bytesRead(0),
+	readFailures(0),
+	bindFailures(0),
+	_rng(args["seed"].as<uint32_t>()),
+	_ticker(ioCtx),
+	_lastBytesRead(0),
+	_lastReads(0),
+	_res(0)
+{
+	if (args.count("rebind-every")) {
+		optRebindEvery = args["rebind-every"].as<uint32_t>();
+	} else switch (optPattern) {
+		case ZIPF: optRebindEvery = 64; break;
+		case CHURN: optRebindEvery = 1; break;
+		default: optRebindEvery = 0; break;
+	}
+	if (!optClients || !optStreams || !optPipeline || !optBlockSize)
+		throw string("ERROR: clients, streams, pipeline and block-size must be positive");
+}
+
+bool BHBench::queueAsset(const string& _uri)
+{
+	MagnetURI uri;
+	if (!uri.parse(_uri)) {
+		cerr << "ERROR: Only magnet-links supported, not '" << _uri << "'" << endl;
+		return false;
+	}
+
+	auto ids = uri.toIdList();
+	if (ids.size()) {
+		_assets.push_back(ids);
+		return true;
+	} else {
+		cerr << "ERROR: No hash-Identifiers in '" << _uri << "'" << endl;
+		return false;
+	}
+}
+
+int BHBench::main(const vector<string>& args)
+{
+	for (auto iter = args.begin(); iter != args.end(); iter++) {
+		if (!queueAsset(*iter))
+			return 1;
+	}
+
+	// Popularity falls off as 1/rank^s, in the order assets were given
+	double sum = 0;
+	for (size_t rank=1; rank <= _assets.size(); rank++) {
+		sum += 1.0 / pow(rank, optZipfExponent);
+		_zipfCdf.push_back(sum);
+	}
+	for (auto& p : _zipfCdf)
+		p /= sum;
+
+	_started = Clock::now();
+	_deadline = _started + chrono::seconds(optDuration);
+
+	for (uint32_t i=0; i < optClients; i++) {
+		auto client = Client::create(ioCtx, optMyName + "-" + to_string(i));
+		client->authenticated.connect([=](bithorde::Client& c, const std::string& peerName) {
+			this->onAuthenticated(c, peerName);
+		});
+		client->disconnected.connect([=]() {
+			if (this->running()) {
+				cerr << "ERROR: Client " << i << " disconnected" << endl;
+				_res = 1;
+				ioCtx.stop();
+			}
+		});
+		_clients.push_back(client);
+		client->connect(optConnectUrl);
+	}
+
+	_ticker.expires_after(TICK);
+	_ticker.async_wait([=](const boost::system::error_code& ec) {
+		if (!ec)
+			this->onTick();
+	});
+
+	ioCtx.run();
+
+	report();
+	return _res;
+}
+
+bool BHBench::running() const
+{
+	return Clock::now() < _deadline;
+}
+
+const bithorde::Ids& BHBench::pickAsset(size_t streamIdx)
+{
+	switch (optPattern) {
+	case ZIPF: {
+		uniform_real_distribution<double> dist(0.0, 1.0);
+		auto pos = lower_bound(_zipfCdf.begin(), _zipfCdf.end(), dist(_rng));
+		return _assets[min<size_t>(pos - _zipfCdf.begin(), _assets.size()-1)];
+	}
+	case CHURN: {
+		uniform_int_distribution<size_t> dist(0, _assets.size()-1);
+		return _assets[dist(_rng)];
+	}
+	default:
+		return _assets[streamIdx % _assets.size()];
+	}
+}
+
+uint64_t BHBench::pickOffset(uint64_t size, uint64_t& nextOffset)
+{
+	if (optPattern == SEQUENTIAL) {
+		if (nextOffset >= size)
+			nextOffset = 0;
+		auto res = nextOffset;
+		nextOffset += optBlockSize;
+		return res;
+	} else {
+		uint64_t blocks = (size + optBlockSize - 1) / optBlockSize;
+		uniform_int_distribution<uint64_t> dist(0, blocks-1);
+		return dist(_rng) * optBlockSize;
+	}
+}
+
+void BHBench::onAuthenticated(bithorde::Client& c, const string& peerName)
+{
+	if (peerName.empty()) {
+		cerr << "ERROR: Failed authentication" << endl;
+		_res = 1;
+		ioCtx.stop();
+		return;
+	}
+	for (auto iter = _clients.begin(); iter != _clients.end(); iter++) {
+		if (iter->get() != &c)
+			continue;
+		size_t clientIdx = iter - _clients.begin();
+		for (uint32_t s=0; s < optStreams; s++) {
+			_streams.emplace_back(new BenchStream(*this, *iter, clientIdx*optStreams + s));
+			_streams.back()->start();
+		}
+	}
+}
+
+void BHBench::onTick()
+{
+	if (!optQuiet) {
+		auto reads = readLatency.count();
+		cerr << fixed << setprecision(1)
+			<< "t=" << toSeconds(Clock::now() - _started) << "s: "
+			<< (reads - _lastReads) << " reads/s, "
+			<< toMiB(bytesRead - _lastBytesRead) << " MiB/s, "
+			<< readFailures << " failed reads, " << bindFailures << " failed binds" << endl;
+		_lastReads = reads;
+		_lastBytesRead = bytesRead;
+	}
+
+	if (running()) {
+		_ticker.expires_after(TICK);
+		_ticker.async_wait([=](const boost::system::error_code& ec) {
+			if (!ec)
+				this->onTick();
+		});
+	} else {
+		ioCtx.stop();
+	}
+}
+
+void BHBench::report()
+{
+	auto elapsed = toSeconds(min(Clock::now(), _deadline) - _started);
+	auto reads = readLatency.count();
+	cout << fixed << setprecision(2)
+		<< "pattern:      " << PATTERN_NAMES[optPattern] << " over " << _assets.size() << " assets, "
+			<< optClients << " clients x " << optStreams << " streams x " << optPipeline << " pipelined reads of " << optBlockSize << " bytes" << endl
+		<< "elapsed:      " << elapsed << " s" << endl
+		<< "reads:        " << reads << " (" << readFailures << " failed)" << endl
+		<< "throughput:   " << toMiB(bytesRead) / elapsed << " MiB/s, " << reads / elapsed << " reads/s" << endl
+		<< "read latency: p50=" << readLatency.percentile(0.5)
+			<< " p90=" << readLatency.percentile(0.9)
+			<< " p99=" << readLatency.percentile(0.99)
+			<< " p99.9=" << readLatency.percentile(0.999)
+			<< " max=" << readLatency.percentile(1.0) << " ms" << endl
+		<< "binds:        " << bindLatency.count() << " (" << bindFailures << " failed)" << endl
+		<< "bind latency: p50=" << bindLatency.percentile(0.5)
+			<< " p99=" << bindLatency.percentile(0.99)
+			<< " max=" << bindLatency.percentile(1.0) << " ms" << endl;
+}
+
+int main(int argc, char *argv[]) {
+	po::options_description desc("Supported options");
+	desc.add_options()
+		("help,h",
+			"Show help")
+		("version,v",
+			"Show version")
+		("name,n", po::value< string >()->default_value("bhbench"),
+			"Bithorde-name prefix of the simulated clients")
+		("quiet,q",
+			"Don't show progress every second")
+		("url,u", po::value< string >()->default_value(BITHORDED_DEFAULT_UNIX_SOCKET),
+			"Where to connect to bithorde. Either host:port, or /path/socket")
+		("clients,c", po::value< uint32_t >()->default_value(1),
+			"Number of simulated clients, each with its own connection")
+		("streams,s", po::value< uint32_t >()->default_value(1),
+			"Number of concurrently bound assets per client")
+		("pipeline,p", po::value< uint32_t >()->default_value(4),
+			"Number of reads kept in flight per stream")
+		("block-size,b", po::value< uint32_t >()->default_value(64*1024),
+			"Size of each read")
+		("duration,t", po::value< uint32_t >()->default_value(10),
+			"Seconds to run")
+		("pattern", po::value< string >()->default_value("sequential"),
+			"Read-pattern; sequential, random, zipf (random reads, assets picked by Zipfian popularity) or churn (uniform assets, rebinding after every read)")
+		("rebind-every", po::value< uint32_t >(),
+			"Rebind to another asset after this many reads, 0 for never. Defaults to 64 for zipf, 1 for churn and 0 otherwise")
+		("zipf-exponent", po::value< double >()->default_value(1.0),
+			"Skew of the zipf-pattern popularity")
+		("timeout", po::value< int32_t >()->default_value(10000),
+			"Timeout in ms for binds and reads")
+		("seed", po::value< uint32_t >()->default_value(1),
+			"Seed for the random patterns")
+		("magnet-url", po::value< vector<string> >(), "magnet url(s) of the assets to read, in falling popularity")
+	;
+	po::positional_options_description p;
+	p.add("magnet-url", -1);
+
+	po::command_line_parser parser(argc, argv);
+	parser.options(desc).positional(p);
+
+	po::variables_map vm;
+	po::store(parser.run(), vm);
+	po::notify(vm);
+
+	if (vm.count("version"))
+		return bithorde::exit_version();
+
+	if (vm.count("help") || !vm.count("magnet-url")) {
+		cerr << desc << endl;
+		return 1;
+	}
+
+	int res = -1;
+	try {
+		BHBench app(vm);
+		res = app.main(vm["magnet-url"].as< vector<string> >());
+	} catch (std::string err) {
+		cerr << err << endl;
+	}
+	cerr.flush();
+	return res;
+}
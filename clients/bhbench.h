@@ -0,0 +1,122 @@
+#ifndef BHBENCH_H
+#define BHBENCH_H
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/program_options.hpp>
+
+#include "lib/bithorde.h"
+
+class BHBench;
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Latency-samples in microseconds, summarized as percentiles after the run.
+ */
+class LatencyLog {
+	std::vector<uint32_t> _samples;
+	bool _sorted;
+public:
+	LatencyLog();
+	void record(Clock::duration latency);
+	size_t count() const;
+
+	/** Latency in milliseconds at /p/ (0.0-1.0) of the samples */
+	double percentile(double p);
+};
+
+/**
+ * One simulated reader on a client. Binds an asset, keeps up to --pipeline reads in flight on it and
+ * optionally rebinds to another asset every --rebind-every reads.
+ */
+class BenchStream {
+	BHBench& _bench;
+	bithorde::Client::Pointer _client;
+	size_t _idx;
+	std::unique_ptr<bithorde::ReadAsset> _asset;
+	boost::asio::steady_timer _retryTimer;
+	std::unordered_map<uint64_t, Clock::time_point> _inFlight; // Request-time by offset
+	uint64_t _nextOffset;
+	uint32_t _readsSinceBind;
+	Clock::time_point _bindStarted;
+	bool _ready;
+public:
+	BenchStream(BHBench& bench, const bithorde::Client::Pointer& client, size_t idx);
+	void start();
+private:
+	void bind();
+	void rebind(Clock::duration delay);
+	void onStatusUpdate(bithorde::ReadAsset* asset, const bithorde::AssetStatus& status);
+	void onDataChunk(bithorde::ReadAsset* asset, uint64_t offset, const std::shared_ptr<bithorde::IBuffer>& data, int tag);
+	void fill();
+};
+
+class BHBench {
+public:
+	enum Pattern {
+		SEQUENTIAL,
+		RANDOM,
+		ZIPF,
+		CHURN,
+	};
+
+	// Options
+	std::string optMyName;
+	std::string optConnectUrl;
+	bool optQuiet;
+	uint32_t optClients;
+	uint32_t optStreams;
+	uint32_t optPipeline;
+	uint32_t optBlockSize;
+	uint32_t optDuration;
+	uint32_t optRebindEvery;
+	int32_t optTimeoutMs;
+	double optZipfExponent;
+	Pattern optPattern;
+
+	// Results
+	LatencyLog readLatency;
+	LatencyLog bindLatency;
+	uint64_t bytesRead;
+	uint64_t readFailures;
+	uint64_t bindFailures;
+
+	BHBench(boost::program_options::variables_map &map);
+	bool queueAsset(const std::string& uri);
+
+	int main(const std::vector<std::string>& args);
+
+	bool running() const;
+
+	/** Which asset the stream with /streamIdx/ should bind next, according to the pattern */
+	const bithorde::Ids& pickAsset(size_t streamIdx);
+
+	/** Next block-aligned offset to read from an asset of /size/, according to the pattern */
+	uint64_t pickOffset(uint64_t size, uint64_t& nextOffset);
+private:
+	void onAuthenticated(bithorde::Client& c, const std::string& peerName);
+	void onTick();
+	void report();
+
+	std::vector<bithorde::Ids> _assets;
+	std::vector<double> _zipfCdf;
+	std::mt19937_64 _rng;
+	std::vector<bithorde::Client::Pointer> _clients;
+	std::vector< std::unique_ptr<BenchStream> > _streams;
+	boost::asio::steady_timer _ticker;
+	Clock::time_point _started;
+	Clock::time_point _deadline;
+	uint64_t _lastBytesRead;
+	size_t _lastReads;
+	int _res;
+};
+
+#endif
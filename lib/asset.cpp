@@ -94,7 +94,7 @@ void Asset::handleMessage(const bithorde::AssetStatus & msg)
 ReadRequestContext::ReadRequestContext(ReadAsset* asset, uint64_t offset, size_t size, int32_t timeout) :
 	_asset(asset),
 	_client(asset->client()),
-	_timer(asset->ioCtx()),
+	_timer(*_client->timerService(), std::bind(&ReadRequestContext::timer_callback, this)),
 	_requested_at(ptime::microsec_clock::universal_time())
 {
 	set_handle(asset->handle());
@@ -110,11 +110,7 @@ ReadRequestContext::~ReadRequestContext() {
 
 void ReadRequestContext::armTimer(int32_t timeout)
 {
-	auto self = shared_from_this();
-	_timer.expires_from_now(boost::posix_time::millisec(timeout));
-	_timer.async_wait([=](const boost::system::error_code& ec){
-		self->timer_callback(ec);
-	});
+	_timer.arm(boost::posix_time::millisec(timeout));
 }
 
 void ReadRequestContext::cancel()
@@ -124,7 +120,13 @@ void ReadRequestContext::cancel()
 		_asset = NULL;
 		asset->dataArrived(offset(), NullBuffer::instance, reqid());
 	}
-	_timer.cancel();
+	_timer.clear();
+}
+
+void ReadRequestContext::detach()
+{
+	_asset = NULL;
+	_timer.clear();
 }
 
 void ReadRequestContext::callback(const std::shared_ptr< MessageContext<Read::Response> >& msgCtx)
@@ -143,17 +145,16 @@ void ReadRequestContext::callback(const std::shared_ptr< MessageContext<Read::Re
 	}
 }
 
-void ReadRequestContext::timer_callback(const boost::system::error_code& error)
+void ReadRequestContext::timer_callback()
 {
-	if (!error) {
-		// Timeout occurred
-		if (_asset) {
-			auto asset = _asset;
-			_asset = NULL;
-			asset->readResponseTime.post((ptime::microsec_clock::universal_time() - _requested_at).total_milliseconds());
-			asset->dataArrived(offset(), NullBuffer::instance, reqid());
-			asset->clearOffset(offset(), reqid());
-		}
+	// Timeout occurred. clearOffset() drops the asset's reference to us.
+	auto self = shared_from_this();
+	if (_asset) {
+		auto asset = _asset;
+		_asset = NULL;
+		asset->readResponseTime.post((ptime::microsec_clock::universal_time() - _requested_at).total_milliseconds());
+		asset->dataArrived(offset(), NullBuffer::instance, reqid());
+		asset->clearOffset(offset(), reqid());
 	}
 }
 
@@ -175,6 +176,20 @@ void ReadAsset::cancelRequests() {
 	_requestMap.clear();
 }
 
+void ReadAsset::cancelRequest(ReadAsset::off_t offset, uint32_t reqid)
+{
+	auto it = _requestMap.lower_bound(offset);
+	auto end = _requestMap.upper_bound(offset);
+	while (it != end) {
+		if (it->second->reqid() == reqid) {
+			it->second->detach();
+			_requestMap.erase(it);
+			return;
+		}
+		it++;
+	}
+}
+
 const bithorde::Ids& ReadAsset::requestIds() const
 {
 	return _requestIds;
@@ -14,6 +14,7 @@
 #include "bithorde.pb.h"
 #include "counter.h"
 #include "hashes.h"
+#include "timer.h"
 #include "types.h"
 
 namespace bithorde {
@@ -78,7 +79,7 @@ class ReadAsset;
 class ReadRequestContext : boost::noncopyable, public bithorde::Read_Request, public std::enable_shared_from_this<ReadRequestContext> {
 	ReadAsset* _asset;
 	Asset::ClientPointer _client;
-	boost::asio::deadline_timer _timer;
+	Timer _timer;
 	boost::posix_time::ptime _requested_at;
 public:
 	typedef std::shared_ptr<ReadRequestContext> Ptr;
@@ -87,8 +88,11 @@ public:
 
 	void armTimer(int32_t timeout);
 	void callback( const std::shared_ptr< bithorde::MessageContext< bithorde::Read::Response > >& msgCtx );
-	void timer_callback(const boost::system::error_code& error);
+	void timer_callback();
 	void cancel();
+
+	/** Like cancel(), but without notifying the asset */
+	void detach();
 };
 
 class ReadAsset : public Asset, boost::noncopyable
@@ -105,6 +109,11 @@ public:
 	virtual ~ReadAsset();
 	void cancelRequests();
 
+	/**
+	 * Silently drops a pending read, if still outstanding. A late response for it will be ignored.
+	 */
+	void cancelRequest(off_t offset, uint32_t reqid);
+
 	int aSyncRead(off_t offset, ssize_t size, int32_t timeout=10000);
 	const bithorde::Ids & requestIds() const;
 	const bithorde::Ids & confirmedIds() const;
@@ -52,6 +52,20 @@ size_t MemoryBuffer::size() const {
 	return _size;
 }
 
+SubBuffer::SubBuffer ( const IBuffer::Ptr& parent, size_t offset, size_t size )
+	: _parent(parent), _offset(offset), _size(size)
+{
+	BOOST_ASSERT(offset + size <= parent->size());
+}
+
+byte* SubBuffer::operator*() const {
+	return **_parent + _offset;
+}
+
+size_t SubBuffer::size() const {
+	return _size;
+}
+
 ReadResponseCtxBuffer::ReadResponseCtxBuffer ( const std::shared_ptr< MessageContext< Read_Response > > msgCtx )
 	: _msgCtx(msgCtx)
 {
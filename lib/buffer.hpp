@@ -51,6 +51,19 @@ public:
 	virtual size_t size() const;
 };
 
+/**
+ * A range within another buffer, keeping it alive.
+ */
+class SubBuffer : public IBuffer {
+	IBuffer::Ptr _parent;
+	size_t _offset;
+	size_t _size;
+public:
+	SubBuffer(const IBuffer::Ptr& parent, size_t offset, size_t size);
+	virtual byte* operator*() const;
+	virtual size_t size() const;
+};
+
 template <typename T>
 class MessageContext;
 class Read_Response;
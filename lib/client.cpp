@@ -2,6 +2,7 @@
 
 #include "keepalive.hpp"
 
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <boost/asio/placeholders.hpp>
 #include <boost/assert.hpp>
@@ -22,6 +23,7 @@
 
 const static int LOTS_OF_MILLISECONDS(2^30);
 const size_t MAX_BYTES_ALLOCATED(512*1024);
+const int MAX_BATCHED_BINDS(256);
 
 using namespace std;
 namespace asio = boost::asio;
@@ -100,13 +102,15 @@ void AssetBinding::onTimeout()
 
 Client::Client(asio::io_context& ioCtx, string myName) :
 	_ioCtx(ioCtx),
-	_timerSvc(new TimerService(ioCtx)),
+	_timerSvc(TimerService::forContext(ioCtx)),
 	_state(Connecting),
 	_myName(myName),
 	_handleAllocator(1),
 	_rpcIdAllocator(1),
 	_protoVersion(0),
 	_bytesAllocated(0),
+	_memoryThrottled(false),
+	_incomingPaused(false),
 	assetResponseTime(0.98, "ms")
 {
 }
@@ -136,6 +140,13 @@ void Client::setSecurity(const string& key, CipherType cipher)
 	_sendCipher.reset(new CipherConfig(cipher, secureRandomBytes(key.size())));
 }
 
+void Client::setSendLimits(const std::vector<TokenBucket::Ptr>& limits)
+{
+	_sendLimits = limits;
+	if (_connection)
+		_connection->setSendLimits(limits);
+}
+
 void Client::hookup(Connection::Pointer newConn)
 {
 	BOOST_ASSERT(!_connection);
@@ -146,6 +157,9 @@ void Client::hookup(Connection::Pointer newConn)
 
 	_rpcIdAllocator.reset();
 	_connection = newConn;
+	_connection->setSendLimits(_sendLimits);
+	if (_memoryBudget)
+		_connection->setMemoryBudget(_memoryBudget);
 
 	_connection->setCallback(std::bind(&Client::onIncomingMessage, this, std::placeholders::_1, std::placeholders::_2));
 	_writableConnection = _connection->writable.connect(writable);
@@ -223,6 +237,11 @@ const std::string& Client::peerName()
 	return _peerName;
 }
 
+uint8_t Client::protoVersion() const
+{
+	return _protoVersion;
+}
+
 const Client::AssetMap& Client::clientAssets() const
 {
 	return _assetMap;
@@ -236,20 +255,35 @@ bool Client::sendMessage(Connection::MessageType type, const google::protobuf::M
 		return false;
 }
 
+bool Client::sendCongested(size_t pending) const
+{
+	return _connection && _connection->congested(pending);
+}
+
 void Client::allocateBytes ( size_t bytes ) {
-	Client::WeakPtr self(shared_from_this());
-	_ioCtx.post(std::bind(boost::weak_fn(&Client::trackAllocation, self), bytes));
+	if (_memoryBudget)
+		_memoryBudget->charge(MemoryBudget::MESSAGES, bytes);
+	// Only bother the io-thread when crossing the limit, messages may be released from any thread
+	auto before = _bytesAllocated.fetch_add(bytes);
+	if ((before < MAX_BYTES_ALLOCATED) && (before + bytes >= MAX_BYTES_ALLOCATED)) {
+		Client::WeakPtr self(shared_from_this());
+		_ioCtx.post(std::bind(boost::weak_fn(&Client::updateListening, self)));
+	}
 }
 
 void Client::freeBytes ( size_t bytes ) {
-	Client::WeakPtr self(shared_from_this());
-	_ioCtx.post(std::bind(boost::weak_fn(&Client::trackAllocation, self), -bytes));
+	if (_memoryBudget)
+		_memoryBudget->charge(MemoryBudget::MESSAGES, -static_cast<int64_t>(bytes));
+	auto before = _bytesAllocated.fetch_sub(bytes);
+	if ((before >= MAX_BYTES_ALLOCATED) && (before - bytes < MAX_BYTES_ALLOCATED)) {
+		Client::WeakPtr self(shared_from_this());
+		_ioCtx.post(std::bind(boost::weak_fn(&Client::updateListening, self)));
+	}
 }
 
-void Client::trackAllocation ( ssize_t change ) {
-	_bytesAllocated += change;
+void Client::updateListening() {
 	if (_connection) {
-		_connection->setListening(_bytesAllocated < MAX_BYTES_ALLOCATED);
+		_connection->setListening((_bytesAllocated < MAX_BYTES_ALLOCATED) && !_memoryThrottled && !_incomingPaused);
 	}
 }
 
@@ -257,11 +291,38 @@ size_t Client::bytesAllocated() const {
 	return _bytesAllocated;
 }
 
+void Client::setMemoryBudget(const MemoryBudget::Ptr& budget) {
+	BOOST_ASSERT(!_memoryBudget);
+	_memoryBudget = budget;
+	_memoryBudget->charge(MemoryBudget::MESSAGES, _bytesAllocated);
+	if (_connection)
+		_connection->setMemoryBudget(budget);
+	_memoryBudget->add(shared_from_this());
+}
+
+size_t Client::memoryHeld() const {
+	return _bytesAllocated + (_connection ? _connection->memoryHeld() : 0);
+}
+
+void Client::setMemoryThrottled(bool throttled) {
+	_memoryThrottled = throttled;
+	updateListening();
+}
+
+bool Client::memoryThrottled() const {
+	return _memoryThrottled;
+}
+
+void Client::pauseIncoming(bool paused) {
+	_incomingPaused = paused;
+	updateListening();
+}
+
 void Client::sayHello() {
 	if (_state & SaidHello)
 		throw std::runtime_error("Already sent HandShake");
 	bithorde::HandShake h;
-	h.set_protoversion(2);
+	h.set_protoversion(3);
 	h.set_name(_myName);
 	_sentChallenge.clear();
 	if (_key.size()) {
@@ -272,32 +333,36 @@ void Client::sayHello() {
 	addStateFlag(SaidHello);
 }
 
-void Client::onIncomingMessage(Connection::MessageType type, const ::google::protobuf::Message& msg)
+void Client::onIncomingMessage(Connection::MessageType type, const Connection::MessagePtr& msg)
 {
 	if (_state == Authenticated) {
 		switch (type) {
 		case Connection::MessageType::BindRead:
-			return onMessage(std::make_shared< MessageContext<bithorde::BindRead> >(shared_from_this(), (bithorde::BindRead&) msg));
+			return onMessage(MessageContext<bithorde::BindRead>::create(shared_from_this(), std::static_pointer_cast<const bithorde::BindRead>(msg)));
 		case Connection::MessageType::AssetStatus:
-			return onMessage(std::make_shared< MessageContext<bithorde::AssetStatus> >(shared_from_this(), (bithorde::AssetStatus&) msg));
+			return onMessage(MessageContext<bithorde::AssetStatus>::create(shared_from_this(), std::static_pointer_cast<const bithorde::AssetStatus>(msg)));
 		case Connection::MessageType::ReadRequest:
-			return onMessage(std::make_shared< MessageContext<bithorde::Read::Request> >(shared_from_this(), (bithorde::Read::Request&) msg));
+			return onMessage(MessageContext<bithorde::Read::Request>::create(shared_from_this(), std::static_pointer_cast<const bithorde::Read::Request>(msg)));
 		case Connection::MessageType::ReadResponse:
-			return onMessage(std::make_shared< MessageContext<bithorde::Read::Response> >(shared_from_this(), (bithorde::Read::Response&) msg));
+			return onMessage(MessageContext<bithorde::Read::Response>::create(shared_from_this(), std::static_pointer_cast<const bithorde::Read::Response>(msg)));
 		case Connection::MessageType::BindWrite:
-			return onMessage(std::make_shared< MessageContext<bithorde::BindWrite> >(shared_from_this(), (bithorde::BindWrite&) msg));
+			return onMessage(MessageContext<bithorde::BindWrite>::create(shared_from_this(), std::static_pointer_cast<const bithorde::BindWrite>(msg)));
 		case Connection::MessageType::DataSegment:
-			return onMessage(std::make_shared< MessageContext<bithorde::DataSegment> >(shared_from_this(), (bithorde::DataSegment&) msg));
+			return onMessage(MessageContext<bithorde::DataSegment>::create(shared_from_this(), std::static_pointer_cast<const bithorde::DataSegment>(msg)));
 		case Connection::MessageType::Ping:
-			return onMessage(std::make_shared< MessageContext<bithorde::Ping> >(shared_from_this(), (bithorde::Ping&) msg));
+			return onMessage(MessageContext<bithorde::Ping>::create(shared_from_this(), std::static_pointer_cast<const bithorde::Ping>(msg)));
+		case Connection::MessageType::BindReadBatch:
+			return onMessage(MessageContext<bithorde::BindReadBatch>::create(shared_from_this(), std::static_pointer_cast<const bithorde::BindReadBatch>(msg)));
+		case Connection::MessageType::AvailabilitySummary:
+			return onMessage(MessageContext<bithorde::AvailabilitySummary>::create(shared_from_this(), std::static_pointer_cast<const bithorde::AvailabilitySummary>(msg)));
 		default: break;
 		}
 	} else {
 		switch (type) {
 		case Connection::MessageType::HandShake:
-			return onMessage(std::make_shared< MessageContext<bithorde::HandShake> >(shared_from_this(), (bithorde::HandShake&) msg));
+			return onMessage(MessageContext<bithorde::HandShake>::create(shared_from_this(), std::static_pointer_cast<const bithorde::HandShake>(msg)));
 		case Connection::MessageType::HandShakeConfirmed:
-			return onMessage(std::make_shared< MessageContext<bithorde::HandShakeConfirmed> >(shared_from_this(), (bithorde::HandShakeConfirmed&) msg));
+			return onMessage(MessageContext<bithorde::HandShakeConfirmed>::create(shared_from_this(), std::static_pointer_cast<const bithorde::HandShakeConfirmed>(msg)));
 		default: break;
 		}
 	}
@@ -314,7 +379,7 @@ void Client::onMessage( const std::shared_ptr< MessageContext< HandShake > >& ms
 	const auto& msg = msgCtx->message();
 	BOOST_ASSERT(_state & SaidHello);
 	if (msg.protoversion() >= 2) {
-		_protoVersion = 2;
+		_protoVersion = std::min<uint32_t>(msg.protoversion(), 3);
 	} else {
 		cerr << "Only Protocol-version 2 or higher supported" << endl;
 		return close();
@@ -373,12 +438,14 @@ void Client::setAuthenticated(const std::string peerName)
 			_connection->setEncryption(_sendCipher->type, _key, _sendCipher->iv);
 		if (_recvCipher)
 			_connection->setDecryption(_recvCipher->type, _key, _recvCipher->iv);
+		batchBinds();
 		for (auto iter = _assetMap.begin(); iter != _assetMap.end(); iter++) {
 			auto binding = iter->second;
 			BOOST_ASSERT(binding && binding->readAsset());
 			binding->setTimer(DEFAULT_ASSET_TIMEOUT);
 			informBound(*iter->second, DEFAULT_ASSET_TIMEOUT.total_milliseconds());
 		}
+		flushBinds();
 		_connection->setKeepalive(new Keepalive(*this));
 	}
 	authenticated(*this, peerName);
@@ -476,6 +543,16 @@ void Client::onMessage( const std::shared_ptr< MessageContext< Ping > >& msgCtx
 	}
 }
 
+void Client::onMessage( const std::shared_ptr< MessageContext< BindReadBatch > >& msgCtx ) {
+	const auto& binds = msgCtx->message().binds();
+	for (auto iter = binds.begin(); iter != binds.end(); iter++)
+		onMessage(MessageContext<bithorde::BindRead>::create(shared_from_this(), *iter));
+}
+
+void Client::onMessage( const std::shared_ptr< MessageContext< AvailabilitySummary > >& msgCtx ) {
+	availabilitySummary(*this, msgCtx->message());
+}
+
 bool Client::bind(ReadAsset &asset) {
 	return bind(asset, DEFAULT_ASSET_TIMEOUT.total_milliseconds());
 }
@@ -567,12 +644,68 @@ bool Client::informBound(const AssetBinding& asset, int timeout_ms)
 
 	if (auto readAsset = asset.readAsset()) {
 		msg.mutable_ids()->CopyFrom(readAsset->requestIds());
+		if (_bindBatch) {
+			auto expires = Message::in(timeout_ms);
+			if (!_bindBatch->binds_size() || expires < _bindBatchExpires)
+				_bindBatchExpires = expires;
+			_bindBatch->add_binds()->Swap(&msg);
+			if (_bindBatch->binds_size() >= MAX_BATCHED_BINDS) {
+				// A failed send is reported to each bind of the batch, this one included
+				flushBinds();
+				batchBinds();
+			}
+			return true;
+		}
 		return sendMessage(Connection::MessageType::BindRead, msg, Message::in(timeout_ms), false);
 	} else {
+		// The release must not overtake a bind of the handle still waiting in the batch
+		if (_bindBatch && batchedBind(asset._handle)) {
+			flushBinds();
+			batchBinds();
+		}
 		return sendMessage(Connection::MessageType::BindRead, msg, Message::NEVER, true);
 	}
 }
 
+bool Client::batchedBind(Asset::Handle handle) const
+{
+	const auto& binds = _bindBatch->binds();
+	for (auto iter = binds.begin(); iter != binds.end(); iter++) {
+		if (iter->handle() == handle)
+			return true;
+	}
+	return false;
+}
+
+void Client::batchBinds()
+{
+	if (_protoVersion >= 3 && !_bindBatch)
+		_bindBatch.reset(new bithorde::BindReadBatch());
+}
+
+bool Client::flushBinds()
+{
+	if (!_bindBatch)
+		return true;
+	std::unique_ptr<bithorde::BindReadBatch> batch(std::move(_bindBatch));
+	if (!batch->binds_size() || sendMessage(Connection::MessageType::BindReadBatch, *batch, _bindBatchExpires, false))
+		return true;
+
+	// Each bind in the batch was told it was sent. Fail them now, like the timeout of a bind the
+	// peer never answered, or they would wait for that timeout.
+	const auto& binds = batch->binds();
+	for (auto iter = binds.begin(); iter != binds.end(); iter++) {
+		auto binding = _assetMap.find(iter->handle());
+		if ((binding != _assetMap.end()) && binding->second->readAsset()) {
+			bithorde::AssetStatus msg;
+			msg.set_handle(iter->handle());
+			msg.set_status(bithorde::Status::ERROR);
+			binding->second->asset()->handleMessage(msg);
+		}
+	}
+	return false;
+}
+
 int Client::allocRPCRequest(Asset::Handle asset)
 {
 	int res = _rpcIdAllocator.allocate();
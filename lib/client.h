@@ -1,6 +1,7 @@
 #ifndef BITHORDE_CLIENT_H
 #define BITHORDE_CLIENT_H
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <string>
@@ -12,6 +13,7 @@
 #include "allocator.h"
 #include "asset.h"
 #include "connection.h"
+#include "messagepool.h"
 #include "timer.h"
 
 namespace bithorde {
@@ -61,7 +63,7 @@ class MessageContext;
 
 struct CipherConfig;
 class Client
-	: public std::enable_shared_from_this<Client>
+	: public std::enable_shared_from_this<Client>, public MemoryBudget::Consumer
 {
 public:
 	enum State {
@@ -97,7 +99,15 @@ private:
 	CachedAllocator<int> _rpcIdAllocator;
 
 	uint8_t _protoVersion;
-	size_t _bytesAllocated;
+	std::atomic<size_t> _bytesAllocated;
+	MemoryBudget::Ptr _memoryBudget;
+	bool _memoryThrottled;
+	bool _incomingPaused;
+
+	std::unique_ptr<bithorde::BindReadBatch> _bindBatch;
+	Message::Deadline _bindBatchExpires;
+
+	std::vector<TokenBucket::Ptr> _sendLimits;
 public:
 	typedef std::shared_ptr<Client> Pointer;
 	typedef std::weak_ptr<Client> WeakPtr;
@@ -112,6 +122,11 @@ public:
 
 	void setSecurity(const std::string& key, CipherType cipher);
 
+	/**
+	 * Bandwidth-limits for everything sent to this peer.
+	 */
+	void setSendLimits(const std::vector<TokenBucket::Ptr>& limits);
+
 	/**
 	 * Tries to parse spec either as HOST:PORT, or as /absolute/socket/path and connect to it.
 	 */
@@ -126,6 +141,7 @@ public:
 
 	bool isConnected();
 	const std::string& peerName();
+	uint8_t protoVersion() const;
 	const AssetMap& clientAssets() const;
 
 	bool bind(ReadAsset & asset);
@@ -136,10 +152,36 @@ public:
 
 	bool sendMessage(bithorde::Connection::MessageType type, const google::protobuf::Message& msg, const bithorde::Message::Deadline& expires=Message::NEVER, bool prioritized=false);
 
+	/**
+	 * Whether more data sent now would just queue up, on top of /pending/ bytes soon to be sent.
+	 * Signals /writable/ once drained.
+	 */
+	bool sendCongested(size_t pending = 0) const;
+
+	/**
+	 * Collect following BindReads into BindReadBatch-messages, until flushBinds(). Has no
+	 * effect if the peer does not support BindReadBatch.
+	 *
+	 * While batching, bind() succeeding only means the bind was added to the batch. If the batch
+	 * then fails to send, flushBinds() returns false, and each bound asset gets an ERROR status.
+	 * Releasing an asset sends any batch holding its bind first, to keep them in order.
+	 */
+	void batchBinds();
+	bool flushBinds();
+
 	void allocateBytes(size_t bytes);
 	void freeBytes(size_t bytes);
 	size_t bytesAllocated() const;
 
+	/**
+	 * Accounts received messages and the connection in /budget/, and stops reading from the peer
+	 * while the budget throttles this client. Set before connecting.
+	 */
+	void setMemoryBudget(const MemoryBudget::Ptr& budget);
+	virtual size_t memoryHeld() const;
+	virtual void setMemoryThrottled(bool throttled);
+	bool memoryThrottled() const;
+
 	/**
 	 * Signal to indicate authentication has been performed.
 	 * the second argument is the peerName. Empty peerName means authentication failed.
@@ -148,6 +190,11 @@ public:
 	boost::signals2::signal<void ()> writable;
 	boost::signals2::signal<void ()> disconnected;
 
+	/**
+	 * Signal for summaries of the assets available on the peer.
+	 */
+	boost::signals2::signal<void (Client&, const bithorde::AvailabilitySummary&)> availabilitySummary;
+
 	ConnectionStats::Ptr stats;
 	InertialValue assetResponseTime;
 
@@ -156,8 +203,14 @@ protected:
 
 	void sayHello();
 
+	/**
+	 * Stop reading messages from the peer, until unpaused. For when a subclass cannot keep up with
+	 * processing them.
+	 */
+	void pauseIncoming(bool paused);
+
 	virtual void onDisconnected();
-	void onIncomingMessage( bithorde::Connection::MessageType type, const google::protobuf::Message& msg );
+	void onIncomingMessage( bithorde::Connection::MessageType type, const bithorde::Connection::MessagePtr& msg );
 
 	virtual void onMessage(const std::shared_ptr< MessageContext<bithorde::HandShake> >& msgCtx);
 	virtual void onMessage(const std::shared_ptr< MessageContext<bithorde::BindRead> >& msgCtx);
@@ -168,18 +221,21 @@ protected:
 	virtual void onMessage(const std::shared_ptr< MessageContext<bithorde::DataSegment> >& msgCtx);
 	virtual void onMessage(const std::shared_ptr< MessageContext<bithorde::HandShakeConfirmed> >& msgCtx);
 	virtual void onMessage(const std::shared_ptr< MessageContext<bithorde::Ping> >& msgCtx);
+	virtual void onMessage(const std::shared_ptr< MessageContext<bithorde::AvailabilitySummary> >& msgCtx);
+	virtual void onMessage(const std::shared_ptr< MessageContext<bithorde::BindReadBatch> >& msgCtx);
 
 	virtual void addStateFlag(State s);
 	virtual void setAuthenticated(const std::string peerName);
 private:
 	bool release(Asset & a);
-	void trackAllocation(ssize_t change);
+	void updateListening();
 
 	boost::signals2::scoped_connection _messageConnection;
 	boost::signals2::scoped_connection _writableConnection;
 	boost::signals2::scoped_connection _disconnectedConnection;
 
 	bool informBound(const bithorde::AssetBinding& asset, int timeout_ms);
+	bool batchedBind(Asset::Handle handle) const;
 	int allocRPCRequest(Asset::Handle asset);
 	void releaseRPCRequest(int reqId);
 };
@@ -187,22 +243,40 @@ private:
 template <typename T>
 class MessageContext {
 	const Client::Pointer _client;
-	const T _msg;
+	const std::shared_ptr<const T> _msg;
+	const size_t _size;
 public:
 	typedef std::shared_ptr< MessageContext<T> > Ptr;
 
+	/**
+	 * References /msg/, normally a pooled message just parsed from the connection.
+	 */
+	MessageContext(const Client::Pointer& client, const std::shared_ptr<const T>& msg) :
+		_client ( client ), _msg(msg), _size(msg->ByteSize())
+	{
+		_client->allocateBytes(_size);
+	}
+
 	MessageContext(const Client::Pointer& client, const T& msg) :
-		_client ( client ), _msg(msg)
+		_client ( client ), _msg(copy(msg)), _size(msg.ByteSize())
 	{
-		_client->allocateBytes(_msg.ByteSize());
+		_client->allocateBytes(_size);
 	}
 
 	~MessageContext() {
-		_client->freeBytes(_msg.ByteSize());
+		_client->freeBytes(_size);
+	}
+
+	/**
+	 * Allocates the context from recycled memory.
+	 */
+	template <typename M>
+	static Ptr create(const Client::Pointer& client, const M& msg) {
+		return std::allocate_shared< MessageContext<T> >(RecyclingAllocator< MessageContext<T> >(), client, msg);
 	}
 
 	const T& message() const {
-		return _msg;
+		return *_msg;
 	}
 
 	const std::shared_ptr<Client>& client() const {
@@ -210,7 +284,13 @@ public:
 	}
 
 	operator T() {
-		return _msg;
+		return *_msg;
+	}
+private:
+	static std::shared_ptr<const T> copy(const T& msg) {
+		auto res = MessagePool<T>::instance().acquire();
+		res->CopyFrom(msg);
+		return res;
 	}
 };
 
@@ -1,6 +1,7 @@
 #include "connection.h"
 
 #include "keepalive.hpp"
+#include "messagepool.h"
 #include "weak_fn.hpp"
 
 #include <boost/asio.hpp>
@@ -26,6 +27,7 @@ const size_t MAX_ERRORS = 5;
 const size_t SEND_BUF = 1024*K;
 const size_t SEND_BUF_EMERGENCY = SEND_BUF + 256*K;
 const size_t SEND_BUF_LOW_WATER_MARK = SEND_BUF/4;
+const size_t SEND_BUF_CONGESTED = SEND_BUF/2;
 const size_t SEND_CHUNK_MS = 50;
 
 namespace asio = boost::asio;
@@ -115,7 +117,11 @@ public:
 
 	void trySend() {
 		_sendWaiting = 0;
-		auto queued = _sndQueue.dequeue(_stats->outgoingBitrateCurrent.value()/8, SEND_CHUNK_MS);
+		auto allowance = sendAllowance();
+		if (!allowance)
+			return;
+		auto queued = _sndQueue.dequeue(_stats->outgoingBitrateCurrent.value()/8, SEND_CHUNK_MS, allowance);
+		_stats->outgoingQueued = _sndQueue.size();
 		std::vector<boost::asio::const_buffer> buffers;
 		buffers.reserve(queued.size());
 		for (auto iter=queued.begin(); iter != queued.end(); iter++) {
@@ -126,6 +132,7 @@ public:
 			_sendWaiting += buf.size();
 		}
 		if (_sendWaiting) {
+			sendLimited(_sendWaiting);
 			auto self = shared_from_this();
 			boost::asio::async_write(*_socket, buffers,
 				[=](const boost::system::error_code& ec, std::size_t bytes_transferred) {
@@ -188,10 +195,10 @@ void MessageQueue::enqueue(const MessageQueue::MessagePtr& msg)
 	_queue.push_back(msg);
 }
 
-MessageQueue::MessageList MessageQueue::dequeue(size_t bytes_per_sec, ushort millis)
+MessageQueue::MessageList MessageQueue::dequeue(size_t bytes_per_sec, ushort millis, size_t max_bytes)
 {
 	bytes_per_sec = std::max(bytes_per_sec, 1*K);
-	int32_t wanted(std::max(((bytes_per_sec*millis)/1000), static_cast<size_t>(1)));
+	int32_t wanted(std::max(std::min((bytes_per_sec*millis)/1000, max_bytes), static_cast<size_t>(1)));
 	auto now = std::chrono::steady_clock::now();
 	MessageList res;
 	res.reserve(_size);
@@ -214,15 +221,16 @@ size_t MessageQueue::size() const
 }
 
 ConnectionStats::ConnectionStats(const TimerService::Ptr& ts) :
-	_ts(ts),
-	incomingMessagesCurrent(*_ts, "msgs/s", boost::posix_time::seconds(1), 0.2),
-	incomingBitrateCurrent(*_ts, "bit/s", boost::posix_time::seconds(1), 0.2),
-	outgoingMessagesCurrent(*_ts, "msgs/s", boost::posix_time::seconds(1), 0.2),
-	outgoingBitrateCurrent(*_ts, "bit/s", boost::posix_time::seconds(1), 0.2),
+	_aggregator(StatsAggregator::forService(ts)),
+	incomingMessagesCurrent(_aggregator, "msgs/s", 0.2),
+	incomingBitrateCurrent(_aggregator, "bit/s", 0.2),
+	outgoingMessagesCurrent(_aggregator, "msgs/s", 0.2),
+	outgoingBitrateCurrent(_aggregator, "bit/s", 0.2),
 	incomingMessages("msgs"),
 	incomingBytes("bytes"),
 	outgoingMessages("msgs"),
-	outgoingBytes("bytes")
+	outgoingBytes("bytes"),
+	outgoingQueued(0)
 {
 }
 
@@ -232,10 +240,22 @@ Connection::Connection(asio::io_context & ioCtx, const ConnectionStats::Ptr& sta
 	_listening(true),
 	_readWindow(NULL),
 	_sendWaiting(0),
-	_errors(0)
+	_errors(0),
+	_throttleTimer(ioCtx),
+	_throttled(false),
+	_chargedReceive(0),
+	_chargedSend(0)
 {
 }
 
+Connection::~Connection()
+{
+	if (_memoryBudget) {
+		_memoryBudget->charge(MemoryBudget::RECEIVE_BUFFERS, -static_cast<int64_t>(_chargedReceive));
+		_memoryBudget->charge(MemoryBudget::SEND_QUEUES, -static_cast<int64_t>(_chargedSend));
+	}
+}
+
 Connection::Pointer Connection::create(asio::io_context& ioCtx, const ConnectionStats::Ptr& stats, const asio::ip::tcp::endpoint& addr)  {
 	Pointer c(new ConnectionImpl<asio::ip::tcp>(ioCtx, stats, addr));
 	c->tryRead();
@@ -300,6 +320,10 @@ void Connection::onRead(const boost::system::error_code& err, size_t count)
 			res = dequeue<bithorde::HandShakeConfirmed>(HandShakeConfirmed, stream); msgs_processed++; break;
 		case Ping:
 			res = dequeue<bithorde::Ping>(Ping, stream); msgs_processed++; break;
+		case AvailabilitySummary:
+			res = dequeue<bithorde::AvailabilitySummary>(AvailabilitySummary, stream); msgs_processed++; break;
+		case BindReadBatch:
+			res = dequeue<bithorde::BindReadBatch>(BindReadBatch, stream); msgs_processed++; break;
 		default:
 			cerr << _logTag << ": BitHorde protocol warning: unknown message tag" << endl;
 			if (++_errors > MAX_ERRORS) {
@@ -318,13 +342,13 @@ void Connection::onRead(const boost::system::error_code& err, size_t count)
 	_rcvBuf.pop();
 
 	tryRead();
+	accountMemory();
 	return;
 }
 
 template <class T>
 bool Connection::dequeue(MessageType type, ::google::protobuf::io::CodedInputStream &stream) {
 	bool res;
-	T msg;
 
 	uint32_t length;
 	if (!stream.ReadVarint32(&length)) return false;
@@ -336,8 +360,10 @@ bool Connection::dequeue(MessageType type, ::google::protobuf::io::CodedInputStr
 
 	_stats->incomingMessages += 1;
 	_stats->incomingMessagesCurrent += 1;
+	// Parsed into a pooled message, which is handed on without copying
+	auto msg = MessagePool<T>::instance().acquire();
 	::google::protobuf::io::CodedInputStream::Limit limit = stream.PushLimit(length);
-	if ((res = msg.MergePartialFromCodedStream(&stream))) {
+	if ((res = msg->MergePartialFromCodedStream(&stream))) {
 		_rcvBuf.consume(_rcvBuf.left() - leftInBuffer);
 		_dispatch(type, msg);
 	}
@@ -377,6 +403,7 @@ bool Connection::sendMessage(Connection::MessageType type, const google::protobu
 	}
 
 	std::shared_ptr<Message> buf(new Message(expires));
+	buf->trace = trace::Span(trace::Context::current());
 	// Encode
 	{
 		::google::protobuf::io::StringOutputStream of(&buf->buf);
@@ -386,6 +413,7 @@ bool Connection::sendMessage(Connection::MessageType type, const google::protobu
 		BOOST_VERIFY( msg.SerializeToCodedStream(&stream) );
 	}
 	_sndQueue.enqueue(buf);
+	_stats->outgoingQueued = _sndQueue.size();
 
 	_stats->outgoingMessages += 1;
 	_stats->outgoingMessagesCurrent += 1;
@@ -393,9 +421,16 @@ bool Connection::sendMessage(Connection::MessageType type, const google::protobu
 	// Push out at once unless _queued;
 	if (_sendWaiting == 0)
 		trySend();
+	accountMemory();
 	return true;
 }
 
+bool Connection::congested(size_t pending) const
+{
+	auto queued = _sndQueue.size();
+	return (queued >= SEND_BUF_CONGESTED) || (queued + pending > SEND_BUF);
+}
+
 void Connection::setListening ( bool listening ) {
 	if (_listening == listening )
 		return;
@@ -406,6 +441,77 @@ void Connection::setListening ( bool listening ) {
 	}
 }
 
+void Connection::setSendLimits(const std::vector<TokenBucket::Ptr>& limits)
+{
+	_sendLimits = limits;
+}
+
+void Connection::setMemoryBudget(const MemoryBudget::Ptr& budget)
+{
+	_memoryBudget = budget;
+	accountMemory();
+}
+
+size_t Connection::memoryHeld() const
+{
+	return _sndQueue.size() + _sendWaiting;
+}
+
+void Connection::accountMemory()
+{
+	if (!_memoryBudget)
+		return;
+	auto send = _sndQueue.size() + _sendWaiting;
+	if (_rcvBuf.capacity != _chargedReceive) {
+		_memoryBudget->charge(MemoryBudget::RECEIVE_BUFFERS, static_cast<int64_t>(_rcvBuf.capacity) - static_cast<int64_t>(_chargedReceive));
+		_chargedReceive = _rcvBuf.capacity;
+	}
+	if (send != _chargedSend) {
+		_memoryBudget->charge(MemoryBudget::SEND_QUEUES, static_cast<int64_t>(send) - static_cast<int64_t>(_chargedSend));
+		_chargedSend = send;
+	}
+}
+
+size_t Connection::sendAllowance()
+{
+	if (_throttled)
+		return 0;
+	auto now = TokenBucket::Clock::now();
+	size_t res = SIZE_MAX;
+	TokenBucket::Clock::duration delay(TokenBucket::Clock::duration::zero());
+	for (auto iter = _sendLimits.begin(); iter != _sendLimits.end(); iter++) {
+		auto& limit = **iter;
+		if (!limit.rate())
+			continue;
+		auto tokens = limit.tokens(now);
+		if (tokens > 0)
+			res = std::min(res, static_cast<size_t>(tokens));
+		else
+			delay = std::max(delay, limit.delay(now));
+	}
+	if (delay == TokenBucket::Clock::duration::zero())
+		return res;
+
+	_throttled = true;
+	std::weak_ptr<Connection> weakSelf(shared_from_this());
+	_throttleTimer.expires_after(delay);
+	_throttleTimer.async_wait([=](const boost::system::error_code& ec) {
+		if (auto self = weakSelf.lock()) {
+			self->_throttled = false;
+			if (!ec && !self->_sendWaiting)
+				self->trySend();
+		}
+	});
+	return 0;
+}
+
+void Connection::sendLimited(size_t bytes)
+{
+	auto now = TokenBucket::Clock::now();
+	for (auto iter = _sendLimits.begin(); iter != _sendLimits.end(); iter++)
+		(*iter)->take(bytes, now);
+}
+
 void Connection::onWritten(const boost::system::error_code& err, size_t written, const MessageQueue::MessageList& queued) {
 	size_t queued_bytes(0);
 	for (auto iter=queued.begin(); iter != queued.end(); iter++) {
@@ -414,7 +520,10 @@ void Connection::onWritten(const boost::system::error_code& err, size_t written,
 	if ((!err) && (written == queued_bytes) && (written>0)) {
 		_stats->outgoingBitrateCurrent += written*8;
 		_stats->outgoingBytes += written;
+		for (auto iter=queued.begin(); iter != queued.end(); iter++)
+			(*iter)->trace.finish("send");
 		trySend();
+		accountMemory();
 		if (_sndQueue.size() < SEND_BUF_LOW_WATER_MARK)
 			writable();
 	} else {
@@ -5,6 +5,7 @@
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/signals2.hpp>
 #include <chrono>
 #include <functional>
@@ -13,7 +14,10 @@
 
 #include "bithorde.pb.h"
 #include "counter.h"
+#include "memorybudget.h"
 #include "timer.h"
+#include "tokenbucket.h"
+#include "trace.h"
 #include "types.h"
 
 namespace bithorde {
@@ -29,6 +33,7 @@ struct Message {
 	Message(Deadline expires);
 	std::string buf; // TODO: test if ostringstream faster
 	std::chrono::steady_clock::time_point expires;
+	trace::Span trace; // From enqueue until written
 };
 
 class MessageQueue {
@@ -49,14 +54,14 @@ public:
 	void enqueue(const MessagePtr& msg);
 
 	/**
-	 * Note: relinquishes ownership of the messages
+	 * Note: relinquishes ownership of the messages. At most around max_bytes is dequeued.
 	 */
-	MessageList dequeue(std::size_t bytes_per_sec, ushort millis);
+	MessageList dequeue(std::size_t bytes_per_sec, ushort millis, std::size_t max_bytes=SIZE_MAX);
 	std::size_t size() const;
 };
 
 class ConnectionStats {
-	TimerService::Ptr _ts;
+	StatsAggregator::Ptr _aggregator;
 public:
 	typedef std::shared_ptr<ConnectionStats> Ptr;
 
@@ -64,6 +69,7 @@ public:
 	LazyCounter outgoingMessagesCurrent, outgoingBitrateCurrent;
 	Counter incomingMessages, incomingBytes;
 	Counter outgoingMessages, outgoingBytes;
+	std::size_t outgoingQueued; // Bytes waiting in the send queue
 
 	ConnectionStats(const TimerService::Ptr& ts);
 };
@@ -82,10 +88,13 @@ public:
 		DataSegment = 8,
 		HandShakeConfirmed = 9,
 		Ping = 10,
+		AvailabilitySummary = 11,
+		BindReadBatch = 12,
 	};
 
 	typedef std::shared_ptr<Connection> Pointer;
-	typedef std::function<void(MessageType, const ::google::protobuf::Message&)> Callback;
+	typedef std::shared_ptr< ::google::protobuf::Message > MessagePtr;
+	typedef std::function<void(MessageType, const MessagePtr&)> Callback;
 
 	static Pointer create(boost::asio::io_context& ioCtx, const bithorde::ConnectionStats::Ptr& stats, const boost::asio::ip::tcp::endpoint& addr);
 	static Pointer create(boost::asio::io_context& ioCtx, const bithorde::ConnectionStats::Ptr& stats, const std::shared_ptr< boost::asio::ip::tcp::socket >& socket);
@@ -106,13 +115,37 @@ public:
 
 	bool sendMessage(MessageType type, const ::google::protobuf::Message & msg, const Message::Deadline& expires, bool prioritized);
 
+	/**
+	 * The send-queue has filled up enough that producers should hold back until /writable/, or
+	 * would overflow with /pending/ bytes already on their way to it.
+	 */
+	bool congested(size_t pending = 0) const;
+
 	void setListening(bool listening);
 
+	/**
+	 * Outgoing data is held back while any of /limits/ are out of tokens.
+	 */
+	void setSendLimits(const std::vector<TokenBucket::Ptr>& limits);
+
+	/**
+	 * Accounts the receive-buffer and send-queue in /budget/, for the life of the connection.
+	 */
+	void setMemoryBudget(const MemoryBudget::Ptr& budget);
+
+	/**
+	 * Bytes held in the send-queue. The receive-buffer is left out, since it is not given back
+	 * however long the connection is throttled.
+	 */
+	size_t memoryHeld() const;
+
 	virtual void close() = 0;
 
 	void onRead(const boost::system::error_code& err, size_t count);
 	void onWritten(const boost::system::error_code& err, std::size_t written, const MessageQueue::MessageList& queued);
 
+	virtual ~Connection();
+
 protected:
 	Connection(boost::asio::io_context& ioCtx, const bithorde::ConnectionStats::Ptr& stats);
 
@@ -120,6 +153,18 @@ protected:
 	virtual void tryRead() = 0;
 	virtual void decrypt(byte* buf, size_t size) = 0;
 
+	/**
+	 * How many bytes the send-limits allows right now. If none, trySend() is scheduled for when
+	 * they do.
+	 */
+	size_t sendAllowance();
+	void sendLimited(size_t bytes);
+
+	/**
+	 * Charges changes in memoryHeld() and the receive-buffer to the budget.
+	 */
+	void accountMemory();
+
 protected:
 	boost::asio::io_context& _ioCtx;
 	Callback _dispatch;
@@ -133,6 +178,13 @@ protected:
 	MessageQueue _sndQueue;
 	size_t _sendWaiting;
 	uint32_t _errors;
+
+	std::vector<TokenBucket::Ptr> _sendLimits;
+	boost::asio::steady_timer _throttleTimer;
+	bool _throttled;
+
+	MemoryBudget::Ptr _memoryBudget;
+	size_t _chargedReceive, _chargedSend;
 private:
 	template <class T> bool dequeue(MessageType type, ::google::protobuf::io::CodedInputStream &stream);
 };
@@ -16,10 +16,14 @@
 
 #include "counter.h"
 
+#include <algorithm>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <numeric>
 
-TypedValue::TypedValue(const std::string& unit)
-	: _value(0), unit(unit)
+TypedValue::TypedValue(const std::string& unit, uint64_t value)
+	: _value(value), unit(unit)
 {}
 
 uint64_t TypedValue::value() const
@@ -64,19 +68,149 @@ uint64_t InertialValue::post(uint64_t amount)
 	return _value = (amount * (1.0-_inertia)) + (_value * (_inertia));
 }
 
-LazyCounter::LazyCounter(TimerService& ts, const std::string& unit, const boost::posix_time::time_duration& granularity, float falloff)
-	: Counter(unit), _timer(ts, std::bind(&LazyCounter::tick, this), granularity), _value(falloff, unit)
+const std::size_t StatsAggregator::DEFAULT_WINDOW;
+
+StatsAggregator::StatsAggregator(const TimerService::Ptr& ts, const boost::posix_time::time_duration& granularity, std::size_t window)
+	: _ts(ts), _timer(*ts, std::bind(&StatsAggregator::tick, this), granularity), _window(window), _pos(0)
+{
+}
+
+StatsAggregator::Ptr StatsAggregator::forService(const TimerService::Ptr& ts)
+{
+	static std::mutex lock;
+	static std::map<TimerService*, std::weak_ptr<StatsAggregator>> instances;
+	std::lock_guard<std::mutex> guard(lock);
+
+	auto& instance = instances[ts.get()];
+	auto res = instance.lock();
+	if (!res) {
+		res = std::make_shared<StatsAggregator>(ts, boost::posix_time::seconds(1), DEFAULT_WINDOW);
+		instance = res;
+	}
+	for (auto iter = instances.begin(); iter != instances.end();) {
+		if (iter->second.expired())
+			iter = instances.erase(iter);
+		else
+			iter++;
+	}
+	return res;
+}
+
+std::size_t StatsAggregator::allocate(float falloff)
+{
+	std::size_t slot;
+	if (_free.empty()) {
+		slot = _slots.size();
+		_slots.push_back(Slot());
+		_history.resize(_history.size() + _window);
+	} else {
+		slot = _free.back();
+		_free.pop_back();
+	}
+	_slots[slot] = Slot{0, 0.0f, falloff};
+	return slot;
+}
+
+void StatsAggregator::release(std::size_t slot)
+{
+	_slots[slot] = Slot{0, 0.0f, 0.0f};
+	std::fill_n(_history.begin() + slot*_window, _window, 0);
+	_free.push_back(slot);
+}
+
+uint64_t StatsAggregator::average(std::size_t slot) const
+{
+	return _slots[slot].average;
+}
+
+uint64_t StatsAggregator::windowed(std::size_t slot) const
+{
+	auto begin = _history.begin() + slot*_window;
+	return std::accumulate(begin, begin + _window, uint64_t(0)) / _window;
+}
+
+uint64_t StatsAggregator::percentile(std::size_t slot, float percentile) const
+{
+	auto begin = _history.begin() + slot*_window;
+	std::vector<uint64_t> sorted(begin, begin + _window);
+	auto nth = sorted.begin() + std::min(static_cast<size_t>(sorted.size() * percentile), sorted.size() - 1);
+	std::nth_element(sorted.begin(), nth, sorted.end());
+	return *nth;
+}
+
+std::size_t StatsAggregator::size() const
+{
+	return _slots.size() - _free.size();
+}
+
+void StatsAggregator::tick()
+{
+	_pos = (_pos + 1) % _window;
+	auto history = _history.begin() + _pos;
+	for (auto& slot : _slots) {
+		auto amount = slot.pending;
+		slot.pending = 0;
+		slot.average = (amount * (1.0f - slot.falloff)) + (slot.average * slot.falloff);
+		*history = amount;
+		history += _window;
+	}
+}
+
+LazyCounter::LazyCounter(const StatsAggregator::Ptr& aggregator, const std::string& unit, float falloff)
+	: TypedValue(unit), _aggregator(aggregator), _slot(aggregator->allocate(falloff))
+{
+}
+
+LazyCounter::~LazyCounter()
 {
+	_aggregator->release(_slot);
 }
 
 uint64_t LazyCounter::value() const
 {
-	return _value.value();
+	return _aggregator->average(_slot);
+}
+
+TypedValue LazyCounter::windowed() const
+{
+	return TypedValue(unit, _aggregator->windowed(_slot));
+}
+
+TypedValue LazyCounter::percentile(float percentile) const
+{
+	return TypedValue(unit, _aggregator->percentile(_slot, percentile));
+}
+
+WindowedPercentile::WindowedPercentile(size_t window, float percentile, const std::string& unit)
+	: TypedValue(unit), _window(window), _next(0), _percentile(percentile), _value(0)
+{
+	_samples.reserve(window);
+	_sorted.reserve(window);
+}
+
+void WindowedPercentile::post(uint64_t sample)
+{
+	if (_samples.size() < _window) {
+		_samples.push_back(sample);
+	} else {
+		_samples[_next] = sample;
+		_next = (_next + 1) % _window;
+	}
+	// Read far more often than posted to, so select the percentile here, once per sample
+	_sorted.assign(_samples.begin(), _samples.end());
+	auto nth = _sorted.begin() + std::min(static_cast<size_t>(_sorted.size() * _percentile), _sorted.size() - 1);
+	std::nth_element(_sorted.begin(), nth, _sorted.end());
+	_value = *nth;
+}
+
+size_t WindowedPercentile::samples() const
+{
+	return _samples.size();
 }
 
-void LazyCounter::tick()
+uint64_t WindowedPercentile::value() const
 {
-	_value.post(reset());
+	return _value;
 }
 
 std::ostream& operator<<(std::ostream& tgt, const TypedValue& v)
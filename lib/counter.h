@@ -20,14 +20,16 @@
 
 #include "timer.h"
 
+#include <memory>
 #include <ostream>
+#include <vector>
 
 class TypedValue {
 protected:
 	uint64_t _value;
 public:
 	const std::string unit;
-	TypedValue(const std::string& unit);
+	TypedValue(const std::string& unit, uint64_t value=0);
 	virtual uint64_t value() const;
 	TypedValue autoScale() const;
 };
@@ -51,17 +53,92 @@ public:
 	uint64_t post(uint64_t amount);
 };
 
-class LazyCounter : public Counter
+/**
+ * Drives rate counters from one shared PeriodicTimer, instead of one timer
+ * per counter. Counter state lives in contiguous arrays, so each tick is a
+ * single pass over memory regardless of how many connections are idle.
+ *
+ * Besides a decaying average, the per-tick totals of the last /window/ ticks
+ * are kept, for windowed rates and percentiles.
+ */
+class StatsAggregator
 {
+	struct Slot {
+		uint64_t pending;
+		float average;
+		float falloff;
+	};
+	TimerService::Ptr _ts;
 	PeriodicTimer _timer;
-	InertialValue _value;
+	std::size_t _window;
+	std::size_t _pos;
+	std::vector<Slot> _slots;
+	std::vector<uint64_t> _history;
+	std::vector<std::size_t> _free;
 public:
-	LazyCounter(TimerService& ts, const std::string& unit, const boost::posix_time::time_duration& granularity, float falloff);
-	virtual uint64_t value() const;
-private:
+	typedef std::shared_ptr<StatsAggregator> Ptr;
+	static const std::size_t DEFAULT_WINDOW = 10;
+
+	StatsAggregator(const TimerService::Ptr& ts, const boost::posix_time::time_duration& granularity, std::size_t window);
+
+	/// The one-second aggregator shared by everything on ts.
+	static Ptr forService(const TimerService::Ptr& ts);
+
+	std::size_t allocate(float falloff);
+	void release(std::size_t slot);
+	void add(std::size_t slot, uint64_t amount) { _slots[slot].pending += amount; }
+
+	uint64_t average(std::size_t slot) const;
+	uint64_t windowed(std::size_t slot) const;
+	uint64_t percentile(std::size_t slot, float percentile) const;
+
+	/// Number of counters currently allocated
+	std::size_t size() const;
+
+	/// Close the current period. Normally driven by the timer.
 	void tick();
 };
 
+class LazyCounter : public TypedValue
+{
+	StatsAggregator::Ptr _aggregator;
+	std::size_t _slot;
+public:
+	LazyCounter(const StatsAggregator::Ptr& aggregator, const std::string& unit, float falloff);
+	LazyCounter(const LazyCounter&) = delete;
+	~LazyCounter();
+	LazyCounter& operator=(const LazyCounter&) = delete;
+
+	void operator+=(uint64_t amount) { _aggregator->add(_slot, amount); }
+
+	/// Decaying average per tick
+	virtual uint64_t value() const;
+
+	/// Mean per tick over the aggregator window
+	TypedValue windowed() const;
+
+	/// Percentile of the per-tick totals over the aggregator window
+	TypedValue percentile(float percentile) const;
+};
+
+/**
+ * Estimates a percentile over the last /window/ posted samples.
+ */
+class WindowedPercentile : public TypedValue
+{
+	std::vector<uint64_t> _samples;
+	std::vector<uint64_t> _sorted;
+	size_t _window;
+	size_t _next;
+	float _percentile;
+	uint64_t _value;
+public:
+	WindowedPercentile(size_t window, float percentile, const std::string& unit);
+	void post(uint64_t sample);
+	size_t samples() const;
+	virtual uint64_t value() const;
+};
+
 std::ostream& operator<<(std::ostream& tgt, const TypedValue& c);
 
 #endif // COUNTER_H
@@ -0,0 +1,167 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "memorybudget.h"
+
+#include <algorithm>
+
+MemoryBudget::MemoryBudget(boost::asio::io_context& ioCtx, size_t limit) :
+	_ioCtx(ioCtx),
+	_limit(limit),
+	_used(0),
+	_scheduled(false),
+	_throttledCount(0),
+	_throttleEvents(0)
+{
+	for (auto& pool : _pools)
+		pool = 0;
+}
+
+const char* MemoryBudget::poolName(Pool pool)
+{
+	switch (pool) {
+	case MESSAGES: return "messages";
+	case RECEIVE_BUFFERS: return "receiveBuffers";
+	case SEND_QUEUES: return "sendQueues";
+	default: return "unknown";
+	}
+}
+
+bool MemoryBudget::reclaimable(Pool pool)
+{
+	return pool != RECEIVE_BUFFERS;
+}
+
+size_t MemoryBudget::limit() const
+{
+	return _limit;
+}
+
+size_t MemoryBudget::lowWater() const
+{
+	return (_limit / 4) * 3;
+}
+
+size_t MemoryBudget::used() const
+{
+	return std::max<int64_t>(_used, 0);
+}
+
+size_t MemoryBudget::used(Pool pool) const
+{
+	return std::max<int64_t>(_pools[pool], 0);
+}
+
+size_t MemoryBudget::throttled() const
+{
+	return _throttledCount;
+}
+
+uint64_t MemoryBudget::throttleEvents() const
+{
+	return _throttleEvents;
+}
+
+void MemoryBudget::charge(Pool pool, int64_t bytes)
+{
+	_pools[pool] += bytes;
+	if (!reclaimable(pool))
+		return;
+	auto used = _used += bytes;
+	if (!_limit)
+		return;
+	if ((used > static_cast<int64_t>(_limit)) || (_throttledCount && (used <= static_cast<int64_t>(lowWater()))))
+		schedule();
+}
+
+void MemoryBudget::schedule()
+{
+	// At most one rebalance pending at a time
+	if (_scheduled.exchange(true))
+		return;
+	std::weak_ptr<MemoryBudget> weak(shared_from_this());
+	_ioCtx.post([weak]() {
+		if (auto self = weak.lock())
+			self->rebalance();
+	});
+}
+
+void MemoryBudget::add(const std::shared_ptr<Consumer>& consumer)
+{
+	_consumers.push_back(Entry{consumer, false});
+}
+
+void MemoryBudget::rebalance()
+{
+	_scheduled = false;
+	_consumers.erase(std::remove_if(_consumers.begin(), _consumers.end(), [this](const Entry& e) {
+		if (!e.consumer.expired())
+			return false;
+		if (e.throttled)
+			_throttledCount--;
+		return true;
+	}), _consumers.end());
+
+	auto used = this->used();
+	if (_limit && (used > _limit)) {
+		// Throttle the heaviest until what they hold would bring usage back under the low-water mark
+		size_t excess = used - lowWater();
+		size_t covered = 0;
+		std::vector< std::pair<size_t, Entry*> > candidates;
+		for (auto& entry : _consumers) {
+			auto consumer = entry.consumer.lock();
+			auto held = consumer ? consumer->memoryHeld() : 0;
+			if (entry.throttled)
+				covered += held;
+			else if (held)
+				candidates.emplace_back(held, &entry);
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const std::pair<size_t, Entry*>& a, const std::pair<size_t, Entry*>& b) {
+			return a.first > b.first;
+		});
+		for (auto iter = candidates.begin(); (iter != candidates.end()) && (covered < excess); iter++) {
+			auto consumer = iter->second->consumer.lock();
+			if (!consumer)
+				continue;
+			iter->second->throttled = true;
+			consumer->setMemoryThrottled(true);
+			covered += iter->first;
+			_throttledCount++;
+			_throttleEvents++;
+		}
+	} else if (!_limit || (used <= lowWater())) {
+		for (auto& entry : _consumers) {
+			if (entry.throttled) {
+				entry.throttled = false;
+				if (auto consumer = entry.consumer.lock())
+					consumer->setMemoryThrottled(false);
+			}
+		}
+		_throttledCount = 0;
+	}
+}
+
+std::ostream& operator<<(std::ostream& str, const MemoryBudget& b)
+{
+	str << (b.used() >> 20) << "MiB used";
+	if (b.limit())
+		str << " of " << (b.limit() >> 20) << "MiB";
+	else
+		str << ", unlimited";
+	if (b.throttled())
+		str << ", " << b.throttled() << " throttled";
+	return str;
+}
@@ -0,0 +1,113 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+
+/**
+ * Process-wide limit on memory held by connections; received messages not yet released and send
+ * queues. Usage may be charged from any thread. When over the limit, the heaviest consumers are
+ * throttled until usage falls back under the low-water mark, 3/4 of the limit. A limit of 0
+ * means unlimited, only accounting.
+ *
+ * Receive buffers are only accounted. They stay allocated for the life of the connection, so
+ * throttling would not get any of it back.
+ */
+class MemoryBudget : public std::enable_shared_from_this<MemoryBudget>
+{
+public:
+	typedef std::shared_ptr<MemoryBudget> Ptr;
+
+	enum Pool {
+		MESSAGES,
+		RECEIVE_BUFFERS,
+		SEND_QUEUES,
+		POOLS,
+	};
+	static const char* poolName(Pool pool);
+
+	/**
+	 * Whether throttling consumers frees memory in /pool/, and it thus counts against the limit.
+	 */
+	static bool reclaimable(Pool pool);
+
+	/**
+	 * Something holding memory, which can stop taking on more when told to.
+	 */
+	class Consumer {
+	public:
+		virtual ~Consumer() {}
+		virtual size_t memoryHeld() const = 0;
+		virtual void setMemoryThrottled(bool throttled) = 0;
+	};
+private:
+	boost::asio::io_context& _ioCtx;
+	size_t _limit;
+	std::array<std::atomic<int64_t>, POOLS> _pools;
+	std::atomic<int64_t> _used;
+	std::atomic<bool> _scheduled;
+	std::atomic<size_t> _throttledCount;
+	uint64_t _throttleEvents;
+
+	struct Entry {
+		std::weak_ptr<Consumer> consumer;
+		bool throttled;
+	};
+	std::vector<Entry> _consumers;
+
+	void schedule();
+public:
+	MemoryBudget(boost::asio::io_context& ioCtx, size_t limit);
+
+	size_t limit() const;
+	size_t lowWater() const;
+
+	/** Reclaimable memory in use, what the limit applies to */
+	size_t used() const;
+	size_t used(Pool pool) const;
+
+	/** Consumers currently throttled */
+	size_t throttled() const;
+
+	/** Times any consumer has been throttled */
+	uint64_t throttleEvents() const;
+
+	void charge(Pool pool, int64_t bytes);
+
+	/**
+	 * Register /consumer/ for throttling. Only weakly referenced.
+	 */
+	void add(const std::shared_ptr<Consumer>& consumer);
+
+	/**
+	 * Throttles or releases consumers according to usage. Normally scheduled on the io_context when
+	 * crossing the limits.
+	 */
+	void rebalance();
+};
+
+std::ostream& operator<<(std::ostream& str, const MemoryBudget& b);
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,188 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef BITHORDE_MESSAGEPOOL_H
+#define BITHORDE_MESSAGEPOOL_H
+
+#include <atomic>
+#include <boost/core/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <memory>
+#include <vector>
+
+namespace bithorde {
+
+/**
+ * Blocks and messages the pools have had to take from the heap, rather than reuse. For tests
+ * and benchmarks of allocation-free paths.
+ */
+inline std::atomic<std::size_t>& poolHeapAllocations() {
+	static std::atomic<std::size_t> count(0);
+	return count;
+}
+
+/**
+ * Thread-safe list of released blocks of /Size/ bytes, kept for reuse instead of returned to
+ * the heap.
+ */
+template <std::size_t Size>
+class FreeList : private boost::noncopyable {
+	static const std::size_t MAX_FREE = 1024;
+	std::vector<void*> _free;
+	boost::mutex _m;
+
+	FreeList() {
+		_free.reserve(MAX_FREE);
+	}
+public:
+	static FreeList& instance() {
+		// Leaked on purpose, blocks may be released during static destruction
+		static FreeList* instance = new FreeList();
+		return *instance;
+	}
+
+	void* pop() {
+		boost::lock_guard<boost::mutex> lock(_m);
+		if (_free.empty())
+			return NULL;
+		auto res = _free.back();
+		_free.pop_back();
+		return res;
+	}
+
+	bool push(void* block) {
+		boost::lock_guard<boost::mutex> lock(_m);
+		if (_free.size() >= MAX_FREE)
+			return false;
+		_free.push_back(block);
+		return true;
+	}
+};
+
+/**
+ * Allocator recycling single objects through a FreeList. Meant for std::allocate_shared of
+ * short-lived objects, such as MessageContexts.
+ */
+template <typename T>
+struct RecyclingAllocator {
+	typedef T value_type;
+
+	RecyclingAllocator() {}
+	template <typename U> RecyclingAllocator(const RecyclingAllocator<U>&) {}
+
+	T* allocate(std::size_t n) {
+		if (n == 1) {
+			if (auto block = FreeList<sizeof(T)>::instance().pop())
+				return static_cast<T*>(block);
+		}
+		poolHeapAllocations()++;
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, std::size_t n) {
+		if ((n == 1) && FreeList<sizeof(T)>::instance().push(p))
+			return;
+		::operator delete(p);
+	}
+};
+
+template <typename T, typename U>
+bool operator==(const RecyclingAllocator<T>&, const RecyclingAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const RecyclingAllocator<T>&, const RecyclingAllocator<U>&) { return false; }
+
+/**
+ * Pool of protobuf messages of type /T/. Released messages are Clear():ed and kept, so that
+ * parsing into them again reuses their already allocated fields and string buffers.
+ *
+ * Clear() keeps the capacity of string fields, and a message that once held a data-chunk keeps
+ * its buffer. Only a few such large messages are kept, since what they hold is not counted by
+ * any memory budget.
+ */
+template <typename T>
+class MessagePool : private boost::noncopyable {
+	static const std::size_t MAX_FREE = 256;
+	static const std::size_t MAX_FREE_LARGE = 16;
+	static const std::size_t LARGE_MESSAGE = 16*1024;
+	std::vector<T*> _free;
+	std::vector<T*> _freeLarge;
+	boost::mutex _m;
+	std::size_t _created;
+
+	MessagePool() : _created(0) {
+		_free.reserve(MAX_FREE);
+		_freeLarge.reserve(MAX_FREE_LARGE);
+	}
+
+	void release(T* msg) {
+		msg->Clear();
+		bool large = msg->SpaceUsedLong() > LARGE_MESSAGE;
+		{
+			boost::lock_guard<boost::mutex> lock(_m);
+			auto& free = large ? _freeLarge : _free;
+			if (free.size() < (large ? MAX_FREE_LARGE : MAX_FREE)) {
+				free.push_back(msg);
+				return;
+			}
+		}
+		delete msg;
+	}
+public:
+	typedef std::shared_ptr<T> Ptr;
+
+	static MessagePool& instance() {
+		// Leaked on purpose, messages may be released during static destruction
+		static MessagePool* instance = new MessagePool();
+		return *instance;
+	}
+
+	/**
+	 * An empty message, returned to the pool when the last reference goes away.
+	 */
+	Ptr acquire() {
+		T* msg = NULL;
+		{
+			boost::lock_guard<boost::mutex> lock(_m);
+			// Large first; whatever is parsed into them, their buffers are put to use again
+			auto& free = _freeLarge.empty() ? _free : _freeLarge;
+			if (!free.empty()) {
+				msg = free.back();
+				free.pop_back();
+			} else {
+				_created++;
+			}
+		}
+		if (!msg) {
+			poolHeapAllocations()++;
+			msg = new T();
+		}
+		return Ptr(msg, [](T* msg) { MessagePool::instance().release(msg); }, RecyclingAllocator<T>());
+	}
+
+	/**
+	 * How many messages the pool has ever had to create.
+	 */
+	std::size_t created() {
+		boost::lock_guard<boost::mutex> lock(_m);
+		return _created;
+	}
+};
+
+}
+
+#endif // BITHORDE_MESSAGEPOOL_H
@@ -17,68 +17,236 @@
 
 #include "timer.h"
 
+#include <boost/asio/execution_context.hpp>
+#include <algorithm>
+
+namespace ptime = boost::posix_time;
+
+namespace {
+	/// Keeps track of the TimerService for each io_context
+	class TimerRegistry : public boost::asio::execution_context::service {
+	public:
+		static boost::asio::execution_context::id id;
+		std::weak_ptr<TimerService> instance;
+
+		explicit TimerRegistry(boost::asio::execution_context& ctx)
+			: boost::asio::execution_context::service(ctx)
+		{}
+		virtual void shutdown() {}
+	};
+	boost::asio::execution_context::id TimerRegistry::id;
+}
+
 TimerService::TimerService(boost::asio::io_context& ioCtx)
-	: _timer(ioCtx)
+	: _timer(ioCtx),
+	  _epoch(ptime::microsec_clock::universal_time()),
+	  _now(_epoch),
+	  _current(0)
+{
+	std::fill(_count, _count+LEVELS, 0);
+	std::fill(_wheel0, _wheel0+(1 << L0_BITS), nullptr);
+	for (auto& level : _wheelN)
+		std::fill(level, level+(1 << LN_BITS), nullptr);
+}
+
+TimerService::Ptr TimerService::forContext(boost::asio::io_context& ioCtx)
+{
+	auto& registry = boost::asio::use_service<TimerRegistry>(static_cast<boost::asio::execution_context&>(ioCtx));
+	auto res = registry.instance.lock();
+	if (!res) {
+		res = std::make_shared<TimerService>(ioCtx);
+		registry.instance = res;
+	}
+	return res;
+}
+
+std::size_t TimerService::size() const
 {
+	std::size_t res = 0;
+	for (auto count : _count)
+		res += count;
+	return res;
 }
 
-void TimerService::arm(boost::posix_time::ptime deadline, Timer* t)
+TimerService::Tick TimerService::tickOf(const ptime::ptime& t, bool roundUp) const
 {
-	_timers.insert(std::pair<boost::posix_time::ptime,Timer*>(deadline, t));
+	auto us = (t - _epoch).total_microseconds();
+	if (us <= 0)
+		return 0;
+	return roundUp ? (us + 999) / 1000 : us / 1000;
+}
+
+int TimerService::shiftOf(int level)
+{
+	return level ? (L0_BITS + (level-1)*LN_BITS) : 0;
+}
+
+void TimerService::arm(ptime::ptime deadline, Timer* t)
+{
+	if (t->_head)
+		unlink(t);
+	if (!size()) {
+		// Nothing pending, the wheel may be arbitrarily far behind
+		_now = ptime::microsec_clock::universal_time();
+		_current = std::max(_current, tickOf(_now, false));
+	}
+	t->_deadline = deadline;
+	t->_expiry = tickOf(deadline, true);
+	insert(t);
 	enable();
 }
 
-void TimerService::clear(const Timer* t)
+void TimerService::clear(Timer* t)
+{
+	if (t->_head)
+		unlink(t);
+}
+
+void TimerService::insert(Timer* t)
 {
-	auto iter = _timers.begin();
-	while (iter != _timers.end()) {
-		auto current = iter++;
-		if (current->second == t)
-			_timers.erase(current);
+	auto expiry = std::max(t->_expiry, _current);
+	auto delta = expiry - _current;
+	Timer** head;
+	if (delta < (1 << L0_BITS)) {
+		t->_level = 0;
+		head = &_wheel0[expiry & ((1 << L0_BITS) - 1)];
+	} else {
+		int level = 1;
+		while (level < LEVELS-1 && delta >= (Tick(1) << (shiftOf(level) + LN_BITS)))
+			level++;
+		auto shift = shiftOf(level);
+		if (delta >= (Tick(1) << (shift + LN_BITS))) // Beyond the wheel, park in the last slot
+			expiry = _current + ((Tick((1 << LN_BITS) - 1)) << shift);
+		t->_level = level;
+		head = &_wheelN[level-1][(expiry >> shift) & ((1 << LN_BITS) - 1)];
+	}
+	t->_head = head;
+	t->_prev = nullptr;
+	t->_next = *head;
+	if (*head)
+		(*head)->_prev = t;
+	*head = t;
+	_count[t->_level]++;
+}
+
+void TimerService::unlink(Timer* t)
+{
+	if (t->_prev)
+		t->_prev->_next = t->_next;
+	else
+		*t->_head = t->_next;
+	if (t->_next)
+		t->_next->_prev = t->_prev;
+	t->_head = nullptr;
+	t->_prev = t->_next = nullptr;
+	_count[t->_level]--;
+}
+
+void TimerService::cascade(int level, std::size_t slot)
+{
+	auto& head = _wheelN[level-1][slot];
+	while (auto t = head) {
+		unlink(t);
+		insert(t);
+	}
+}
+
+void TimerService::advance(TimerService::Tick to)
+{
+	const Tick L0_MASK = (1 << L0_BITS) - 1;
+	while (_current <= to) {
+		if (!size()) {
+			_current = to + 1;
+			break;
+		}
+		auto tick = _current;
+		for (int level = 1; level < LEVELS; level++) {
+			auto shift = shiftOf(level);
+			if (tick & ((Tick(1) << shift) - 1))
+				break;
+			if (_count[level])
+				cascade(level, (tick >> shift) & ((1 << LN_BITS) - 1));
+		}
+		if (!_count[0]) {
+			// Nothing to fire before the next cascade
+			_current = std::min(to, tick | L0_MASK) + 1;
+			continue;
+		}
+
+		// Detach the slot, so callbacks may freely arm and clear timers
+		Timer* pending = _wheel0[tick & L0_MASK];
+		_wheel0[tick & L0_MASK] = nullptr;
+		for (auto t = pending; t; t = t->_next)
+			t->_head = &pending;
+		_current = tick + 1;
+
+		while (auto t = pending) {
+			unlink(t);
+			if (t->_expiry > tick)
+				insert(t); // Parked beyond the wheel
+			else
+				t->invoke(t->_deadline, _now);
+		}
 	}
 }
 
 void TimerService::enable()
 {
-	if (_timers.size() > 0) {
-		const auto& target_time = _timers.begin()->first;
-		if (target_time != _timer.expires_at()) {
-			auto self = shared_from_this();
-			_timer.expires_at(target_time);
-			_timer.async_wait([=](const boost::system::error_code& ec) {
-				self->invoke(ec);
-			});
+	if (!size())
+		return;
+	const Tick L0_SIZE = 1 << L0_BITS;
+	Tick next = _current + L0_SIZE;
+	if (_count[0]) {
+		for (Tick i = 0; i < L0_SIZE; i++) {
+			if (_wheel0[(_current + i) & (L0_SIZE - 1)]) {
+				next = _current + i;
+				break;
+			}
 		}
 	}
+	for (int level = 1; level < LEVELS; level++) {
+		if (!_count[level])
+			continue;
+		auto shift = shiftOf(level);
+		auto block = (_current + (Tick(1) << shift) - 1) >> shift;
+		for (Tick i = 0; i < (1 << LN_BITS); i++) {
+			if (_wheelN[level-1][(block + i) & ((1 << LN_BITS) - 1)]) {
+				next = std::min(next, (block + i) << shift);
+				break;
+			}
+		}
+	}
+
+	auto target_time = _epoch + ptime::milliseconds(next);
+	if (target_time != _scheduled) {
+		auto self = shared_from_this();
+		_scheduled = target_time;
+		_timer.expires_at(target_time);
+		_timer.async_wait([=](const boost::system::error_code& ec) {
+			self->invoke(ec);
+		});
+	}
 }
 
 void TimerService::invoke(boost::system::error_code ec)
 {
 	if (ec) return;
-	auto now(boost::posix_time::microsec_clock::universal_time());
-	auto iter = _timers.begin();
-	while (iter != _timers.end() && iter->first <= now) {
-		auto deadline = iter->first;
-		auto timer = iter->second;
-		_timers.erase(iter);
-		timer->invoke(deadline, now);
-		iter = _timers.begin();
-	}
+	_scheduled = ptime::not_a_date_time;
+	_now = ptime::microsec_clock::universal_time();
+	advance(tickOf(_now, false));
 	enable();
 }
 
 Timer::Timer(TimerService& ts, const Timer::Target& target)
-	: _ts(&ts), _target(target)
+	: _ts(&ts), _target(target), _expiry(0), _level(0), _head(nullptr), _prev(nullptr), _next(nullptr)
 {
 }
 
 Timer::Timer(const Timer& other) :
-	_ts(other._ts), _target(other._target)
+	_ts(other._ts), _target(other._target), _expiry(0), _level(0), _head(nullptr), _prev(nullptr), _next(nullptr)
 {
-	for (auto iter = _ts->_timers.cbegin(); iter != _ts->_timers.cend(); iter++) {
-		if (iter->second == &other)
-			_ts->arm(iter->first, this);
-	}
+	if (other.armed())
+		arm(other._deadline);
 }
 
 Timer::~Timer()
@@ -88,50 +256,49 @@ Timer::~Timer()
 
 Timer& Timer::operator=(const Timer& other)
 {
+	if (this == &other)
+		return *this;
 	clear();
 	_ts = other._ts;
 	_target = other._target;
-	for (auto iter = _ts->_timers.cbegin(); iter != _ts->_timers.cend(); iter++) {
-		if (iter->second == &other)
-			_ts->arm(iter->first, this);
-	}
+	if (other.armed())
+		arm(other._deadline);
 	return *this;
 }
 
 
-void Timer::arm(boost::posix_time::ptime deadline)
+void Timer::arm(ptime::ptime deadline)
 {
 	_ts->arm(deadline, this);
 }
 
-void Timer::arm(boost::posix_time::time_duration in)
+void Timer::arm(ptime::time_duration in)
 {
-	auto deadline = boost::posix_time::microsec_clock::universal_time() + in;
-	_ts->arm(deadline, this);
+	_ts->arm(ptime::microsec_clock::universal_time() + in, this);
 }
 
 void Timer::clear() {
 	_ts->clear(this);
 }
 
-void Timer::invoke(const boost::posix_time::ptime& scheduled_at, const boost::posix_time::ptime& now)
+void Timer::invoke(const ptime::ptime& scheduled_at, const ptime::ptime& now)
 {
 	_target(now);
 }
 
-PeriodicTimer::PeriodicTimer(TimerService& ts, const Timer::Target& target, boost::posix_time::time_duration interval)
+PeriodicTimer::PeriodicTimer(TimerService& ts, const Timer::Target& target, ptime::time_duration interval)
 	: Timer(ts, target), _interval(interval)
 {
 	arm(_interval);
 }
 
-void PeriodicTimer::rearm(boost::posix_time::time_duration interval) {
+void PeriodicTimer::rearm(ptime::time_duration interval) {
 	clear();
 	_interval = interval;
 	arm(_interval);
 }
 
-void PeriodicTimer::invoke(const boost::posix_time::ptime& scheduled_at, const boost::posix_time::ptime& now)
+void PeriodicTimer::invoke(const ptime::ptime& scheduled_at, const ptime::ptime& now)
 {
 	arm(scheduled_at+_interval);
 	Timer::invoke(scheduled_at, now);
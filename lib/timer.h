@@ -21,25 +21,66 @@
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/core/noncopyable.hpp>
 #include <functional>
-#include <map>
+#include <memory>
 
 class Timer;
 
+/**
+ * Hierarchical timing wheel with 1ms resolution. Arming and clearing a Timer
+ * is O(1), regardless of how many timers are pending. The whole wheel is
+ * driven by a single asio timer, which is only rescheduled when the next
+ * wake-up time changes.
+ *
+ * Level 0 holds the next 256 ticks, each higher level covers 64 times the
+ * range of the level below. Timers further out than the top level are parked
+ * in its last slot and re-inserted when it cascades.
+ */
 class TimerService : public std::enable_shared_from_this<TimerService> {
 friend class Timer;
-	std::multimap<boost::posix_time::ptime, Timer*> _timers;
+	static const int LEVELS = 5;
+	static const int L0_BITS = 8;
+	static const int LN_BITS = 6;
+	typedef int64_t Tick;
+
 	boost::asio::deadline_timer _timer;
+	boost::posix_time::ptime _epoch;
+	boost::posix_time::ptime _now;
+	boost::posix_time::ptime _scheduled;
+	Tick _current;
+	std::size_t _count[LEVELS];
+	Timer* _wheel0[1 << L0_BITS];
+	Timer* _wheelN[LEVELS-1][1 << LN_BITS];
 public:
 	typedef std::shared_ptr<TimerService> Ptr;
 	TimerService(boost::asio::io_context& ioCtx);
+
+	/// The TimerService shared by everything running on ioCtx.
+	static Ptr forContext(boost::asio::io_context& ioCtx);
+
+	/// Coarse clock, updated whenever the wheel advances or a timer is armed.
+	const boost::posix_time::ptime& now() const { return _now; }
+
+	/// Number of currently armed timers.
+	std::size_t size() const;
 protected:
 	void arm(boost::posix_time::ptime deadline, Timer* t);
-	void clear(const Timer* t);
+	void clear(Timer* t);
 private:
+	Tick tickOf(const boost::posix_time::ptime& t, bool roundUp) const;
+	static int shiftOf(int level);
+	void insert(Timer* t);
+	void unlink(Timer* t);
+	void cascade(int level, std::size_t slot);
+	void advance(Tick to);
 	void enable();
 	void invoke(boost::system::error_code ec);
 };
 
+/**
+ * A single-shot timer, firing target once per arm(). Arming an already armed
+ * timer moves its deadline, it is never queued more than once. Copies are
+ * armed at the same deadline as the original.
+ */
 class Timer : private boost::noncopyable
 {
 friend class TimerService;
@@ -48,6 +89,12 @@ public:
 private:
 	TimerService* _ts;
 	Target _target;
+	boost::posix_time::ptime _deadline;
+	TimerService::Tick _expiry;
+	int _level;
+	Timer** _head;
+	Timer* _prev;
+	Timer* _next;
 public:
 	Timer(TimerService& ts, const Target& target);
 
@@ -58,6 +105,7 @@ public:
 	void arm(boost::posix_time::ptime deadline);
 	void arm(boost::posix_time::time_duration in);
 	void clear();
+	bool armed() const { return _head != nullptr; }
 protected:
 	virtual void invoke(const boost::posix_time::ptime& scheduled_at, const boost::posix_time::ptime& now);
 };
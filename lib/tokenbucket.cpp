@@ -0,0 +1,89 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "tokenbucket.h"
+
+TokenBucket::TokenBucket(uint64_t rate, uint64_t burst, Clock::time_point now) :
+	_rate(rate),
+	_burst(burst),
+	_tokens(burst),
+	_lastRefill(now)
+{
+}
+
+void TokenBucket::refill(Clock::time_point now) const
+{
+	if (now <= _lastRefill)
+		return;
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - _lastRefill).count();
+	if (elapsed >= ((_burst - _tokens) * 1000000) / static_cast<int64_t>(_rate) + 1) {
+		_tokens = _burst;
+		_lastRefill = now;
+		return;
+	}
+	int64_t earned = (elapsed * _rate) / 1000000;
+	if (earned <= 0)
+		return; // Leave the fraction to accumulate
+	_tokens += earned;
+	_lastRefill += std::chrono::microseconds((earned * 1000000) / _rate);
+}
+
+uint64_t TokenBucket::rate() const
+{
+	return _rate;
+}
+
+int64_t TokenBucket::burst() const
+{
+	return _burst;
+}
+
+int64_t TokenBucket::tokens(Clock::time_point now) const
+{
+	if (_rate)
+		refill(now);
+	return _tokens;
+}
+
+bool TokenBucket::ready(Clock::time_point now) const
+{
+	return !_rate || tokens(now) > 0;
+}
+
+void TokenBucket::take(uint64_t bytes, Clock::time_point now)
+{
+	if (!_rate)
+		return;
+	refill(now);
+	_tokens -= bytes;
+}
+
+TokenBucket::Clock::duration TokenBucket::delay(Clock::time_point now) const
+{
+	auto available = tokens(now);
+	if (!_rate || available > 0)
+		return Clock::duration::zero();
+	return std::chrono::microseconds((((1 - available) * 1000000) + _rate - 1) / _rate);
+}
+
+std::ostream& operator<<(std::ostream& str, const TokenBucket& b)
+{
+	if (b.rate())
+		str << b.tokens() << '/' << b.burst() << " bytes, " << (b.rate()/1024) << "KiB/s";
+	else
+		str << "unlimited";
+	return str;
+}
@@ -0,0 +1,61 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef TOKENBUCKET_H
+#define TOKENBUCKET_H
+
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+
+/**
+ * Limits a flow of bytes to /rate/ per second, allowing bursts of up to /burst/ bytes. Bytes
+ * may be taken beyond what is available, the debt is then paid off before the bucket is
+ * ready again. A rate of 0 means unlimited.
+ */
+class TokenBucket
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef std::shared_ptr<TokenBucket> Ptr;
+private:
+	uint64_t _rate;
+	int64_t _burst;
+	mutable int64_t _tokens;
+	mutable Clock::time_point _lastRefill;
+
+	void refill(Clock::time_point now) const;
+public:
+	TokenBucket(uint64_t rate, uint64_t burst, Clock::time_point now=Clock::now());
+
+	uint64_t rate() const;
+	int64_t burst() const;
+	int64_t tokens(Clock::time_point now=Clock::now()) const;
+
+	bool ready(Clock::time_point now=Clock::now()) const;
+	void take(uint64_t bytes, Clock::time_point now=Clock::now());
+
+	/**
+	 * Time until ready() again.
+	 */
+	Clock::duration delay(Clock::time_point now=Clock::now()) const;
+};
+
+std::ostream& operator<<(std::ostream& str, const TokenBucket& b);
+
+#endif // TOKENBUCKET_H
@@ -0,0 +1,137 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "trace.h"
+
+using namespace bithorde::trace;
+
+namespace {
+	const Context NOT_SAMPLED;
+	thread_local const Context* currentContext = &NOT_SAMPLED;
+
+	int64_t micros(Clock::time_point t) {
+		return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+	}
+}
+
+const Context& Context::current()
+{
+	return *currentContext;
+}
+
+Scope::Scope(const Context& ctx) :
+	_previous(currentContext)
+{
+	currentContext = &ctx;
+}
+
+Scope::~Scope()
+{
+	currentContext = _previous;
+}
+
+Span::Span(const Context& ctx) :
+	_ctx(ctx)
+{
+	if (_ctx)
+		_start = Clock::now();
+}
+
+void Span::finish(const char* name) const
+{
+	if (_ctx)
+		Tracer::instance().record(_ctx, name, _start, Clock::now());
+}
+
+Tracer::Tracer() :
+	_capacity(0), _sampleEvery(0), _requests(0), _head(0)
+{
+}
+
+Tracer& Tracer::instance()
+{
+	static Tracer instance;
+	return instance;
+}
+
+void Tracer::configure(std::size_t capacity, uint32_t sampleEvery)
+{
+	if (!capacity)
+		sampleEvery = 0;
+	_slots.reset(capacity ? new Slot[capacity] : nullptr);
+	for (std::size_t i = 0; i < capacity; i++)
+		_slots[i].seq.store(0, std::memory_order_relaxed);
+	_capacity = capacity;
+	_head.store(0, std::memory_order_relaxed);
+	_sampleEvery.store(sampleEvery, std::memory_order_release);
+}
+
+Context Tracer::sample(uint64_t reqId, uint32_t handle)
+{
+	Context res;
+	auto every = _sampleEvery.load(std::memory_order_relaxed);
+	if (every) {
+		auto n = _requests.fetch_add(1, std::memory_order_relaxed);
+		if ((n % every) == 0) {
+			res.id = n + 1;
+			res.reqId = reqId;
+			res.handle = handle;
+		}
+	}
+	return res;
+}
+
+void Tracer::record(const Context& ctx, const char* name, Clock::time_point start, Clock::time_point end)
+{
+	if (!ctx || !_capacity)
+		return;
+	auto idx = _head.fetch_add(1, std::memory_order_relaxed);
+	auto& slot = _slots[idx % _capacity];
+	// Odd sequence while writing, so readers can detect torn spans
+	slot.seq.store(idx*2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.name = name;
+	slot.ctx = ctx;
+	slot.start = micros(start);
+	slot.duration = micros(end) - micros(start);
+	slot.seq.store(idx*2 + 2, std::memory_order_release);
+}
+
+std::ostream& Tracer::renderChromeTrace(std::ostream& output) const
+{
+	output << "{\"traceEvents\":[";
+	bool first = true;
+	auto head = _head.load(std::memory_order_acquire);
+	auto begin = (head > _capacity) ? head - _capacity : 0;
+	for (auto idx = begin; idx < head; idx++) {
+		auto& slot = _slots[idx % _capacity];
+		auto seq = slot.seq.load(std::memory_order_acquire);
+		const char* name = slot.name;
+		Context ctx = slot.ctx;
+		int64_t start = slot.start, duration = slot.duration;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if ((seq != idx*2 + 2) || (slot.seq.load(std::memory_order_relaxed) != seq))
+			continue;
+		if (!first)
+			output << ',';
+		first = false;
+		output << "{\"name\":\"" << name << "\",\"cat\":\"read\",\"ph\":\"X\",\"pid\":1"
+			<< ",\"tid\":" << ctx.id << ",\"ts\":" << start << ",\"dur\":" << duration
+			<< ",\"args\":{\"reqId\":" << ctx.reqId << ",\"handle\":" << ctx.handle << "}}";
+	}
+	output << "],\"displayTimeUnit\":\"ms\"}";
+	return output;
+}
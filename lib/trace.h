@@ -0,0 +1,119 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef BITHORDE_TRACE_H
+#define BITHORDE_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+
+namespace bithorde {
+
+namespace trace {
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Identifies one sampled request. A default-constructed Context is not sampled, and everything
+ * done with it is a no-op, so unsampled requests never touch the clock or the span buffer.
+ */
+struct Context {
+	uint64_t id;
+	uint64_t reqId;
+	uint32_t handle;
+
+	Context() : id(0), reqId(0), handle(0) {}
+	explicit operator bool() const { return id != 0; }
+
+	/**
+	 * The Context made current on this thread by the innermost Scope, for code that has no
+	 * access to the request itself.
+	 */
+	static const Context& current();
+};
+
+class Scope {
+	const Context* _previous;
+public:
+	explicit Scope(const Context& ctx);
+	Scope(const Scope&) = delete;
+	~Scope();
+};
+
+/**
+ * Timed from construction until finish(), if the Context is sampled.
+ */
+class Span {
+	Context _ctx;
+	Clock::time_point _start;
+public:
+	Span() {}
+	explicit Span(const Context& ctx);
+
+	const Context& context() const { return _ctx; }
+	void finish(const char* name) const;
+};
+
+/**
+ * Samples one in every /sampleEvery/ requests, and keeps the latest spans of sampled requests
+ * in a fixed ring-buffer. Recording is lock-free and safe from any thread. Readers may skip
+ * spans being overwritten while rendering.
+ */
+class Tracer {
+	struct Slot {
+		std::atomic<uint64_t> seq;
+		const char* name;
+		Context ctx;
+		int64_t start, duration;
+	};
+	std::unique_ptr<Slot[]> _slots;
+	std::size_t _capacity;
+	std::atomic<uint32_t> _sampleEvery;
+	std::atomic<uint64_t> _requests;
+	std::atomic<uint64_t> _head;
+public:
+	Tracer();
+	static Tracer& instance();
+
+	/**
+	 * Sets up the span buffer. sampleEvery=0 disables tracing. Not safe while recording.
+	 */
+	void configure(std::size_t capacity, uint32_t sampleEvery);
+	bool enabled() const { return _sampleEvery.load(std::memory_order_relaxed) != 0; }
+
+	/**
+	 * A sampled Context for the request, or an unsampled one if tracing is disabled or the
+	 * request was not picked.
+	 */
+	Context sample(uint64_t reqId, uint32_t handle);
+
+	void record(const Context& ctx, const char* name, Clock::time_point start, Clock::time_point end);
+
+	/// Number of spans ever recorded
+	uint64_t recorded() const { return _head.load(std::memory_order_relaxed); }
+
+	/**
+	 * Renders the buffered spans in the Chrome trace-event format, one row per request.
+	 */
+	std::ostream& renderChromeTrace(std::ostream& output) const;
+};
+
+}}
+
+#endif // BITHORDE_TRACE_H
@@ -22,6 +22,8 @@ MSG_TYPE_MAP = {
     message.DataSegment: 8,
     message.HandShakeConfirmed: 9,
     message.Ping: 10,
+    message.AvailabilitySummary: 11,
+    message.BindReadBatch: 12,
 }
 DEFAULT_TIMEOUT = 4000
 
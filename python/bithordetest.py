@@ -160,8 +160,8 @@ class LineBuffer(object):
 
 
 class BithordeD(Popen):
-    def __init__(self, label='bithorded', bithorded=os.environ.get('BITHORDED', 'bithorded'), config={}):
-        cmd = ['stdbuf', '-o0', '-e0', bithorded, '-c', '/dev/stdin', '--log.level=TRACE']
+    def __init__(self, label='bithorded', bithorded=os.environ.get('BITHORDED', 'bithorded'), config={}, loglevel='TRACE'):
+        cmd = ['stdbuf', '-o0', '-e0', bithorded, '-c', '/dev/stdin', '--log.level=%s' % loglevel]
         Popen.__init__(self, cmd, stderr=STDOUT, stdout=PIPE, stdin=PIPE)
         self._cleanup = list()
         if hasattr(config, 'setdefault'):
@@ -187,9 +187,11 @@ class BithordeD(Popen):
         self._run()
 
     def cleanup(self):
-        self.kill()
-        for op in self._cleanup:
-            op()
+        if self.poll() is None:
+            self.kill()
+            self.wait()
+        while self._cleanup:
+            self._cleanup.pop()()
 
     def _run(self):
         atexit.register(self.cleanup)
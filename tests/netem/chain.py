@@ -0,0 +1,40 @@
+#!/usr/bin/env python2
+'''
+client -> edge -> middle -> origin, each hop a WAN-link. Compares reading an asset cold through the
+chain with reading it again, once cached at the edge.
+'''
+
+import argparse
+
+from netem import MB, Network, print_links, print_results
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--duration', type=int, default=5)
+    parser.add_argument('--latency', type=int, default=20, help='ms one-way, per hop')
+    parser.add_argument('--bandwidth', type=int, default=10, help='MiB/s per hop')
+    parser.add_argument('--loss', type=float, default=0.0)
+    parser.add_argument('--verbose', action='store_true')
+    args = parser.parse_args()
+
+    net = Network(verbose=args.verbose)
+    try:
+        origin = net.node('origin', cache_mb=0)
+        middle = net.node('middle')
+        edge = net.node('edge')
+        net.link(middle, origin, args.latency, args.bandwidth * MB, args.loss)
+        net.link(edge, middle, args.latency, args.bandwidth * MB, args.loss)
+        net.start()
+
+        asset = net.publish([origin], 8 * MB)
+        results = [
+            net.bench(origin, [asset], label='origin (local)', duration=args.duration),
+            net.bench(edge, [asset], label='edge (cold)', duration=args.duration, pipeline=16),
+            net.bench(edge, [asset], label='edge (cached)', duration=args.duration, pipeline=16),
+        ]
+        print_results(results)
+        print_links(net)
+
+        assert all(r['reads'] > 0 for r in results)
+    finally:
+        net.stop()
@@ -0,0 +1,37 @@
+#!/usr/bin/env python2
+'''
+An edge with two upstreams holding the same assets; one near and fast, the other far, slow and
+lossy. Shows how well upstream choice and multi-source reads use the better path.
+'''
+
+import argparse
+
+from netem import MB, Network, print_links, print_results
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--duration', type=int, default=5)
+    parser.add_argument('--pattern', default='random')
+    parser.add_argument('--verbose', action='store_true')
+    args = parser.parse_args()
+
+    net = Network(verbose=args.verbose)
+    try:
+        near = net.node('near', cache_mb=0)
+        far = net.node('far', cache_mb=0)
+        edge = net.node('edge', cache_mb=0)
+        net.link(edge, near, latency=5, bandwidth=20 * MB)
+        net.link(edge, far, latency=80, bandwidth=2 * MB, loss=0.01)
+        net.start()
+
+        assets = [net.publish([near, far], 4 * MB) for _ in range(4)]
+        results = [
+            net.bench(edge, assets, label='edge (%s)' % args.pattern, duration=args.duration,
+                      pattern=args.pattern, streams=4, pipeline=8),
+        ]
+        print_results(results)
+        print_links(net)
+
+        assert results[0]['reads'] > 0
+    finally:
+        net.stop()
@@ -0,0 +1,295 @@
+'''
+Emulates a network of bithorded-nodes on one machine, for benchmarking routing and caching.
+
+Each friend-link between two nodes runs through an in-process TCP-proxy, shaping traffic in both
+directions with latency, a bandwidth-limit and packet-loss. Since the proxy sits above TCP, loss is
+emulated as the stall of a retransmission-timeout, delaying everything behind the lost chunk.
+
+A topology is scripted as:
+
+    net = Network()
+    origin = net.node('origin')
+    edge = net.node('edge')
+    net.link(edge, origin, latency=20, bandwidth=10*MB, loss=0.01)
+    net.start()
+    asset = net.publish([origin], 16*MB)
+    print_results([net.bench(edge, [asset], pattern='random')])
+    net.stop()
+
+Binaries are found through $BITHORDED and $BH_BINDIR, like for the other tests.
+'''
+
+import os
+import random
+import re
+import shutil
+import socket
+import subprocess
+import tempfile
+import threading
+import time
+
+from Queue import Queue
+
+from bithordetest import BithordeD
+
+KB = 1024
+MB = 1024 * KB
+
+BINDIR = os.environ.get('BH_BINDIR', 'bin')
+
+# Shortest stall for a "lost" chunk, like the minimum retransmission-timeout of Linux TCP
+MIN_RTO = 0.2
+
+# Chunks buffered in each direction of a link, before the sender is pushed back on
+LINK_QUEUE = 256
+
+
+def free_port():
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.bind(('127.0.0.1', 0))
+    port = s.getsockname()[1]
+    s.close()
+    return port
+
+
+class Shaper(object):
+    '''One direction of a link. Computes when each chunk sent through it should be delivered.'''
+
+    def __init__(self, latency, bandwidth, loss):
+        self.latency = latency / 1000.0
+        self.bandwidth = bandwidth
+        self.loss = loss
+        self.bytes = 0
+        self.lost = 0
+        self._lock = threading.Lock()
+        self._free_at = 0.0
+        self._last_delivery = 0.0
+
+    def schedule(self, size):
+        with self._lock:
+            now = time.time()
+            start = max(now, self._free_at)
+            if self.bandwidth:
+                self._free_at = start + float(size) / self.bandwidth
+            else:
+                self._free_at = start
+            delivery = self._free_at + self.latency
+            if self.loss and random.random() < self.loss:
+                delivery += max(MIN_RTO, 4 * self.latency)
+                self.lost += 1
+            # TCP delivers in order, so a stalled chunk holds back the ones behind it
+            delivery = max(delivery, self._last_delivery)
+            self._last_delivery = delivery
+            self.bytes += size
+            return delivery
+
+
+class Pipe(object):
+    '''Moves data from one socket to another through a Shaper.'''
+
+    def __init__(self, src, dst, shaper):
+        self._src = src
+        self._dst = dst
+        self._shaper = shaper
+        self._queue = Queue(LINK_QUEUE)
+        for target in (self._read, self._write):
+            t = threading.Thread(target=target)
+            t.daemon = True
+            t.start()
+
+    def _read(self):
+        while True:
+            try:
+                data = self._src.recv(64 * KB)
+            except socket.error:
+                data = ''
+            if not data:
+                self._queue.put((0, None))
+                return
+            self._queue.put((self._shaper.schedule(len(data)), data))
+
+    def _write(self):
+        while True:
+            delivery, data = self._queue.get()
+            if data is None:
+                break
+            delay = delivery - time.time()
+            if delay > 0:
+                time.sleep(delay)
+            try:
+                self._dst.sendall(data)
+            except socket.error:
+                break
+        for sock in (self._dst, self._src):
+            try:
+                sock.shutdown(socket.SHUT_RDWR)
+            except socket.error:
+                pass
+
+
+class Link(object):
+    '''
+    A TCP-proxy listening on a local port and forwarding to /target_port/. latency is in ms one-way,
+    bandwidth in bytes/s (0 for unlimited) and loss the probability for each chunk to be stalled.
+    '''
+
+    def __init__(self, name, target_port, latency=0, bandwidth=0, loss=0.0):
+        self.name = name
+        self.target_port = target_port
+        self.up = Shaper(latency, bandwidth, loss)
+        self.down = Shaper(latency, bandwidth, loss)
+        self._listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self._listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self._listener.bind(('127.0.0.1', 0))
+        self._listener.listen(16)
+        self.port = self._listener.getsockname()[1]
+        t = threading.Thread(target=self._accept)
+        t.daemon = True
+        t.start()
+
+    def _accept(self):
+        while True:
+            try:
+                client, _ = self._listener.accept()
+            except socket.error:
+                return
+            try:
+                server = socket.create_connection(('127.0.0.1', self.target_port))
+            except socket.error:
+                client.close()
+                continue
+            for sock in (client, server):
+                sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            Pipe(client, server, self.up)
+            Pipe(server, client, self.down)
+
+    def close(self):
+        self._listener.close()
+
+
+class Node(object):
+    '''A bithorded-instance in the network, with its own cache and source-folder.'''
+
+    def __init__(self, net, name, cache_mb):
+        self.name = name
+        self.dir = os.path.join(net.dir, name)
+        self.src = os.path.join(self.dir, 'src')
+        self.socket = os.path.join(self.dir, 'sock')
+        self.port = free_port()
+        os.makedirs(self.src)
+        self.config = {
+            'server': {
+                'name': name,
+                'tcpPort': self.port,
+                'unixSocket': self.socket,
+                'inspectPort': 0,
+            },
+            'source.local.root': self.src,
+        }
+        if cache_mb:
+            cache = os.path.join(self.dir, 'cache')
+            os.makedirs(cache)
+            self.config['cache'] = {'dir': cache, 'size': cache_mb}
+        else:
+            self.config['cache'] = {'dir': ''}
+        self.process = None
+
+    def start(self, verbose):
+        self.process = BithordeD(label=self.name if verbose else None, config=self.config,
+                                 loglevel='DEBUG' if verbose else 'INFO')
+
+    def stop(self):
+        if self.process:
+            self.process.cleanup()
+            self.process = None
+
+
+class Network(object):
+    def __init__(self, verbose=False):
+        self.dir = tempfile.mkdtemp(prefix='bhnetem-')
+        self.nodes = []
+        self.links = []
+        self.verbose = verbose
+
+    def node(self, name, cache_mb=256):
+        node = Node(self, name, cache_mb)
+        self.nodes.append(node)
+        return node
+
+    def link(self, downstream, upstream, latency=0, bandwidth=0, loss=0.0):
+        '''downstream connects to upstream as friends, through a shaped link'''
+        link = Link('%s->%s' % (downstream.name, upstream.name), upstream.port, latency, bandwidth, loss)
+        downstream.config['friend.%s.addr' % upstream.name] = '127.0.0.1:%d' % link.port
+        upstream.config['friend.%s.addr' % downstream.name] = ''
+        self.links.append((downstream, upstream, link))
+        return link
+
+    def start(self):
+        for node in self.nodes:
+            node.start(self.verbose)
+        for downstream, upstream, _ in self.links:
+            downstream.process.wait_for('Friend %s connected' % upstream.name)
+
+    def stop(self):
+        for node in self.nodes:
+            node.stop()
+        for _, _, link in self.links:
+            link.close()
+        shutil.rmtree(self.dir, ignore_errors=True)
+
+    def publish(self, nodes, size, name=None):
+        '''Places the same random content of /size/ bytes on each of /nodes/, returning its magnet-link'''
+        name = name or 'asset-%d' % random.getrandbits(32)
+        content = os.urandom(size)
+        magnet = None
+        for node in nodes:
+            path = os.path.join(node.src, name)
+            with open(path, 'wb') as f:
+                f.write(content)
+            out = subprocess.check_output([os.path.join(BINDIR, 'bhupload'), '-u', node.socket, '-l', path])
+            magnet = out.strip().splitlines()[-1]
+        return magnet
+
+    def bench(self, node, magnets, label=None, **opts):
+        '''Runs bhbench against /node/, with opts as its long options. Returns the parsed report.'''
+        cmd = [os.path.join(BINDIR, 'bhbench'), '-q', '-u', node.socket]
+        for key, value in sorted(opts.items()):
+            cmd.append('--%s=%s' % (key.replace('_', '-'), value))
+        out = subprocess.check_output(cmd + list(magnets))
+        result = parse_report(out)
+        result['label'] = label or node.name
+        return result
+
+
+def parse_report(out):
+    res = {}
+    for line in out.splitlines():
+        key, _, value = line.partition(':')
+        value = value.strip()
+        if key == 'throughput':
+            res['mibps'], res['readsps'] = [float(x) for x in re.findall(r'[\d.]+', value)]
+        elif key == 'reads':
+            res['reads'], res['failed'] = [int(x) for x in re.findall(r'\d+', value)]
+        elif key == 'binds':
+            res['binds'], res['binds_failed'] = [int(x) for x in re.findall(r'\d+', value)]
+        elif key in ('read latency', 'bind latency'):
+            prefix = key.split()[0]
+            for name, ms in re.findall(r'(\w+(?:\.\d)?)=([\d.]+)', value):
+                res['%s_%s' % (prefix, name)] = float(ms)
+    return res
+
+
+def print_results(results):
+    print('%-24s %10s %10s %9s %9s %9s %7s %7s' % (
+        '', 'MiB/s', 'reads/s', 'p50 ms', 'p99 ms', 'bind ms', 'failed', 'binds'))
+    for r in results:
+        print('%-24s %10.2f %10.1f %9.2f %9.2f %9.2f %7d %3d/%-3d' % (
+            r['label'], r['mibps'], r['readsps'], r['read_p50'], r['read_p99'], r['bind_p50'], r['failed'],
+            r['binds'], r['binds'] + r['binds_failed']))
+
+
+def print_links(net):
+    print('%-24s %12s %12s %8s' % ('link', 'up KiB', 'down KiB', 'stalls'))
+    for _, _, link in net.links:
+        print('%-24s %12d %12d %8d' % (link.name, link.up.bytes / KB, link.down.bytes / KB, link.up.lost + link.down.lost))
@@ -0,0 +1,37 @@
+#!/usr/bin/env python2
+'''
+Three nodes all friends with each other, the asset only on one. Requests going around the triangle
+must be stopped by loop prevention, while reads still complete over the direct link.
+'''
+
+import argparse
+
+from netem import MB, Network, print_links, print_results
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--duration', type=int, default=5)
+    parser.add_argument('--verbose', action='store_true')
+    args = parser.parse_args()
+
+    net = Network(verbose=args.verbose)
+    try:
+        a = net.node('a')
+        b = net.node('b')
+        c = net.node('c', cache_mb=0)
+        net.link(a, b, latency=10, bandwidth=10 * MB)
+        net.link(b, c, latency=10, bandwidth=10 * MB)
+        net.link(c, a, latency=10, bandwidth=10 * MB)
+        net.start()
+
+        assets = [net.publish([c], 2 * MB) for _ in range(8)]
+        results = [
+            net.bench(a, assets, label='a (churn)', duration=args.duration, pattern='churn', streams=4),
+            net.bench(b, assets, label='b (zipf)', duration=args.duration, pattern='zipf', streams=4),
+        ]
+        print_results(results)
+        print_links(net)
+
+        assert all(r['reads'] > 0 and not r['failed'] for r in results)
+    finally:
+        net.stop()
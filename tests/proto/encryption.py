@@ -59,7 +59,7 @@ def secure_auth_and_encryption(conn, name, key, cipher, validate_auth=True):
     try:
         conn.send(
             message.HandShake(name=name, protoversion=2, challenge=challenge))
-        greeting = conn.expect(message.HandShake(protoversion=2))
+        greeting = conn.expect(message.HandShake(protoversion=3))
         my_auth = hmac.HMAC(
             key, greeting.challenge + chr(cipher) + sendIv, digestmod=hashlib.sha256).digest()
         conn.send(message.HandShakeConfirmed(
@@ -0,0 +1,50 @@
+#!/usr/bin/env python2
+
+import socket
+import urllib2
+from threading import Thread
+
+from bithordetest import message, BithordeD, TestConnection, TigerId
+
+ASSET_TTH = 'GIS3CRGMSBT7CKRBLQFXFAL3K4YIO5P5E3AMC2A'
+DATA = 'A' * 1024
+
+
+def free_port():
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.bind(('127.0.0.1', 0))
+    port = s.getsockname()[1]
+    s.close()
+    return port
+
+
+def fetch(url, result):
+    try:
+        result.append(urllib2.urlopen(url, timeout=10).read())
+    except Exception as e:
+        result.append(e)
+
+
+if __name__ == '__main__':
+    gateway_port = free_port()
+    bithorded = BithordeD(config={
+        'server': {'gatewayPort': gateway_port},
+        'friend.upstream1.addr': '',
+    })
+    upstream1 = TestConnection(bithorded, name='upstream1')
+
+    # An asset only the friend has, asked for over HTTP
+    result = []
+    request = Thread(target=fetch, args=('http://127.0.0.1:%d/tiger/%s' % (gateway_port, ASSET_TTH), result))
+    request.start()
+
+    # Reaches the friend as any other bind, with the gateway as requester
+    req = upstream1.expect(message.BindRead(ids=[TigerId(ASSET_TTH)]))
+    assert len(req.requesters) >= 2
+    upstream1.send(message.AssetStatus(handle=req.handle, ids=req.ids, status=message.SUCCESS, size=len(DATA)))
+
+    # And is served from there
+    read = upstream1.expect(message.Read.Request(handle=req.handle, offset=0))
+    upstream1.send(message.Read.Response(reqId=read.reqId, status=message.SUCCESS, offset=0, content=DATA[:read.size]))
+    request.join()
+    assert result == [DATA], "Unexpected response %s" % result
@@ -0,0 +1,39 @@
+#!/usr/bin/env python2
+
+from bithordetest import message, BithordeD, TestConnection, TigerId
+
+ASSET1 = [TigerId('GIS3CRGMSBT7CKRBLQFXFAL3K4YIO5P5E3AMC2A')]
+ASSET2 = [TigerId('Y7R7NQIGBJ4RLK3JKLQ6NPIWNSZBIF2QDOWQYRQ')]
+
+
+def sync(conn):
+    '''Round-trips a Ping, so everything sent on /conn/ before has been processed.'''
+    conn.send(message.Ping(timeout=1000))
+    conn.expect(message.Ping)
+
+
+if __name__ == '__main__':
+    bithorded = BithordeD(config={
+        'friend.upstream1.addr': '',
+        'friend.upstream2.addr': '',
+    })
+    upstream1 = TestConnection(bithorded, name='upstream1')
+    upstream2 = TestConnection(bithorded, name='upstream2')
+    downstream = TestConnection(bithorded, name='downstream')
+
+    # An empty summary from upstream2, so it is only asked once upstream1 lacks an asset
+    upstream2.send(message.AvailabilitySummary(bloom='\0' * 64, hashes=1))
+    sync(upstream2)
+
+    # Released before upstream1 answers, upstream2 should never be asked
+    downstream.send(message.BindRead(handle=1, ids=ASSET1, timeout=500))
+    req1 = upstream1.expect(message.BindRead(ids=ASSET1))
+    downstream.send(message.BindRead(handle=1, ids=[]))
+    downstream.expect(message.AssetStatus(handle=1, status=message.NOTFOUND))
+    upstream1.expect(message.BindRead(handle=req1.handle, ids=[]))
+
+    # A miss at upstream1 falls back to asking upstream2, and that is the first it hears
+    downstream.send(message.BindRead(handle=2, ids=ASSET2, timeout=500))
+    req2 = upstream1.expect(message.BindRead(ids=ASSET2))
+    upstream1.send(message.AssetStatus(handle=req2.handle, status=message.NOTFOUND))
+    upstream2.expect(message.BindRead(ids=ASSET2))
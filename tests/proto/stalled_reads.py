@@ -0,0 +1,60 @@
+#!/usr/bin/env python2
+
+from time import sleep
+
+from bithordetest import message, BithordeD, Cache, TestConnection
+
+SEGMENT = 64 * 1024
+ASSET = 'A' * (64 * SEGMENT)
+LONG_TIMEOUT = 20000
+SHORT_TIMEOUT = 200
+
+
+def read(conn, reqId, timeout):
+    conn.send(message.Read.Request(reqId=reqId, handle=2, offset=reqId * SEGMENT, size=SEGMENT, timeout=timeout))
+
+
+if __name__ == '__main__':
+    bithorded = BithordeD(config={
+        'cache': {'dir': Cache()},
+        'client.tester.addr': '',
+    })
+    conn = TestConnection(bithorded, name='tester')
+
+    # Upload an asset, to read locally
+    conn.send(message.BindWrite(handle=1, size=len(ASSET)))
+    conn.expect(message.AssetStatus(handle=1, status=message.SUCCESS))
+    for offset in range(0, len(ASSET), SEGMENT):
+        conn.send(message.DataSegment(handle=1, offset=offset, content=ASSET[offset:offset + SEGMENT]))
+    status = conn.expect(message.AssetStatus(handle=1, status=message.SUCCESS))
+    while not status.ids:
+        status = conn.expect(message.AssetStatus(handle=1))
+    conn.send(message.BindRead(handle=2, ids=status.ids, timeout=500))
+    conn.expect(message.AssetStatus(handle=2, status=message.SUCCESS))
+
+    # Ask for far more than the send-queue holds, without reading any of it. Later reads are held
+    # back, and the short ones among them expire while held.
+    for reqId in range(0, 40):
+        read(conn, reqId, LONG_TIMEOUT)
+    for reqId in range(40, 44):
+        read(conn, reqId, SHORT_TIMEOUT)
+    sleep(1)
+    for reqId in range(44, 48):
+        read(conn, reqId, LONG_TIMEOUT)
+
+    # Every read is answered once. The expired ones with TIMEOUT, and in order with the reads held
+    # behind them.
+    answers = []
+    while len(answers) < 48:
+        msg = conn.next()
+        if isinstance(msg, message.Read.Response):
+            answers.append(msg)
+    assert sorted(a.reqId for a in answers) == range(48)
+    for a in answers:
+        if 40 <= a.reqId < 44:
+            assert a.status == message.TIMEOUT, "Expired read %d answered %d" % (a.reqId, a.status)
+        else:
+            assert a.status == message.SUCCESS, "Read %d answered %d" % (a.reqId, a.status)
+            assert a.offset == a.reqId * SEGMENT and a.content == ASSET[:SEGMENT]
+    order = [a.reqId for a in answers if a.reqId >= 40]
+    assert order[:4] == range(40, 44), "Held reads answered out of order: %s" % order
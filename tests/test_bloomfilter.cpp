@@ -0,0 +1,36 @@
+#include <boost/test/unit_test.hpp>
+
+#include "bithorded/lib/bloomfilter.hpp"
+
+#include <boost/lexical_cast.hpp>
+
+using namespace bithorded;
+
+BOOST_AUTO_TEST_CASE( bloomfilter_membership )
+{
+	auto filter = BloomFilter::forItems(1000, 128*1024);
+	BOOST_CHECK_EQUAL( filter.bits().size(), 1250 );
+
+	for (int i=0; i < 1000; i++)
+		filter.insert("in" + boost::lexical_cast<std::string>(i));
+	for (int i=0; i < 1000; i++)
+		BOOST_CHECK( filter.mayContain("in" + boost::lexical_cast<std::string>(i)) );
+
+	int falsePositives = 0;
+	for (int i=0; i < 10000; i++) {
+		if (filter.mayContain("out" + boost::lexical_cast<std::string>(i)))
+			falsePositives++;
+	}
+	BOOST_CHECK_LT( falsePositives, 300 );
+
+	// Survives the trip through an AvailabilitySummary
+	BloomFilter copy(filter.bits(), filter.hashes());
+	BOOST_CHECK( copy.mayContain("in42") );
+}
+
+BOOST_AUTO_TEST_CASE( bloomfilter_bounded )
+{
+	auto filter = BloomFilter::forItems(1000000, 1024);
+	BOOST_CHECK_EQUAL( filter.bits().size(), 1024 );
+	BOOST_CHECK( !filter.mayContain("anything") );
+}
@@ -0,0 +1,131 @@
+#include <set>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <bithorded/cache/asset.hpp>
+#include <bithorded/cache/manager.hpp>
+#include <bithorded/lib/grandcentraldispatch.hpp>
+
+namespace fs = boost::filesystem;
+using namespace bithorded;
+
+const uint64_t ASSET_SIZE = 16*1024*1024;
+const size_t CHUNK = 64*1024;
+
+namespace {
+
+struct NoSource : public IAssetSource {
+	virtual UpstreamRequestBinding::Ptr findAsset(const bithorde::BindRead& req) {
+		return UpstreamRequestBinding::NONE;
+	}
+};
+
+/**
+ * Records reads, but never answers them, so nothing lands in the cache.
+ */
+struct RecordingUpstream : public IAsset {
+	std::vector<std::pair<uint64_t, size_t>> reads;
+
+	RecordingUpstream() {
+		status.change()->set_status(bithorde::SUCCESS);
+	}
+	virtual void asyncRead(uint64_t offset, size_t size, uint32_t timeout, ReadCallback cb) {
+		reads.push_back(std::make_pair(offset, size));
+	}
+	virtual uint64_t size() { return ASSET_SIZE; }
+	virtual void apply(const AssetRequestParameters& old_parameters, const AssetRequestParameters& new_parameters) {}
+	virtual size_t canRead(uint64_t offset, size_t size) { return 0; }
+	virtual void inspect(management::InfoList& target) const {}
+
+	uint64_t furthest() const {
+		uint64_t res = 0;
+		for (auto& read : reads)
+			res = std::max(res, read.first + read.second);
+		return res;
+	}
+};
+
+struct CachingFixture {
+	boost::asio::io_context ioCtx;
+	GrandCentralDispatch gcd;
+	NoSource router;
+	cache::CacheManager manager;
+	fs::path temp;
+	std::shared_ptr<RecordingUpstream> upstream;
+	std::shared_ptr<cache::CachingAsset> asset;
+
+	CachingFixture() :
+		gcd(ioCtx, 1),
+		manager(gcd, router, fs::path(), 0),
+		temp(fs::unique_path("bhtest-caching-%%%%-%%%%")),
+		upstream(std::make_shared<RecordingUpstream>())
+	{
+		asset = std::make_shared<cache::CachingAsset>(manager, upstream, cache::CachedAsset::create(gcd, temp, ASSET_SIZE));
+	}
+	~CachingFixture() {
+		asset.reset();
+		fs::remove_all(temp);
+	}
+
+	void read(uint64_t offset) {
+		asset->asyncRead(offset, CHUNK, 1000, [](int64_t, const std::shared_ptr<bithorde::IBuffer>&) {});
+	}
+};
+
+}
+
+BOOST_FIXTURE_TEST_CASE( caching_prefetches_sequential, CachingFixture )
+{
+	read(0);
+	BOOST_CHECK_EQUAL( upstream->reads.size(), 1 );
+	BOOST_CHECK_EQUAL( upstream->furthest(), CHUNK );
+
+	// Continuing where the last read ended fetches ahead of the reader
+	read(CHUNK);
+	auto ahead = upstream->furthest();
+	BOOST_CHECK_GT( ahead, 2*CHUNK );
+
+	// And further ahead the longer it keeps going
+	uint64_t offset = 2*CHUNK;
+	for (int i = 0; i < 4; i++, offset += CHUNK)
+		read(offset);
+	BOOST_CHECK_GT( upstream->furthest() - offset, ahead - 2*CHUNK );
+
+	// Ranges already requested are not requested again
+	std::set<uint64_t> offsets;
+	for (auto& read : upstream->reads)
+		offsets.insert(read.first);
+	BOOST_CHECK_EQUAL( offsets.size(), upstream->reads.size() - 4 ); // Reader caught up with prefetch 4 times
+}
+
+BOOST_FIXTURE_TEST_CASE( caching_random_reads_not_prefetched, CachingFixture )
+{
+	const uint64_t offsets[] = { 5*CHUNK, 100*CHUNK, 17*CHUNK, 60*CHUNK, 3*CHUNK, 200*CHUNK };
+	for (auto offset : offsets)
+		read(offset);
+
+	BOOST_REQUIRE_EQUAL( upstream->reads.size(), 6 );
+	for (size_t i = 0; i < 6; i++) {
+		BOOST_CHECK_EQUAL( upstream->reads[i].first, offsets[i] );
+		BOOST_CHECK_EQUAL( upstream->reads[i].second, CHUNK );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( caching_congested_reader_prefetches_less )
+{
+	// How far ahead prefetch reaches for a sequential reader, after stalling /stalls/ times
+	auto reachAfter = [](int stalls) {
+		CachingFixture f;
+		f.read(0);
+		f.read(CHUNK);
+		for (int i = 0; i < stalls; i++)
+			f.asset->downstreamCongested(2*CHUNK);
+		f.read(2*CHUNK);
+		return f.upstream->furthest();
+	};
+
+	// Stalling more never earns a wider window, and a stalled reader still gets some prefetch
+	BOOST_CHECK_LE( reachAfter(30), reachAfter(2) );
+	BOOST_CHECK_LE( reachAfter(2), reachAfter(0) );
+	BOOST_CHECK_GT( reachAfter(30), 3*CHUNK );
+}
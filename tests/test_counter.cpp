@@ -0,0 +1,65 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../lib/counter.h"
+
+#include <boost/asio/io_context.hpp>
+
+BOOST_AUTO_TEST_CASE( windowed_percentile )
+{
+	WindowedPercentile p(10, 0.9, "ms");
+	BOOST_CHECK_EQUAL( p.value(), 0 );
+	BOOST_CHECK_EQUAL( p.samples(), 0 );
+
+	for (uint64_t i=1; i <= 10; i++)
+		p.post(i);
+	BOOST_CHECK_EQUAL( p.samples(), 10 );
+	BOOST_CHECK_EQUAL( p.value(), 10 );
+
+	// Oldest samples roll out of the window
+	for (int i=0; i < 9; i++)
+		p.post(100);
+	BOOST_CHECK_EQUAL( p.samples(), 10 );
+	BOOST_CHECK_EQUAL( p.value(), 100 );
+	for (int i=0; i < 10; i++)
+		p.post(5);
+	BOOST_CHECK_EQUAL( p.value(), 5 );
+}
+
+BOOST_AUTO_TEST_CASE( aggregated_counters )
+{
+	boost::asio::io_context ioCtx;
+	auto agg = std::make_shared<StatsAggregator>(TimerService::forContext(ioCtx), boost::posix_time::seconds(1), 4);
+	{
+		LazyCounter a(agg, "B", 0.5);
+		LazyCounter b(agg, "B", 0.0);
+		BOOST_CHECK_EQUAL( agg->size(), 2 );
+
+		a += 100;
+		b += 100;
+		agg->tick();
+		BOOST_CHECK_EQUAL( a.value(), 50 );
+		BOOST_CHECK_EQUAL( b.value(), 100 );
+		BOOST_CHECK_EQUAL( b.windowed().value(), 25 );
+		BOOST_CHECK_EQUAL( b.percentile(1.0).value(), 100 );
+
+		for (int i=0; i < 3; i++) {
+			b += 20;
+			agg->tick();
+		}
+		BOOST_CHECK_EQUAL( b.windowed().value(), 40 );
+		BOOST_CHECK_EQUAL( b.percentile(0.5).value(), 20 );
+
+		// Oldest period rolls out of the window
+		agg->tick();
+		BOOST_CHECK_EQUAL( b.windowed().value(), 15 );
+		BOOST_CHECK_EQUAL( b.percentile(1.0).value(), 20 );
+		BOOST_CHECK_EQUAL( b.value(), 0 );
+	}
+	BOOST_CHECK_EQUAL( agg->size(), 0 );
+
+	// Released slots are reused and start out clean
+	LazyCounter c(agg, "B", 0.5);
+	BOOST_CHECK_EQUAL( agg->size(), 1 );
+	BOOST_CHECK_EQUAL( c.windowed().value(), 0 );
+	BOOST_CHECK( StatsAggregator::forService(TimerService::forContext(ioCtx)) == StatsAggregator::forService(TimerService::forContext(ioCtx)) );
+}
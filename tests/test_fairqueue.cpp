@@ -0,0 +1,69 @@
+#include <boost/test/unit_test.hpp>
+
+#include "bithorded/lib/fairqueue.hpp"
+
+#include <map>
+#include <vector>
+
+using namespace bithorded;
+
+BOOST_AUTO_TEST_CASE( fairqueue_limits_active )
+{
+	FairQueue queue(2, 1000);
+	auto flow = queue.flow(1);
+	std::vector<FairQueue::Ticket> tickets;
+	for (int i=0; i < 5; i++)
+		queue.submit(flow, 1000, [&](const FairQueue::Ticket& t) { tickets.push_back(t); });
+
+	BOOST_CHECK_EQUAL( tickets.size(), 2 );
+	BOOST_CHECK_EQUAL( queue.queued(), 3 );
+
+	// Completing one lets the next in
+	auto first = tickets.front();
+	tickets.erase(tickets.begin());
+	first.reset();
+	BOOST_CHECK_EQUAL( tickets.size(), 2 );
+	BOOST_CHECK_EQUAL( queue.active(), 2 );
+	BOOST_CHECK_EQUAL( queue.queued(), 2 );
+
+	for (int i=0; i < 2; i++) {
+		std::vector<FairQueue::Ticket> completed;
+		completed.swap(tickets);
+	}
+	BOOST_CHECK_EQUAL( queue.active(), 0 );
+
+	// Jobs completing synchronously does not stall the queue
+	int done = 0;
+	for (int i=0; i < 3; i++)
+		queue.submit(flow, 1000, [&](const FairQueue::Ticket&) { done++; });
+	BOOST_CHECK_EQUAL( done, 3 );
+	BOOST_CHECK_EQUAL( queue.active(), 0 );
+	BOOST_CHECK_EQUAL( queue.queued(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( fairqueue_weighted_share )
+{
+	FairQueue queue(1, 1000);
+	auto heavy = queue.flow(3);
+	auto light = queue.flow(1);
+	std::vector<FairQueue::Ticket> tickets;
+	std::map<int, int> served;
+
+	// Hold the only slot, while both flows build up a backlog
+	queue.submit(light, 1000, [&](const FairQueue::Ticket& t) { tickets.push_back(t); });
+	for (int i=0; i < 100; i++) {
+		queue.submit(heavy, 1000, [&](const FairQueue::Ticket& t) { served[3]++; tickets.push_back(t); });
+		queue.submit(light, 1000, [&](const FairQueue::Ticket& t) { served[1]++; tickets.push_back(t); });
+	}
+	for (int i=0; i < 80; i++) {
+		std::vector<FairQueue::Ticket> completed;
+		completed.swap(tickets);
+	}
+
+	BOOST_CHECK_EQUAL( served[3] + served[1], 80 );
+	BOOST_CHECK_EQUAL( served[3], 60 );
+	BOOST_CHECK_EQUAL( served[1], 20 );
+
+	light->clear();
+	BOOST_CHECK_EQUAL( queue.queued(), 40 );
+}
@@ -0,0 +1,191 @@
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <bithorded/lib/grandcentraldispatch.hpp>
+
+using namespace bithorded;
+
+namespace {
+
+/**
+ * Keeps a worker busy until released, so following jobs queue up behind it.
+ */
+struct Blocker {
+	std::promise<void> release;
+	std::shared_future<void> released;
+	std::atomic<bool> started;
+
+	Blocker(GrandCentralDispatch& gcd) : released(release.get_future().share()), started(false) {
+		auto released_ = released;
+		gcd.submit([this, released_]() { started = true; released_.wait(); return 0; }, [](int) {});
+		while (!started)
+			std::this_thread::yield();
+	}
+};
+
+void runUntil(boost::asio::io_context& ioCtx, const std::function<bool()>& done) {
+	while (!done()) {
+		ioCtx.restart();
+		ioCtx.run_for(std::chrono::milliseconds(10));
+	}
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( gcd_runs_most_urgent_first )
+{
+	boost::asio::io_context ioCtx;
+	GrandCentralDispatch gcd(ioCtx, 1);
+	Blocker blocker(gcd);
+
+	std::vector<int> ran; // Only touched by the single worker
+	std::vector<int> completed;
+	auto submit = [&](int id, GrandCentralDispatch::Priority priority) {
+		gcd.submit([&ran, id]() { ran.push_back(id); return id; }, [&completed](int id) { completed.push_back(id); }, priority);
+	};
+	submit(1, GrandCentralDispatch::MAINTENANCE);
+	submit(2, GrandCentralDispatch::HASH);
+	submit(3, GrandCentralDispatch::WRITE);
+	submit(4, GrandCentralDispatch::INTERACTIVE);
+	submit(5, GrandCentralDispatch::INTERACTIVE);
+	BOOST_CHECK_EQUAL( gcd.queued(GrandCentralDispatch::INTERACTIVE), 2 );
+	BOOST_CHECK_EQUAL( gcd.queued(GrandCentralDispatch::HASH), 1 );
+
+	blocker.release.set_value();
+	runUntil(ioCtx, [&]{ return completed.size() == 5; });
+	BOOST_CHECK( (ran == std::vector<int>{4, 5, 3, 2, 1}) );
+	BOOST_CHECK( (completed == std::vector<int>{4, 5, 3, 2, 1}) );
+	BOOST_CHECK_EQUAL( gcd.queued(GrandCentralDispatch::INTERACTIVE), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( gcd_urgent_flood_does_not_starve )
+{
+	boost::asio::io_context ioCtx;
+	GrandCentralDispatch gcd(ioCtx, 1);
+	Blocker blocker(gcd);
+
+	const int FLOOD = 100, HASH = -1, MAINTENANCE = -2;
+	std::vector<int> ran; // Only touched by the single worker
+	int completed = 0;
+	auto submit = [&](int id, GrandCentralDispatch::Priority priority) {
+		gcd.submit([&ran, id]() { ran.push_back(id); return id; }, [&completed](int) { completed++; }, priority);
+	};
+	submit(MAINTENANCE, GrandCentralDispatch::MAINTENANCE);
+	submit(HASH, GrandCentralDispatch::HASH);
+	for (int i = 0; i < FLOOD; i++)
+		submit(i, GrandCentralDispatch::INTERACTIVE);
+
+	blocker.release.set_value();
+	runUntil(ioCtx, [&]{ return completed == FLOOD + 2; });
+
+	// Urgent jobs still go first, but the waiting ones get their turn long before the flood ends
+	BOOST_REQUIRE_EQUAL( ran.size(), FLOOD + 2 );
+	BOOST_CHECK_EQUAL( ran.front(), 0 );
+	auto hash = std::find(ran.begin(), ran.end(), HASH) - ran.begin();
+	auto maintenance = std::find(ran.begin(), ran.end(), MAINTENANCE) - ran.begin();
+	BOOST_CHECK_LT( hash, FLOOD / 4 );
+	BOOST_CHECK_LT( maintenance, FLOOD / 4 );
+	BOOST_CHECK_LT( hash, maintenance );
+
+	// And the flood itself keeps its order
+	std::vector<int> interactive;
+	std::copy_if(ran.begin(), ran.end(), std::back_inserter(interactive), [](int id) { return id >= 0; });
+	for (int i = 0; i < FLOOD; i++)
+		BOOST_CHECK_EQUAL( interactive[i], i );
+}
+
+BOOST_AUTO_TEST_CASE( gcd_cancelled_jobs_are_skipped )
+{
+	boost::asio::io_context ioCtx;
+	GrandCentralDispatch gcd(ioCtx, 1);
+	Blocker blocker(gcd);
+
+	std::atomic<bool> ran(false);
+	bool completed = false, sentinel = false;
+	auto token = CancelToken::create();
+	gcd.submit([&]() { ran = true; return 0; }, [&](int) { completed = true; }, GrandCentralDispatch::INTERACTIVE, token);
+	gcd.submit([]() { return 0; }, [&](int) { sentinel = true; }, GrandCentralDispatch::MAINTENANCE);
+	token.cancel();
+
+	blocker.release.set_value();
+	runUntil(ioCtx, [&]{ return sentinel; });
+	BOOST_CHECK( !ran );
+	BOOST_CHECK( !completed );
+}
+
+BOOST_AUTO_TEST_CASE( gcd_cancel_scope )
+{
+	auto token = CancelToken::create();
+	BOOST_CHECK( !CancelToken::current().cancelled() );
+	{
+		CancelToken::Scope scope(token);
+		token.cancel();
+		BOOST_CHECK( CancelToken::current().cancelled() );
+	}
+	BOOST_CHECK( !CancelToken::current().cancelled() );
+
+	// Default tokens are never cancelled
+	CancelToken never;
+	never.cancel();
+	BOOST_CHECK( !never.cancelled() );
+}
+
+BOOST_AUTO_TEST_CASE( gcd_completes_on_controller )
+{
+	boost::asio::io_context ioCtx;
+	GrandCentralDispatch gcd(ioCtx, 4);
+	const int JOBS = 1000;
+	auto controller = std::this_thread::get_id();
+	int completed = 0;
+	long sum = 0;
+	bool allOnController = true;
+	for (int i = 0; i < JOBS; i++) {
+		auto priority = static_cast<GrandCentralDispatch::Priority>(i % GrandCentralDispatch::PRIORITIES);
+		gcd.submit([i]() { return i; }, [&, controller](int res) {
+			allOnController &= (std::this_thread::get_id() == controller);
+			sum += res;
+			completed++;
+		}, priority);
+	}
+	runUntil(ioCtx, [&]{ return completed == JOBS; });
+	BOOST_CHECK_EQUAL( sum, JOBS * (JOBS - 1) / 2 );
+	BOOST_CHECK( allOnController );
+}
+
+BOOST_AUTO_TEST_CASE( gcd_releases_handlers_on_controller )
+{
+	// Records which thread let go of it last
+	struct Witness {
+		std::thread::id& releasedOn;
+		explicit Witness(std::thread::id& releasedOn) : releasedOn(releasedOn) {}
+		~Witness() { releasedOn = std::this_thread::get_id(); }
+	};
+
+	boost::asio::io_context ioCtx;
+	GrandCentralDispatch gcd(ioCtx, 2);
+	auto controller = std::this_thread::get_id();
+	std::thread::id completedOn, cancelledOn;
+	bool completed = false;
+
+	auto token = CancelToken::create();
+	Blocker blocker(gcd), blocker2(gcd);
+	{
+		auto witness = std::make_shared<Witness>(completedOn);
+		gcd.submit([witness]() { return 0; }, [witness, &completed](int) { completed = true; });
+		witness = std::make_shared<Witness>(cancelledOn);
+		gcd.submit([witness]() { return 0; }, [witness](int) {}, GrandCentralDispatch::INTERACTIVE, token);
+	}
+	token.cancel();
+	blocker.release.set_value();
+	blocker2.release.set_value();
+
+	runUntil(ioCtx, [&]{ return completedOn != std::thread::id() && cancelledOn != std::thread::id(); });
+	BOOST_CHECK( completed );
+	BOOST_CHECK( completedOn == controller );
+	BOOST_CHECK( cancelledOn == controller );
+}
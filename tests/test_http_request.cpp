@@ -0,0 +1,88 @@
+#include <boost/test/unit_test.hpp>
+
+#include "bithorded/http_server/request.hpp"
+
+using namespace http::server;
+
+namespace {
+	request make(const std::string& uri, int minor=1) {
+		request req;
+		req.method = "GET";
+		req.uri = uri;
+		req.http_version_major = 1;
+		req.http_version_minor = minor;
+		return req;
+	}
+
+	request::range_type parse(const char* header, uint64_t size, uint64_t& first, uint64_t& last) {
+		request req;
+		req.method = "GET";
+		req.uri = "/";
+		if (header)
+			req.headers.push_back({"range", header});
+		return req.range(size, first, last);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( http_range_parses_single_ranges )
+{
+	uint64_t first = 0, last = 0;
+	BOOST_CHECK_EQUAL(parse(NULL, 1000, first, last), request::no_range);
+
+	BOOST_CHECK_EQUAL(parse("bytes=100-199", 1000, first, last), request::valid_range);
+	BOOST_CHECK_EQUAL(first, 100);
+	BOOST_CHECK_EQUAL(last, 199);
+
+	BOOST_CHECK_EQUAL(parse("bytes=900-", 1000, first, last), request::valid_range);
+	BOOST_CHECK_EQUAL(first, 900);
+	BOOST_CHECK_EQUAL(last, 999);
+
+	// Clamped to the content
+	BOOST_CHECK_EQUAL(parse("bytes=900-5000", 1000, first, last), request::valid_range);
+	BOOST_CHECK_EQUAL(last, 999);
+
+	// Suffixes
+	BOOST_CHECK_EQUAL(parse("bytes=-10", 1000, first, last), request::valid_range);
+	BOOST_CHECK_EQUAL(first, 990);
+	BOOST_CHECK_EQUAL(last, 999);
+	BOOST_CHECK_EQUAL(parse("bytes=-5000", 1000, first, last), request::valid_range);
+	BOOST_CHECK_EQUAL(first, 0);
+}
+
+BOOST_AUTO_TEST_CASE( http_range_rejects_unsatisfiable_and_malformed )
+{
+	uint64_t first = 0, last = 0;
+	BOOST_CHECK_EQUAL(parse("bytes=1000-", 1000, first, last), request::unsatisfiable_range);
+	BOOST_CHECK_EQUAL(parse("bytes=-0", 1000, first, last), request::unsatisfiable_range);
+
+	BOOST_CHECK_EQUAL(parse("bytes=200-100", 1000, first, last), request::no_range);
+	BOOST_CHECK_EQUAL(parse("bytes=0-1,5-6", 1000, first, last), request::no_range);
+	BOOST_CHECK_EQUAL(parse("items=0-1", 1000, first, last), request::no_range);
+	BOOST_CHECK_EQUAL(parse("bytes=a-b", 1000, first, last), request::no_range);
+	BOOST_CHECK_EQUAL(parse("bytes=-", 1000, first, last), request::no_range);
+}
+
+BOOST_AUTO_TEST_CASE( http_request_keep_alive )
+{
+	BOOST_CHECK(make("/").keep_alive());
+	BOOST_CHECK(!make("/", 0).keep_alive());
+
+	auto req = make("/");
+	req.headers.push_back({"connection", "Close"});
+	BOOST_CHECK(!req.keep_alive());
+}
+
+BOOST_AUTO_TEST_CASE( http_request_query )
+{
+	auto req = make("/cache/?filter=urn%3Atree&limit=10&empty");
+	std::string value;
+	BOOST_CHECK_EQUAL(req.path(), "/cache/");
+	BOOST_CHECK(req.query("filter", value));
+	BOOST_CHECK_EQUAL(value, "urn:tree");
+	BOOST_CHECK(req.query("limit", value));
+	BOOST_CHECK_EQUAL(value, "10");
+	BOOST_CHECK(req.query("empty", value));
+	BOOST_CHECK_EQUAL(value, "");
+	BOOST_CHECK(!req.query("offset", value));
+	BOOST_CHECK(!make("/cache").query("limit", value));
+}
@@ -0,0 +1,47 @@
+#include <boost/test/unit_test.hpp>
+
+#include "bithorded/lib/loopmonitor.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <chrono>
+#include <thread>
+
+using namespace bithorded;
+
+BOOST_AUTO_TEST_CASE( loopmonitor_attributes_stalls )
+{
+	boost::asio::io_context ioCtx;
+	auto ts = TimerService::forContext(ioCtx);
+	LoopMonitor monitor(*ts, std::chrono::milliseconds(5), std::chrono::milliseconds(30));
+
+	ioCtx.post([]{
+		LoopMonitor::Scope outer("test.outer");
+		LoopMonitor::Scope inner("test.blocking");
+		std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	});
+	ioCtx.post([]{
+		LoopMonitor::Scope fast("test.fast");
+	});
+	// Untagged on other threads
+	std::thread([]{
+		LoopMonitor::Scope other("test.thread");
+		std::this_thread::sleep_for(std::chrono::milliseconds(40));
+	}).join();
+	ioCtx.run_for(std::chrono::milliseconds(150));
+
+	BOOST_CHECK_GE( monitor.stalls(), 1u );
+	const auto& offenders = monitor.offenders();
+	BOOST_CHECK_EQUAL( offenders.size(), 2u );
+	BOOST_REQUIRE( offenders.count("test.blocking") );
+	BOOST_CHECK_EQUAL( offenders.at("test.blocking").count, 1u );
+	BOOST_CHECK( offenders.at("test.blocking").worst >= std::chrono::milliseconds(60) );
+	BOOST_CHECK( offenders.count("test.outer") );
+	BOOST_CHECK( !offenders.count("test.fast") );
+	BOOST_CHECK( !offenders.count("test.thread") );
+
+	management::InfoList list;
+	monitor.inspect(list);
+	BOOST_REQUIRE_EQUAL( list.size(), 2u );
+	// Sorted by time blocked, which includes nested scopes
+	BOOST_CHECK_EQUAL( list[0].name, "test.outer" );
+}
@@ -0,0 +1,65 @@
+#include <boost/test/unit_test.hpp>
+
+#include "bithorded/lib/management.hpp"
+#include "bithorded/store/assetindex.hpp"
+
+#include <sstream>
+
+using namespace bithorded;
+
+namespace {
+	bithorde::Id tigerOf(size_t i) {
+		std::string raw(24, '\0');
+		raw[0] = i;
+		return bithorde::Id::fromRaw(raw);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( infolist_pages_and_filters )
+{
+	management::InfoList list;
+	list.filter = "a";
+	list.offset = 1;
+	list.limit = 2;
+	for (auto name : {"a1", "b1", "a2", "a3", "b2", "a4"})
+		list.append(name) << "value";
+
+	BOOST_CHECK_EQUAL(list.total, 4);
+	BOOST_REQUIRE_EQUAL(list.size(), 2);
+	BOOST_CHECK_EQUAL(list[0].name, "a2");
+	BOOST_CHECK_EQUAL(list[1].name, "a3");
+	BOOST_CHECK_EQUAL(list[1].str(), "value");
+}
+
+BOOST_AUTO_TEST_CASE( infolist_renders_piecewise )
+{
+	management::InfoList list;
+	for (auto name : {"a", "b", "c"})
+		list.append(name) << "v";
+
+	std::ostringstream whole, pieces;
+	list.renderJSON(whole);
+	list.render(pieces, management::InfoList::JSON, 0, 1);
+	list.render(pieces, management::InfoList::JSON, 1, 3);
+	BOOST_CHECK_EQUAL(whole.str(), "{\"a\":\"v\",\"b\":\"v\",\"c\":\"v\"}");
+	BOOST_CHECK_EQUAL(pieces.str(), whole.str());
+}
+
+BOOST_AUTO_TEST_CASE( assetindex_inspect_pages_by_score )
+{
+	store::AssetIndex index;
+	for (size_t i=0; i < 10; i++)
+		index.addAsset("asset-" + std::to_string(i), tigerOf(i), 1024, 1024, 10 - i);
+
+	management::InfoList list;
+	list.offset = 3;
+	list.limit = 2;
+	list.append("size") << index.assetCount();
+	index.inspect(list);
+
+	BOOST_CHECK_EQUAL(list.total, 11);
+	BOOST_REQUIRE_EQUAL(list.size(), 2);
+	// Lowest scores first, counting the entry before the index
+	BOOST_CHECK_EQUAL(list[0].name, "urn:tree:tiger:" + tigerOf(7).base32());
+	BOOST_CHECK_EQUAL(list[1].name, "urn:tree:tiger:" + tigerOf(6).base32());
+}
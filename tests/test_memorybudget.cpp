@@ -0,0 +1,115 @@
+#include <boost/test/unit_test.hpp>
+
+#include "lib/memorybudget.h"
+
+namespace {
+
+struct FakeConsumer : public MemoryBudget::Consumer {
+	MemoryBudget& budget;
+	size_t held;
+	bool throttled;
+
+	FakeConsumer(MemoryBudget& budget) : budget(budget), held(0), throttled(false) {}
+	~FakeConsumer() { take(-static_cast<int64_t>(held)); }
+
+	void take(int64_t bytes) {
+		held += bytes;
+		budget.charge(MemoryBudget::MESSAGES, bytes);
+	}
+	virtual size_t memoryHeld() const { return held; }
+	virtual void setMemoryThrottled(bool throttled_) { throttled = throttled_; }
+};
+
+}
+
+BOOST_AUTO_TEST_CASE( memorybudget_unlimited )
+{
+	boost::asio::io_context ioCtx;
+	auto budget = std::make_shared<MemoryBudget>(ioCtx, 0);
+	auto c = std::make_shared<FakeConsumer>(*budget);
+	budget->add(c);
+	c->take(1 << 30);
+	ioCtx.run();
+	BOOST_CHECK_EQUAL( budget->used(), 1 << 30 );
+	BOOST_CHECK_EQUAL( budget->used(MemoryBudget::MESSAGES), 1 << 30 );
+	BOOST_CHECK( !c->throttled );
+}
+
+BOOST_AUTO_TEST_CASE( memorybudget_throttles_heaviest )
+{
+	boost::asio::io_context ioCtx;
+	auto budget = std::make_shared<MemoryBudget>(ioCtx, 1000);
+	BOOST_CHECK_EQUAL( budget->lowWater(), 750 );
+	auto light = std::make_shared<FakeConsumer>(*budget);
+	auto heavy = std::make_shared<FakeConsumer>(*budget);
+	auto medium = std::make_shared<FakeConsumer>(*budget);
+	for (auto& c : {light, heavy, medium})
+		budget->add(c);
+
+	light->take(100);
+	heavy->take(600);
+	medium->take(250);
+	BOOST_CHECK_EQUAL( ioCtx.run(), 0 );
+	ioCtx.restart();
+
+	// 1100 used, the heaviest alone holds enough to get below 750
+	medium->take(150);
+	ioCtx.run();
+	ioCtx.restart();
+	BOOST_CHECK( heavy->throttled );
+	BOOST_CHECK( !medium->throttled );
+	BOOST_CHECK( !light->throttled );
+	BOOST_CHECK_EQUAL( budget->throttled(), 1 );
+	BOOST_CHECK_EQUAL( budget->throttleEvents(), 1 );
+
+	// Still above the low-water mark, stays throttled
+	heavy->take(-300);
+	ioCtx.run();
+	ioCtx.restart();
+	BOOST_CHECK( heavy->throttled );
+
+	// Released once under it
+	heavy->take(-100);
+	ioCtx.run();
+	ioCtx.restart();
+	BOOST_CHECK( !heavy->throttled );
+	BOOST_CHECK_EQUAL( budget->throttled(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( memorybudget_forgets_released )
+{
+	boost::asio::io_context ioCtx;
+	auto budget = std::make_shared<MemoryBudget>(ioCtx, 1000);
+	auto keep = std::make_shared<FakeConsumer>(*budget);
+	auto gone = std::make_shared<FakeConsumer>(*budget);
+	budget->add(keep);
+	budget->add(gone);
+	keep->take(300);
+	gone->take(800);
+	ioCtx.run();
+	ioCtx.restart();
+	BOOST_CHECK( gone->throttled );
+
+	gone.reset();
+	ioCtx.run();
+	BOOST_CHECK_EQUAL( budget->used(), 300 );
+	BOOST_CHECK_EQUAL( budget->throttled(), 0 );
+	BOOST_CHECK( !keep->throttled );
+}
+
+BOOST_AUTO_TEST_CASE( memorybudget_receive_buffers_only_accounted )
+{
+	boost::asio::io_context ioCtx;
+	auto budget = std::make_shared<MemoryBudget>(ioCtx, 1000);
+	auto c = std::make_shared<FakeConsumer>(*budget);
+	budget->add(c);
+	c->take(100);
+
+	// Not given back by throttling, so never what pushes usage over the limit
+	budget->charge(MemoryBudget::RECEIVE_BUFFERS, 5000);
+	BOOST_CHECK_EQUAL( ioCtx.run(), 0 );
+	BOOST_CHECK_EQUAL( budget->used(), 100 );
+	BOOST_CHECK_EQUAL( budget->used(MemoryBudget::RECEIVE_BUFFERS), 5000 );
+	BOOST_CHECK( !c->throttled );
+	budget->charge(MemoryBudget::RECEIVE_BUFFERS, -5000);
+}
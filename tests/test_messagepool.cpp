@@ -0,0 +1,97 @@
+#include <set>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "lib/client.h"
+#include "lib/messagepool.h"
+
+#include <google/protobuf/io/coded_stream.h>
+
+using namespace bithorde;
+
+// Parses like bithorde::Connection, into a pooled message wrapped in a MessageContext
+static MessageContext<Read::Response>::Ptr parse(const Client::Pointer& client, const std::string& wire)
+{
+	auto msg = MessagePool<Read::Response>::instance().acquire();
+	google::protobuf::io::CodedInputStream stream((const google::protobuf::uint8*)wire.data(), wire.size());
+	BOOST_VERIFY( msg->MergePartialFromCodedStream(&stream) );
+	return MessageContext<Read::Response>::create(client, std::static_pointer_cast<const Read::Response>(msg));
+}
+
+BOOST_AUTO_TEST_CASE( messagepool_allocation_free_dispatch )
+{
+	boost::asio::io_context ioCtx;
+	auto client = Client::create(ioCtx, "bench");
+
+	Read::Response resp;
+	resp.set_reqid(17);
+	resp.set_status(SUCCESS);
+	resp.set_offset(1024);
+	resp.set_content(std::string(128*1024, 'x'));
+	auto wire = resp.SerializeAsString();
+
+	// Warm up the pools, noting the content-buffers parsed into
+	std::set<const char*> buffers;
+	{
+		auto first = parse(client, wire);
+		auto second = parse(client, wire);
+		buffers.insert(first->message().content().data());
+		buffers.insert(second->message().content().data());
+	}
+	auto created = MessagePool<Read::Response>::instance().created();
+
+	// Neither pools nor protobuf should go to the heap; message, context and content-buffer
+	// are all reused
+	const int ROUNDS = 1000;
+	auto before = poolHeapAllocations().load();
+	int reused = 0;
+	for (int i=0; i < ROUNDS; i++) {
+		auto ctx = parse(client, wire);
+		if (ctx->message().content().size() != resp.content().size())
+			break;
+		reused += buffers.count(ctx->message().content().data());
+	}
+	auto allocations = poolHeapAllocations() - before;
+
+	BOOST_TEST_MESSAGE( "messagepool: " << allocations << " pool allocations in " << ROUNDS << " parsed 128KiB responses" );
+	BOOST_CHECK_EQUAL( allocations, 0 );
+	BOOST_CHECK_EQUAL( reused, ROUNDS );
+	BOOST_CHECK_EQUAL( MessagePool<Read::Response>::instance().created(), created );
+	BOOST_CHECK_EQUAL( client->bytesAllocated(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( messagepool_reuses_cleared )
+{
+	auto& pool = MessagePool<Read::Request>::instance();
+	const Read::Request* first;
+	{
+		auto msg = pool.acquire();
+		msg->set_handle(1);
+		first = msg.get();
+	}
+	auto msg = pool.acquire();
+	BOOST_CHECK_EQUAL( msg.get(), first );
+	BOOST_CHECK( !msg->has_handle() );
+}
+
+BOOST_AUTO_TEST_CASE( messagepool_bounds_large )
+{
+	auto& pool = MessagePool<DataSegment>::instance();
+	std::vector<MessagePool<DataSegment>::Ptr> held;
+	for (int i=0; i < 64; i++) {
+		held.push_back(pool.acquire());
+		held.back()->set_content(std::string(64*1024, 'x'));
+	}
+	held.clear();
+
+	// Only a few keep their large buffers, the rest are freed
+	size_t kept = 0;
+	for (int i=0; i < 64; i++) {
+		held.push_back(pool.acquire());
+		if (held.back()->SpaceUsedLong() > 64*1024)
+			kept++;
+	}
+	BOOST_CHECK_GT( kept, 0 );
+	BOOST_CHECK_LE( kept, 16 );
+}
@@ -0,0 +1,61 @@
+#include <boost/test/unit_test.hpp>
+
+#include "bithorded/lib/metrics.hpp"
+
+#include <sstream>
+
+using namespace bithorded::metrics;
+
+BOOST_AUTO_TEST_CASE( histogram_buckets )
+{
+	for (uint64_t v : {0ull, 1ull, 3ull, 4ull, 7ull, 8ull, 1000ull, 123456789ull, ~0ull}) {
+		auto bucket = Histogram::bucketOf(v);
+		BOOST_CHECK_LT( bucket, Histogram::BUCKETS );
+		BOOST_CHECK_LE( Histogram::lowerBound(bucket), v );
+		if (bucket+1 < Histogram::BUCKETS)
+			BOOST_CHECK_GT( Histogram::lowerBound(bucket+1), v );
+	}
+	BOOST_CHECK_EQUAL( Histogram::bucketOf(~0ull), Histogram::BUCKETS-1 );
+
+	Histogram h("test_latency_seconds", "Test");
+	BOOST_CHECK_EQUAL( h.percentile(0.5), 0 );
+	for (uint64_t i=1; i <= 100; i++)
+		h.record(i*1000);
+	BOOST_CHECK_EQUAL( h.count(), 100 );
+	BOOST_CHECK_EQUAL( h.sum(), 5050000 );
+	// Within the 25% bucket error
+	BOOST_CHECK_LE( h.percentile(0.5), 50000 );
+	BOOST_CHECK_GE( h.percentile(0.5), 50000*3/4 );
+	BOOST_CHECK_LE( h.percentile(0.99), 99000 );
+	BOOST_CHECK_GE( h.percentile(0.99), 99000*3/4 );
+}
+
+BOOST_AUTO_TEST_CASE( registry_render )
+{
+	std::string text;
+	{
+		Counter a("test_lookups_total", "Lookups", {{"result", "hit"}});
+		Counter b("test_lookups_total", "Lookups", {{"result", "mi\"ss"}});
+		Histogram h("test_io_seconds", "IO");
+		a += 3;
+		b += 1234567890123;
+		h.record(3);
+		h.record(5);
+
+		std::ostringstream buf;
+		Registry::instance().render(buf);
+		text = buf.str();
+	}
+	BOOST_CHECK_EQUAL( text.find("# TYPE test_lookups_total counter"), text.rfind("# TYPE test_lookups_total counter") );
+	BOOST_CHECK_NE( text.find("test_lookups_total{result=\"hit\"} 3\n"), std::string::npos );
+	BOOST_CHECK_NE( text.find("test_lookups_total{result=\"mi\\\"ss\"} 1234567890123\n"), std::string::npos );
+	BOOST_CHECK_NE( text.find("# TYPE test_io_seconds histogram"), std::string::npos );
+	BOOST_CHECK_NE( text.find("test_io_seconds_bucket{le=\"4e-06\"} 1\n"), std::string::npos );
+	BOOST_CHECK_NE( text.find("test_io_seconds_bucket{le=\"+Inf\"} 2\n"), std::string::npos );
+	BOOST_CHECK_NE( text.find("test_io_seconds_count 2\n"), std::string::npos );
+
+	// Unregistered on destruction
+	std::ostringstream buf;
+	Registry::instance().render(buf);
+	BOOST_CHECK_EQUAL( buf.str().find("test_lookups_total"), std::string::npos );
+}
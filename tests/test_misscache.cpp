@@ -0,0 +1,85 @@
+#include <boost/test/unit_test.hpp>
+
+#include "bithorded/router/misscache.hpp"
+
+namespace ptime = boost::posix_time;
+using namespace bithorded::router;
+
+BOOST_AUTO_TEST_CASE( misscache_insert_and_expire )
+{
+	MissCache misses(16);
+	auto now = ptime::microsec_clock::universal_time();
+	auto a = bithorde::Id::fromRaw("a"), b = bithorde::Id::fromRaw("b");
+
+	misses.remember(a, now + ptime::seconds(10));
+	misses.remember(b, now + ptime::seconds(20));
+	BOOST_CHECK( misses.contains(a, now) );
+	BOOST_CHECK( misses.contains(b, now) );
+	BOOST_CHECK( !misses.contains(bithorde::Id::fromRaw("c"), now) );
+	BOOST_CHECK( !misses.contains(bithorde::Id(), now) );
+
+	BOOST_CHECK( !misses.contains(a, now + ptime::seconds(10)) );
+	BOOST_CHECK( misses.contains(b, now + ptime::seconds(10)) );
+	BOOST_CHECK_EQUAL( misses.size(), 1 );
+
+	// Remembering again extends, the earlier expiry does not remove it
+	misses.remember(b, now + ptime::seconds(40));
+	BOOST_CHECK( misses.contains(b, now + ptime::seconds(30)) );
+	BOOST_CHECK( !misses.contains(b, now + ptime::seconds(40)) );
+	BOOST_CHECK_EQUAL( misses.size(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( misscache_invalidated )
+{
+	MissCache misses(16);
+	auto now = ptime::microsec_clock::universal_time();
+	auto a = bithorde::Id::fromRaw("a");
+	misses.remember(a, now + ptime::seconds(10));
+	misses.clear();
+	BOOST_CHECK( !misses.contains(a, now) );
+	BOOST_CHECK_EQUAL( misses.size(), 0 );
+
+	// Usable again after
+	misses.remember(a, now + ptime::seconds(10));
+	BOOST_CHECK( misses.contains(a, now) );
+}
+
+BOOST_AUTO_TEST_CASE( misscache_bounded )
+{
+	MissCache misses(2);
+	auto now = ptime::microsec_clock::universal_time();
+	auto a = bithorde::Id::fromRaw("a"), b = bithorde::Id::fromRaw("b"), c = bithorde::Id::fromRaw("c");
+	misses.remember(a, now + ptime::seconds(10));
+	misses.remember(b, now + ptime::seconds(10));
+	misses.remember(c, now + ptime::seconds(10));
+	BOOST_CHECK_EQUAL( misses.size(), 2 );
+	BOOST_CHECK( !misses.contains(a, now) ); // Oldest made room
+	BOOST_CHECK( misses.contains(b, now) );
+	BOOST_CHECK( misses.contains(c, now) );
+}
+
+BOOST_AUTO_TEST_CASE( misscache_remember_refreshes )
+{
+	MissCache misses(2);
+	auto now = ptime::microsec_clock::universal_time();
+	auto a = bithorde::Id::fromRaw("a"), b = bithorde::Id::fromRaw("b"), c = bithorde::Id::fromRaw("c");
+
+	// The same miss seen over and over takes one entry
+	for (int i = 0; i < 1000; i++)
+		misses.remember(a, now + ptime::seconds(10));
+	misses.remember(b, now + ptime::seconds(10));
+	misses.remember(a, now + ptime::seconds(10));
+	BOOST_CHECK_EQUAL( misses.size(), 2 );
+
+	// a was remembered last, so b makes room
+	misses.remember(c, now + ptime::seconds(10));
+	BOOST_CHECK_EQUAL( misses.size(), 2 );
+	BOOST_CHECK( misses.contains(a, now) );
+	BOOST_CHECK( !misses.contains(b, now) );
+	BOOST_CHECK( misses.contains(c, now) );
+
+	// An earlier expiry replaces a later one
+	misses.remember(c, now + ptime::seconds(5));
+	BOOST_CHECK( !misses.contains(c, now + ptime::seconds(5)) );
+	BOOST_CHECK( misses.contains(a, now + ptime::seconds(5)) );
+}
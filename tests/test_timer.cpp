@@ -49,3 +49,53 @@ BOOST_AUTO_TEST_CASE( timers_copyable )
 	auto stop = ptime::microsec_clock::universal_time();
 	BOOST_CHECK_GE( (stop - start).total_microseconds(), TIMEOUT.total_microseconds() );
 }
+
+BOOST_AUTO_TEST_CASE( timers_rearm_and_clear )
+{
+	boost::asio::io_context ioCtx;
+	auto ts = TimerService::forContext(ioCtx);
+	BOOST_CHECK_EQUAL( ts, TimerService::forContext(ioCtx) );
+
+	std::vector<int> fired;
+	Timer a(*ts, [&](const ptime::ptime&){ fired.push_back(1); });
+	Timer b(*ts, [&](const ptime::ptime&){ fired.push_back(2); });
+	Timer c(*ts, [&](const ptime::ptime&){ fired.push_back(3); });
+	Timer never(*ts, [&](const ptime::ptime&){ fired.push_back(4); });
+
+	a.arm(ptime::millisec(30));
+	a.arm(ptime::millisec(10)); // Moves, should only fire once
+	b.arm(ptime::millisec(20));
+	c.arm(ptime::millisec(400)); // Beyond the first level
+	never.arm(ptime::hours(24*365)); // Beyond the wheel
+	BOOST_CHECK_EQUAL( ts->size(), 4 );
+
+	Timer d(*ts, [&](const ptime::ptime&){ fired.push_back(5); never.clear(); });
+	d.arm(ptime::millisec(300));
+
+	ioCtx.run();
+	BOOST_CHECK_EQUAL( ts->size(), 0 );
+	BOOST_REQUIRE_EQUAL( fired.size(), 4 );
+	BOOST_CHECK_EQUAL( fired[0], 1 );
+	BOOST_CHECK_EQUAL( fired[1], 2 );
+	BOOST_CHECK_EQUAL( fired[2], 5 );
+	BOOST_CHECK_EQUAL( fired[3], 3 );
+}
+
+BOOST_AUTO_TEST_CASE( timers_clear_from_callback )
+{
+	boost::asio::io_context ioCtx;
+	auto ts = TimerService::forContext(ioCtx);
+
+	// Both in the same slot, whichever fires first cancels the other
+	int fired = 0;
+	std::unique_ptr<Timer> a, b;
+	a.reset(new Timer(*ts, [&](const ptime::ptime&){ fired++; b->clear(); }));
+	b.reset(new Timer(*ts, [&](const ptime::ptime&){ fired++; a->clear(); }));
+	auto deadline = ptime::microsec_clock::universal_time() + ptime::millisec(5);
+	a->arm(deadline);
+	b->arm(deadline);
+
+	ioCtx.run();
+	BOOST_CHECK_EQUAL( fired, 1 );
+	BOOST_CHECK( !a->armed() && !b->armed() );
+}
@@ -0,0 +1,43 @@
+#include <boost/test/unit_test.hpp>
+
+#include "lib/tokenbucket.h"
+
+using namespace std::chrono;
+
+BOOST_AUTO_TEST_CASE( tokenbucket_unlimited )
+{
+	TokenBucket bucket(0, 0);
+	bucket.take(1000000);
+	BOOST_CHECK( bucket.ready() );
+	BOOST_CHECK( bucket.delay() == TokenBucket::Clock::duration::zero() );
+}
+
+BOOST_AUTO_TEST_CASE( tokenbucket_refill )
+{
+	auto start = TokenBucket::Clock::now();
+	TokenBucket bucket(1000, 2000, start);
+	BOOST_CHECK_EQUAL( bucket.tokens(start), 2000 );
+
+	// Taking more than available leaves a debt to pay off
+	bucket.take(2500, start);
+	BOOST_CHECK( !bucket.ready(start) );
+	BOOST_CHECK_EQUAL( bucket.tokens(start), -500 );
+	BOOST_CHECK_EQUAL( duration_cast<milliseconds>(bucket.delay(start)).count(), 501 );
+
+	BOOST_CHECK_EQUAL( bucket.tokens(start + milliseconds(250)), -250 );
+	BOOST_CHECK( bucket.ready(start + milliseconds(501)) );
+
+	// Never refills past the burst
+	BOOST_CHECK_EQUAL( bucket.tokens(start + seconds(60)), 2000 );
+}
+
+BOOST_AUTO_TEST_CASE( tokenbucket_fractions )
+{
+	auto start = TokenBucket::Clock::now();
+	TokenBucket bucket(10, 10, start);
+	bucket.take(10, start);
+	// Refills in steps smaller than a whole token still add up
+	for (int i=1; i <= 10; i++)
+		bucket.tokens(start + milliseconds(i*50));
+	BOOST_CHECK_EQUAL( bucket.tokens(start + milliseconds(500)), 5 );
+}
@@ -0,0 +1,59 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../lib/trace.h"
+
+#include <sstream>
+
+using namespace bithorde::trace;
+
+BOOST_AUTO_TEST_CASE( trace_disabled_is_noop )
+{
+	auto& tracer = Tracer::instance();
+	tracer.configure(16, 0);
+	BOOST_CHECK( !tracer.enabled() );
+	auto ctx = tracer.sample(1, 2);
+	BOOST_CHECK( !ctx );
+	Span(ctx).finish("dropped");
+	BOOST_CHECK_EQUAL( tracer.recorded(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( trace_sampling_and_ring )
+{
+	auto& tracer = Tracer::instance();
+	tracer.configure(4, 2);
+
+	auto a = tracer.sample(10, 1);
+	auto b = tracer.sample(11, 1);
+	BOOST_CHECK( a );
+	BOOST_CHECK( !b );
+
+	BOOST_CHECK( !Context::current() );
+	{
+		Scope scope(a);
+		BOOST_CHECK_EQUAL( Context::current().reqId, 10 );
+		Span(Context::current()).finish("disk");
+		Span(b).finish("ignored");
+	}
+	BOOST_CHECK( !Context::current() );
+	BOOST_CHECK_EQUAL( tracer.recorded(), 1 );
+
+	std::ostringstream buf;
+	tracer.renderChromeTrace(buf);
+	BOOST_CHECK_NE( buf.str().find("\"name\":\"disk\""), std::string::npos );
+	BOOST_CHECK_NE( buf.str().find("\"reqId\":10"), std::string::npos );
+
+	// Only the latest spans are kept
+	for (int i=0; i < 10; i++)
+		Span(a).finish(i < 9 ? "old" : "newest");
+	buf.str("");
+	tracer.renderChromeTrace(buf);
+	auto text = buf.str();
+	BOOST_CHECK_EQUAL( text.find("disk"), std::string::npos );
+	BOOST_CHECK_NE( text.find("newest"), std::string::npos );
+	size_t events = 0;
+	for (auto pos = text.find("\"ph\""); pos != std::string::npos; pos = text.find("\"ph\"", pos+1))
+		events++;
+	BOOST_CHECK_EQUAL( events, 4 );
+
+	tracer.configure(0, 0);
+}
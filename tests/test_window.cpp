@@ -0,0 +1,33 @@
+#include <boost/test/unit_test.hpp>
+
+#include "bithorded/router/window.hpp"
+
+namespace ptime = boost::posix_time;
+using namespace bithorded::router;
+
+BOOST_AUTO_TEST_CASE( upstream_window )
+{
+	UpstreamWindow w;
+	auto initial = w.window();
+	BOOST_CHECK( w.hasRoom(initial) );
+	BOOST_CHECK( w.hasRoom(initial*2) ); // A single read always fits
+
+	auto marker = w.sent(initial);
+	BOOST_CHECK_EQUAL( w.inFlight(), initial );
+	BOOST_CHECK( !w.hasRoom(1) );
+
+	// 1MB answered in 100ms, 10MB/s over 100ms gives a 2MB window
+	w.delivered(1024*1024, marker, ptime::milliseconds(100));
+	w.released(initial);
+	BOOST_CHECK_EQUAL( w.inFlight(), 0 );
+	BOOST_CHECK_EQUAL( w.bandwidth().value(), 10*1024*1024 );
+	BOOST_CHECK_EQUAL( w.rtt().value(), 100 );
+	BOOST_CHECK_EQUAL( w.window(), 2*1024*1024 );
+
+	// Slow responses do not shrink the window below the lowest rtt seen
+	marker = w.sent(128*1024);
+	w.delivered(128*1024, marker, ptime::milliseconds(1000));
+	w.released(128*1024);
+	BOOST_CHECK_EQUAL( w.rtt().value(), 100 );
+	BOOST_CHECK_EQUAL( w.window(), 2*1024*1024 );
+}